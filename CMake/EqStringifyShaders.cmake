@@ -26,7 +26,9 @@ endif(NOT EQ_STRINGIFY_SHADERS_PROCESSING_MODE)
 get_filename_component(FILENAME ${INPUT} NAME)
 string(REGEX REPLACE "[.]" "_" NAME ${FILENAME})
 
-file(STRINGS ${INPUT} LINES)
+# The source is embedded verbatim in a raw string literal. Reading it line
+# by line as a CMake list would mangle lines ending in a backslash.
+file(READ ${INPUT} SOURCE)
 
 file(WRITE ${OUTPUT}.h
   "/* Generated file, do not edit! */\n\n"
@@ -36,12 +38,5 @@ file(WRITE ${OUTPUT}.h
 file(WRITE ${OUTPUT}.cpp
   "/* Generated file, do not edit! */\n\n"
   "#include \"${FILENAME}.h\"\n\n"
-  "char const* const ${NAME} = \n"
+  "char const* const ${NAME} = R\"shader(${SOURCE})shader\";\n"
   )
-
-foreach(LINE ${LINES})
-  string(REPLACE "\"" "\\\"" LINE "${LINE}")
-  file(APPEND ${OUTPUT}.cpp "   \"${LINE}\\n\"\n")
-endforeach(LINE)
-
-file(APPEND ${OUTPUT}.cpp "   ;\n")
@@ -0,0 +1,162 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+
+#include "animation_scheduler.h"
+
+#include <vtkRenderWindowInteractor.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace common
+{
+
+namespace
+{
+
+/* Timer events per frame period, the pacing error is below one interval */
+const int TICKS_PER_FRAME = 4;
+
+}
+
+AnimationScheduler *AnimationScheduler::New()
+{
+    return new AnimationScheduler;
+}
+
+AnimationScheduler::AnimationScheduler()
+    : _reportPeriod(5)
+    , _interactor(0)
+    , _observer(0)
+    , _timer(0)
+    , _first(true)
+    , _frames(0)
+    , _late(0)
+    , _frameTimeSum(0)
+    , _minFrameTime(0)
+    , _maxFrameTime(0)
+    , _renderTimeSum(0)
+{
+}
+
+AnimationScheduler::~AnimationScheduler()
+{
+}
+
+void AnimationScheduler::Start(vtkRenderWindowInteractor *interactor,
+                               const double fps)
+{
+    Stop();
+    _interactor = interactor;
+    _period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1 / fps));
+    _first = true;
+    _resetStatistics(Clock::now());
+
+    const unsigned long interval = std::max(
+        1L, long(1000 / (fps * TICKS_PER_FRAME)));
+    _observer = interactor->AddObserver(vtkCommand::TimerEvent, this);
+    _timer = interactor->CreateRepeatingTimer(interval);
+}
+
+void AnimationScheduler::Stop()
+{
+    if (!_interactor)
+        return;
+    _interactor->DestroyTimer(_timer);
+    _interactor->RemoveObserver(_observer);
+    _interactor = 0;
+}
+
+void AnimationScheduler::Execute(vtkObject *, unsigned long,
+                                 void *callData)
+{
+    /* Other timers of the interactor are ignored */
+    if (!_interactor || !callData || *static_cast<int *>(callData) != _timer)
+        return;
+
+    const Clock::time_point now = Clock::now();
+    if (!_first && now < _next)
+        return;
+
+    /* The first frame has no frame time and is left out of the
+       statistics */
+    const bool measured = !_first;
+    double elapsed = 0;
+    if (measured)
+    {
+        elapsed = std::chrono::duration<double>(now - _previous).count();
+        ++_frames;
+        _frameTimeSum += elapsed;
+        _minFrameTime = std::min(_minFrameTime, elapsed);
+        _maxFrameTime = std::max(_maxFrameTime, elapsed);
+        if (now - _next >= _period)
+            ++_late;
+    }
+    /* Restarting the schedule if the frame is late by more than a period */
+    _next = _first || now - _next >= _period ? now + _period
+                                             : _next + _period;
+    _previous = now;
+    _first = false;
+
+    if (_step)
+        _step(elapsed);
+    _interactor->Render();
+    if (measured)
+        _renderTimeSum += std::chrono::duration<double>(
+            Clock::now() - now).count();
+
+    if (_reportPeriod > 0 &&
+        std::chrono::duration<double>(now - _reportStart).count() >=
+            _reportPeriod)
+    {
+        _report(now);
+        _resetStatistics(now);
+    }
+}
+
+void AnimationScheduler::_resetStatistics(const Clock::time_point now)
+{
+    _reportStart = now;
+    _frames = 0;
+    _late = 0;
+    _frameTimeSum = 0;
+    _minFrameTime = std::numeric_limits<double>::max();
+    _maxFrameTime = 0;
+    _renderTimeSum = 0;
+}
+
+void AnimationScheduler::_report(const Clock::time_point now)
+{
+    if (_frames == 0)
+        return;
+    const double seconds =
+        std::chrono::duration<double>(now - _reportStart).count();
+    const double target = std::chrono::duration<double>(_period).count();
+    std::cout << _frames / seconds << " fps (target " << 1 / target
+              << "), frame time " << _frameTimeSum / _frames * 1000
+              << " ms [" << _minFrameTime * 1000 << ", "
+              << _maxFrameTime * 1000 << "], render time "
+              << _renderTimeSum / _frames * 1000 << " ms, " << _late
+              << " late frames" << std::endl;
+}
+
+}
@@ -0,0 +1,110 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef COMMON_ANIMATION_SCHEDULER_H
+#define COMMON_ANIMATION_SCHEDULER_H
+
+#include <vtkCommand.h>
+
+#include <chrono>
+#include <functional>
+
+class vtkRenderWindowInteractor;
+
+namespace common
+{
+
+/**
+   Renders an animation at a target frame rate from the event loop of an
+   interactor.
+
+   A repeating timer fires several times per frame period and a frame is
+   rendered when the next one is due, so the frames are paced regardless
+   of how long rendering takes, up to the rate the window can sustain.
+   Before each frame the step function advances the scene by the time
+   elapsed since the previous frame, so motion speed doesn't depend on
+   the frame rate. If frames can't keep up, the schedule restarts from
+   the late frame instead of rendering a burst of frames to catch up.
+
+   Frame time statistics (rate, mean, minimum and maximum frame time,
+   render time and late frames) are printed periodically.
+ */
+class AnimationScheduler : public vtkCommand
+{
+public:
+    /** Advances the scene, takes the seconds since the previous frame,
+        0 for the first one */
+    typedef std::function<void(double)> Step;
+
+    static AnimationScheduler *New();
+
+    void SetStep(const Step &step) { _step = step; }
+
+    /** Seconds between statistics reports, 5 by default, 0 disables
+        them */
+    void SetReportPeriod(double seconds) { _reportPeriod = seconds; }
+
+    /**
+       Starts rendering frames at fps from the timer events of an
+       initialized interactor.
+     */
+    void Start(vtkRenderWindowInteractor *interactor, double fps);
+
+    void Stop();
+
+    virtual void Execute(vtkObject *caller, unsigned long event,
+                         void *callData);
+
+protected:
+    AnimationScheduler();
+    ~AnimationScheduler();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Step _step;
+    double _reportPeriod;
+
+    vtkRenderWindowInteractor *_interactor;
+    unsigned long _observer;
+    int _timer;
+    Clock::duration _period;
+    Clock::time_point _next;
+    Clock::time_point _previous;
+    bool _first;
+
+    /* Statistics since the last report */
+    Clock::time_point _reportStart;
+    size_t _frames;
+    size_t _late;
+    double _frameTimeSum;
+    double _minFrameTime;
+    double _maxFrameTime;
+    double _renderTimeSum;
+
+    void _resetStatistics(Clock::time_point now);
+    void _report(Clock::time_point now);
+
+    AnimationScheduler(const AnimationScheduler &);
+    void operator=(const AnimationScheduler &);
+};
+
+}
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef COMMON_BINARY_IO_H
+#define COMMON_BINARY_IO_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+namespace common
+{
+
+/**
+   Helpers for the binary file formats of the demos. Values are stored
+   in native byte order.
+ */
+
+template<typename T>
+void writeValue(std::ofstream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/** Reads a value from a buffer and returns the position after it */
+template<typename T>
+const char *readValue(const char *in, T &value)
+{
+    memcpy(&value, in, sizeof(T));
+    return in + sizeof(T);
+}
+
+/**
+   Reads size bytes at offset from a file descriptor, retrying short reads.
+   Throws std::runtime_error naming filename on errors and end of file.
+ */
+inline void preadAll(int fd, void *out, size_t size, uint64_t offset,
+                     const std::string &filename)
+{
+    char *buffer = static_cast<char *>(out);
+    while (size != 0)
+    {
+        const ssize_t bytes = pread(fd, buffer, size, offset);
+        if (bytes <= 0)
+            throw std::runtime_error("Error reading file " + filename);
+        buffer += bytes;
+        size -= bytes;
+        offset += bytes;
+    }
+}
+
+}
+
+#endif
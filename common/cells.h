@@ -0,0 +1,64 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef COMMON_CELLS_H
+#define COMMON_CELLS_H
+
+#include "parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkPolyData.h>
+
+#include <cstddef>
+
+namespace common
+{
+
+/**
+   Tells a poly data that the cells it was given have been rewritten in
+   place (e.g. through vtkCellArray::WritePointer).
+ */
+inline void cellsRewritten(vtkPolyData *data, vtkCellArray *cells)
+{
+    cells->Modified();
+    /* Discarding the cell links built from the previous cells, they would
+       refer to cells that no longer exist. */
+    data->DeleteCells();
+    data->Modified();
+}
+
+/**
+   Replaces the contents of cells with one vertex cell per index and tells
+   data about it.
+ */
+template<typename Index>
+void writeVertexCells(vtkPolyData *data, vtkCellArray *cells,
+                      const Index *indices, const size_t count)
+{
+    vtkIdType *connectivity = cells->WritePointer(count, count * 2);
+    parallelFor(0, count, [&](const size_t i)
+    {
+        connectivity[i * 2] = 1;
+        connectivity[i * 2 + 1] = indices[i];
+    });
+    cellsRewritten(data, cells);
+}
+
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "common/mapped_file.h"
+
+#include <vtkDataArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationObjectBaseKey.h>
+#include <vtkObjectFactory.h>
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace common
+{
+
+vtkStandardNewMacro(MappedFile);
+vtkInformationKeyMacro(MappedFile, MAPPING, ObjectBase);
+
+MappedFile::MappedFile()
+    : _data(0)
+    , _size(0)
+    , _writable(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data)
+        munmap(_data, _size);
+}
+
+void MappedFile::Open(const std::string &filename, const bool writable)
+{
+    if (_data)
+        munmap(_data, _size);
+    _data = 0;
+    _size = 0;
+
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("Could not open file " + filename);
+    struct stat status;
+    if (fstat(fd, &status) == -1)
+    {
+        close(fd);
+        throw std::runtime_error("Could not stat file " + filename);
+    }
+
+    void *data = MAP_FAILED;
+    if (status.st_size != 0)
+        data = mmap(0, status.st_size,
+                    writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+    /* The mapping remains valid after closing the descriptor */
+    close(fd);
+    if (data == MAP_FAILED)
+        throw std::runtime_error("Could not map file " + filename);
+
+    _data = static_cast<char *>(data);
+    _size = status.st_size;
+    _writable = writable;
+    Modified();
+}
+
+void MappedFile::Attach(vtkDataArray *array, const size_t offset,
+                        const vtkIdType values)
+{
+    if (offset + size_t(values) * array->GetDataTypeSize() > _size)
+        throw std::runtime_error("Array exceeds the mapped file");
+    /* Save = 1, the array must not free the mapped memory */
+    array->SetVoidArray(_data + offset, values, 1);
+    array->GetInformation()->Set(MAPPING(), this);
+}
+
+}
@@ -0,0 +1,83 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef COMMON_MAPPED_FILE_H
+#define COMMON_MAPPED_FILE_H
+
+#include <vtkObject.h>
+#include <vtkType.h>
+
+#include <string>
+
+class vtkDataArray;
+class vtkInformationObjectBaseKey;
+
+namespace common
+{
+
+/**
+   Memory mapping of a whole file.
+
+   The mapping is a VTK object so its lifetime can be tied to the arrays
+   that point into it: attach() makes an array use a region of the mapping
+   as its storage, without copying, and keeps a reference to the mapping in
+   the array information. The file is unmapped when the last of those
+   arrays is destroyed.
+ */
+class MappedFile : public vtkObject
+{
+public:
+    static MappedFile *New();
+    vtkTypeMacro(MappedFile, vtkObject);
+
+    /**
+       Maps a file. If writable is true the mapping is private, pages are
+       copied on write and changes never reach the file.
+       Throws std::runtime_error on failure.
+     */
+    void Open(const std::string &filename, bool writable = false);
+
+    const char *GetData() const { return _data; }
+    char *GetWritableData() { return _writable ? _data : 0; }
+    size_t GetSize() const { return _size; }
+
+    /**
+       Makes array use the values starting at offset bytes in the mapping.
+       The array must have the number of components already set.
+     */
+    void Attach(vtkDataArray *array, size_t offset, vtkIdType values);
+
+    /** Information key holding the mapping in the arrays attached to it */
+    static vtkInformationObjectBaseKey *MAPPING();
+
+protected:
+    MappedFile();
+    ~MappedFile();
+
+private:
+    char *_data;
+    size_t _size;
+    bool _writable;
+
+    MappedFile(const MappedFile &);
+    void operator=(const MappedFile &);
+};
+
+}
+
+#endif
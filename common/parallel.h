@@ -0,0 +1,115 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef COMMON_PARALLEL_H
+#define COMMON_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace common
+{
+
+/**
+   Number of worker threads used by the parallel loops.
+ */
+inline unsigned int threadCount()
+{
+    const unsigned int count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+/**
+   Calls f(chunkBegin, chunkEnd) over consecutive chunks of [begin, end).
+
+   Chunks are handed out dynamically to threadCount() threads, the calling
+   thread included. An exception thrown by f in any thread is rethrown in
+   the calling thread once all workers have finished.
+ */
+template<typename F>
+void parallelForChunks(size_t begin, size_t end, size_t chunkSize, const F &f)
+{
+    if (begin >= end)
+        return;
+    chunkSize = std::max(chunkSize, size_t(1));
+    const size_t chunks = (end - begin + chunkSize - 1) / chunkSize;
+    const size_t threads = std::min(size_t(threadCount()), chunks);
+    if (threads == 1)
+    {
+        f(begin, end);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&]()
+    {
+        try
+        {
+            for (size_t chunk = next++; chunk < chunks; chunk = next++)
+            {
+                const size_t first = begin + chunk * chunkSize;
+                f(first, std::min(first + chunkSize, end));
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+                error = std::current_exception();
+            /* Draining the remaining chunks so the other workers stop. */
+            next = chunks;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < threads; ++i)
+        pool.push_back(std::thread(worker));
+    worker();
+    for (size_t i = 0; i != pool.size(); ++i)
+        pool[i].join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/**
+   Calls f(i) for each i in [begin, end) using threadCount() threads.
+ */
+template<typename F>
+void parallelFor(size_t begin, size_t end, const F &f)
+{
+    const size_t chunk =
+        std::max(size_t(1), (end - begin) / (size_t(threadCount()) * 16));
+    parallelForChunks(begin, end, chunk,
+                      [&f](size_t first, size_t last)
+                      {
+                          for (size_t i = first; i < last; ++i)
+                              f(i);
+                      });
+}
+
+}
+
+#endif
@@ -28,6 +28,9 @@ std::string shaderPath();
 
 std::string dataPath();
 
+/** True if filename ends with suffix, e.g. an extension like ".bvol" */
+bool endsWith(const std::string &filename, const std::string &suffix);
+
 }
 
 #endif
@@ -0,0 +1,222 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+
+#include "compact_mesh.h"
+#include "vertex_cache_optimizer.h"
+#include "vertex_normals.h"
+
+#include "common/parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedIntArray.h>
+
+#include <limits>
+#include <stdexcept>
+
+namespace mesh
+{
+
+namespace
+{
+
+const size_t COPY_CHUNK = 1 << 14;
+
+static_assert(sizeof(unsigned int) == sizeof(uint32_t),
+              "vtkUnsignedIntArray must hold 32 bit indices");
+
+template<typename T>
+void convertPoints(const T *in, const size_t count, float *out)
+{
+    common::parallelForChunks(0, count * 3, COPY_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+            out[i] = float(in[i]);
+    });
+}
+
+/* Checks that mesh can be compacted and returns its triangle count */
+size_t checkTriangles(vtkPolyData *mesh)
+{
+    const size_t count = mesh->GetNumberOfPolys();
+    if (count == 0)
+        return 0;
+    if (!isTriangleMesh(mesh))
+        throw std::runtime_error("Only triangle meshes are supported");
+    if (size_t(mesh->GetNumberOfPoints()) >
+        std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Too many points for 32 bit indices");
+    return count;
+}
+
+void writeTriangles(vtkPolyData *mesh, const size_t count,
+                    uint32_t *triangles)
+{
+    if (count == 0)
+        return;
+    const size_t pointCount = mesh->GetNumberOfPoints();
+    const vtkIdType *cells = mesh->GetPolys()->GetData()->GetPointer(0);
+    common::parallelForChunks(0, count, COPY_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            for (int j = 0; j != 3; ++j)
+            {
+                const vtkIdType point = cells[i * 4 + 1 + j];
+                if (point < 0 || size_t(point) >= pointCount)
+                    throw std::runtime_error("Triangle with an invalid point");
+                triangles[i * 3 + j] = uint32_t(point);
+            }
+        }
+    });
+}
+
+}
+
+std::vector<uint32_t> compactTriangles(vtkPolyData *mesh)
+{
+    const size_t count = checkTriangles(mesh);
+    std::vector<uint32_t> triangles(count * 3);
+    writeTriangles(mesh, count, triangles.data());
+    return triangles;
+}
+
+void expandTriangles(const uint32_t *triangles, const size_t count,
+                     vtkIdType *cells)
+{
+    common::parallelForChunks(0, count, COPY_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            cells[i * 4] = 3;
+            cells[i * 4 + 1] = triangles[i * 3];
+            cells[i * 4 + 2] = triangles[i * 3 + 1];
+            cells[i * 4 + 3] = triangles[i * 3 + 2];
+        }
+    });
+}
+
+CompactMesh::CompactMesh(vtkPolyData *mesh)
+    : _points(vtkSmartPointer<vtkFloatArray>::New())
+    , _triangles(vtkSmartPointer<vtkUnsignedIntArray>::New())
+{
+    const size_t triangleCount = checkTriangles(mesh);
+    _triangles->SetNumberOfValues(triangleCount * 3);
+    writeTriangles(mesh, triangleCount, _triangles->GetPointer(0));
+
+    _points->SetNumberOfComponents(3);
+    if (!mesh->GetPoints())
+        return;
+
+    vtkDataArray *points = mesh->GetPoints()->GetData();
+    if (points->GetDataType() == VTK_FLOAT)
+    {
+        _points = vtkFloatArray::SafeDownCast(points);
+        return;
+    }
+    const size_t count = points->GetNumberOfTuples();
+    _points->SetNumberOfTuples(count);
+    switch (points->GetDataType())
+    {
+        vtkTemplateMacro(
+            convertPoints(static_cast<const VTK_TT *>(
+                              points->GetVoidPointer(0)),
+                          count, _points->GetPointer(0)));
+    default:
+        throw std::runtime_error("Unsupported point type");
+    }
+}
+
+CompactMesh::CompactMesh(vtkFloatArray *points,
+                         vtkUnsignedIntArray *triangles,
+                         vtkFloatArray *normals)
+    : _points(points)
+    , _triangles(triangles)
+{
+    if (points->GetNumberOfComponents() != 3)
+        throw std::runtime_error("Points must have 3 components");
+    if (triangles->GetNumberOfComponents() != 1 ||
+        triangles->GetNumberOfTuples() % 3 != 0)
+        throw std::runtime_error("Triangles must be 3 indices each");
+    if (normals)
+        setNormals(normals);
+}
+
+size_t CompactMesh::pointCount() const
+{
+    return _points->GetNumberOfTuples();
+}
+
+size_t CompactMesh::triangleCount() const
+{
+    return _triangles->GetNumberOfTuples() / 3;
+}
+
+size_t CompactMesh::memorySize() const
+{
+    return pointCount() * (_normals ? 6 : 3) * sizeof(float) +
+           triangleCount() * 3 * sizeof(uint32_t);
+}
+
+void CompactMesh::computeNormals()
+{
+    _normals = computeVertexNormals(_points->GetPointer(0), pointCount(),
+                                    _triangles->GetPointer(0),
+                                    triangleCount());
+}
+
+void CompactMesh::setNormals(vtkFloatArray *normals)
+{
+    if (normals && (normals->GetNumberOfComponents() != 3 ||
+                    size_t(normals->GetNumberOfTuples()) != pointCount()))
+        throw std::runtime_error("Normals don't match the points");
+    _normals = normals;
+}
+
+vtkSmartPointer<vtkCellArray> CompactMesh::toCellArray() const
+{
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    const size_t count = triangleCount();
+    expandTriangles(_triangles->GetPointer(0), count,
+                    cells->WritePointer(count, count * 4));
+    return cells;
+}
+
+vtkSmartPointer<vtkPolyData> CompactMesh::toPolyData() const
+{
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(_points);
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints(points);
+    mesh->SetPolys(toCellArray());
+    if (_normals)
+        mesh->GetPointData()->SetNormals(_normals);
+    return mesh;
+}
+
+}
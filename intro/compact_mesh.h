@@ -0,0 +1,123 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_COMPACT_MESH_H
+#define INTRO_COMPACT_MESH_H
+
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class vtkCellArray;
+class vtkFloatArray;
+class vtkPolyData;
+class vtkUnsignedIntArray;
+
+namespace mesh
+{
+
+/**
+   The 3 point indices of each triangle of a triangle mesh.
+   Throws std::runtime_error if there are other cells than triangles,
+   2^32 points or more or invalid point indices.
+ */
+std::vector<uint32_t> compactTriangles(vtkPolyData *mesh);
+
+/**
+   Writes count triangles of 3 indices as VTK cells (a size and 3 ids
+   each) in parallel.
+ */
+void expandTriangles(const uint32_t *triangles, size_t count,
+                     vtkIdType *cells);
+
+/**
+   Triangle mesh with float points, 32 bit indices and optionally vertex
+   normals.
+
+   A triangle takes 12 bytes instead of the 32 of a VTK 6 cell array
+   with 64 bit ids (a size and 3 ids), and points 12 bytes instead of 24
+   if they were double. VTK filters and mappers need cell arrays, so the
+   indices are expanded with toCellArray() only where the mesh is handed
+   over to VTK, MeshletCuller expands only the visible triangles.
+ */
+class CompactMesh
+{
+public:
+    /**
+       Converts a triangle mesh. Float points are shared, other types
+       are converted in parallel. Point data is not kept.
+       Throws std::runtime_error like compactTriangles.
+     */
+    explicit CompactMesh(vtkPolyData *mesh);
+
+    /**
+       Uses existing arrays without copying them, e.g. the ones mapped
+       from a MeshCache entry. The triangles are a single component array
+       of 3 indices per triangle, the indices are not checked here.
+       normals may be null.
+       Throws std::runtime_error if the array sizes don't match.
+     */
+    CompactMesh(vtkFloatArray *points, vtkUnsignedIntArray *triangles,
+                vtkFloatArray *normals = 0);
+
+    size_t pointCount() const;
+    size_t triangleCount() const;
+
+    vtkFloatArray *points() const { return _points; }
+    /** 3 indices per triangle */
+    vtkUnsignedIntArray *triangles() const { return _triangles; }
+    /** Vertex normals, null until computed or set */
+    vtkFloatArray *normals() const { return _normals; }
+
+    /** Bytes taken by the points, the triangles and the normals */
+    size_t memorySize() const;
+
+    /**
+       Computes area weighted vertex normals (see computeVertexNormals)
+       and keeps them as normals()
+     */
+    void computeNormals();
+
+    /**
+       Replaces the normals, e.g. with the ones of vtkPolyDataNormals.
+       Throws std::runtime_error if they don't have 3 components per point.
+     */
+    void setNormals(vtkFloatArray *normals);
+
+    /** All the triangles as a VTK cell array */
+    vtkSmartPointer<vtkCellArray> toCellArray() const;
+
+    /**
+       Poly data with the shared points and normals and the expanded
+       triangles
+     */
+    vtkSmartPointer<vtkPolyData> toPolyData() const;
+
+private:
+    vtkSmartPointer<vtkFloatArray> _points;
+    vtkSmartPointer<vtkUnsignedIntArray> _triangles;
+    vtkSmartPointer<vtkFloatArray> _normals;
+};
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/* Memory and vertex normal times of terrain meshes of 10^4 to 10^6
+   triangles stored the VTK way, with double points and 64 bit cell ids,
+   and as a CompactMesh, with float points and 32 bit indices. It also
+   times the conversion to the compact mesh and the expansion of its
+   triangles back to a VTK cell array, which is paid once per mapper
+   input. */
+
+#include "compact_mesh.h"
+#include "vertex_normals.h"
+
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+/* Height field of about count triangles with double points */
+vtkSmartPointer<vtkPolyData> terrainMesh(const size_t count)
+{
+    const size_t side = std::max(size_t(2), size_t(std::sqrt(count / 2.0)));
+    const size_t columns = side + 1;
+
+    vtkSmartPointer<vtkDoubleArray> coordinates =
+        vtkSmartPointer<vtkDoubleArray>::New();
+    coordinates->SetNumberOfComponents(3);
+    coordinates->SetNumberOfTuples(columns * columns);
+    double *point = coordinates->GetPointer(0);
+    for (size_t i = 0; i != columns; ++i)
+    {
+        for (size_t j = 0; j != columns; ++j, point += 3)
+        {
+            point[0] = double(j) / side;
+            point[1] = double(i) / side;
+            point[2] = 0.1 * std::sin(point[0] * 20) * std::cos(point[1] * 15);
+        }
+    }
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coordinates);
+
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    const size_t triangles = side * side * 2;
+    vtkIdType *ids = cells->WritePointer(triangles, triangles * 4);
+    for (size_t i = 0; i != side; ++i)
+    {
+        for (size_t j = 0; j != side; ++j, ids += 8)
+        {
+            const vtkIdType a = i * columns + j;
+            const vtkIdType b = a + 1;
+            const vtkIdType c = a + columns;
+            const vtkIdType d = c + 1;
+            const vtkIdType quad[8] = {3, a, b, d, 3, a, d, c};
+            std::copy(quad, quad + 8, ids);
+        }
+    }
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints(points);
+    mesh->SetPolys(cells);
+    return mesh;
+}
+
+int main(int argc, char *argv[])
+{
+    int maxExponent = 6;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxExponent = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max exponent]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << common::threadCount() << " threads" << std::endl;
+    std::cout << std::setw(12) << "triangles" << std::setw(12) << "VTK MB"
+              << std::setw(12) << "compact MB" << std::setw(12) << "convert ms"
+              << std::setw(12) << "VTK nrm ms" << std::setw(12) << "cmp nrm ms"
+              << std::setw(12) << "expand ms" << std::endl;
+    for (int exponent = 4; exponent <= maxExponent; ++exponent)
+    {
+        vtkSmartPointer<vtkPolyData> terrain =
+            terrainMesh(size_t(std::pow(10.0, exponent)));
+        const size_t vtkBytes =
+            terrain->GetNumberOfPoints() * 3 * sizeof(double) +
+            terrain->GetPolys()->GetNumberOfConnectivityEntries() *
+                sizeof(vtkIdType);
+
+        std::unique_ptr<mesh::CompactMesh> compact;
+        const double convert = common::measure([&]()
+        {
+            compact.reset(new mesh::CompactMesh(terrain));
+        });
+        /* Without the normals, like the VTK mesh */
+        const size_t compactBytes = compact->memorySize();
+        const double normals = common::measure([&]()
+        {
+            mesh::computeVertexNormals(terrain);
+        });
+        const double compactNormals = common::measure([&]()
+        {
+            compact->computeNormals();
+        });
+        const double expand = common::measure([&]()
+        {
+            compact->toCellArray();
+        });
+
+        std::cout << std::setw(12) << compact->triangleCount()
+                  << std::setw(12) << vtkBytes / 1e6
+                  << std::setw(12) << compactBytes / 1e6
+                  << std::setw(12) << convert * 1e3
+                  << std::setw(12) << normals * 1e3
+                  << std::setw(12) << compactNormals * 1e3
+                  << std::setw(12) << expand * 1e3 << std::endl;
+    }
+}
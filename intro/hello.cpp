@@ -16,41 +16,72 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include "compact_mesh.h"
+#include "instances.h"
+#include "mapped_ply_reader.h"
+#include "mesh_cache.h"
+#include "meshlets.h"
+#include "procedural_sources.h"
+#include "vertex_cache_optimizer.h"
+#include "vertex_normals.h"
+
+#include "common/animation_scheduler.h"
 #include "common/paths.h"
 
 #include <vtkActor.h>
+#include <vtkAlgorithm.h>
 #include <vtkCommand.h>
 #include <vtkCamera.h>
 #include <vtkProperty.h>
 #include <vtkCellArray.h>
-#include <vtkConeSource.h>
+#include <vtkFloatArray.h>
 #include <vtkInformation.h>
 #include <vtkPLYReader.h>
+#include <vtkPointData.h>
 #include <vtkPolyData.h>
 #include <vtkPoints.h>
+#include <vtkPolyDataAlgorithm.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkPolyDataNormals.h>
-#include <vtkSphereSource.h>
 #include <vtkRenderWindow.h>
 #include <vtkRenderer.h>
 #include <vtkRenderWindowInteractor.h>
 #include <vtkSmartPointer.h>
 
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <typeinfo>
 #include <unistd.h>
+#include <utility>
+#include <vector>
 
 void addConeActor(vtkRenderer *renderer);
 void addTetrahedron(vtkRenderer *renderer);
-void loadPlyModel(vtkRenderer *renderer);
-void addAnimation(vtkRenderer *renderer);
+void addConeField(vtkRenderer *renderer);
+void loadPlyModel(vtkRenderer *renderer, bool vtkNormals = false);
+void addAnimation(vtkRenderWindowInteractor *interactor,
+                  vtkRenderer *renderer, double fps = 60);
+
+const double ORBIT_DEGREES_PER_SECOND = 60;
+const int CONE_FIELD_SIDE = 100;
+/* Version of the processing done by readPlyModel, it's part of the tag of
+   the cached models and has to be bumped whenever the output changes.
+   2: triangles and vertices reordered for the vertex cache.
+   3: float points and 32 bit indices. */
+const int PLY_PROCESSING_VERSION = 3;
 
 int main()
 {
-    /* Source data object that represents a sphere. */
-    vtkSmartPointer<vtkSphereSource> sphere = vtkSphereSource::New();
-    sphere->SetCenter(0, 0, 0);
-    sphere->SetRadius(1);
+    /* Source data object that represents a unit sphere centered at the
+       origin, generated in parallel. */
+    vtkSmartPointer<mesh::ParallelSphereSource> sphere =
+        mesh::ParallelSphereSource::New();
 
     /* Mapper object that will convert the sphere source into polygonal
        mesh. */
@@ -72,6 +103,7 @@ int main()
 
     //addConeActor(renderer);
     addTetrahedron(renderer);
+    //addConeField(renderer);
     //loadPlyModel(renderer);
 
     vtkSmartPointer<vtkRenderWindow> window = vtkRenderWindow::New();
@@ -80,17 +112,18 @@ int main()
 
     /* Creating the interactor that handles the window events and provides
        the main rendering loop */
-    //addAnimation(renderer);
     vtkSmartPointer<vtkRenderWindowInteractor> interactor =
         vtkRenderWindowInteractor::New();
     interactor->SetRenderWindow(window);
     interactor->Initialize();
+    //addAnimation(interactor, renderer);
     interactor->Start();
 }
 
 void addConeActor(vtkRenderer *renderer)
 {
-    vtkSmartPointer<vtkConeSource> cone = vtkConeSource::New();
+    vtkSmartPointer<mesh::ParallelConeSource> cone =
+        mesh::ParallelConeSource::New();
     cone->SetResolution(64);
 
     vtkSmartPointer<vtkPolyDataMapper> mapper = vtkPolyDataMapper::New();
@@ -137,21 +170,154 @@ void addTetrahedron(vtkRenderer *renderer)
     renderer->AddActor(actor);
 }
 
-void loadPlyModel(vtkRenderer *renderer)
+void addConeField(vtkRenderer *renderer)
+{
+    /* A grid of cones below the other actors, turning and changing color
+       along the grid, drawn by a single actor and mapper */
+    const int side = CONE_FIELD_SIDE;
+    std::vector<mesh::Instance> instances(side * side);
+    for (int i = 0; i != side; ++i)
+    {
+        for (int j = 0; j != side; ++j)
+        {
+            mesh::Instance &instance = instances[i * side + j];
+            const float u = float(i) / (side - 1);
+            const float v = float(j) / (side - 1);
+            instance.position[0] = -2 + 8 * u;
+            instance.position[1] = -3;
+            instance.position[2] = -4 + 8 * v;
+            instance.orientation[0] = 0;
+            instance.orientation[1] = 360 * u;
+            instance.orientation[2] = 90 * v;
+            std::fill(instance.scale, instance.scale + 3,
+                      8.f / side * 0.8f);
+            instance.color[0] = uint8_t(255 * u);
+            instance.color[1] = uint8_t(255 * v);
+            instance.color[2] = 128;
+            instance.color[3] = 255;
+        }
+    }
+    renderer->AddActor(mesh::instancedActor(mesh::coneGeometry(16),
+                                            instances.data(),
+                                            instances.size()));
+}
+
+/* Culls the meshlets of an actor before each frame is rendered */
+class MeshletCulling : public vtkCommand
+{
+public:
+    static MeshletCulling *New(std::unique_ptr<mesh::MeshletCuller> culler,
+                               vtkActor *actor)
+    {
+        return new MeshletCulling(std::move(culler), actor);
+    }
+
+    virtual void Execute(vtkObject *caller, unsigned long, void*)
+    {
+        vtkRenderer *renderer = static_cast<vtkRenderer*>(caller);
+        const int *size = renderer->GetSize();
+        _culler->update(renderer->GetActiveCamera(),
+                        double(size[0]) / size[1], _actor->GetMatrix());
+    }
+
+private:
+    std::unique_ptr<mesh::MeshletCuller> _culler;
+    vtkActor *_actor;
+
+    MeshletCulling(std::unique_ptr<mesh::MeshletCuller> culler,
+                   vtkActor *actor)
+        : _culler(std::move(culler))
+        , _actor(actor)
+    {
+    }
+};
+
+vtkSmartPointer<vtkPolyData> readPlyModel(const std::string &filename)
 {
-    vtkSmartPointer<vtkPLYReader> reader = vtkPLYReader::New();
-    reader->SetFileName((common::dataPath() + "/bunny.ply").c_str());
-
-    /* Smoothing the model. The smoothing simply computes per vertex normals
-       and assigns them as attribute data to the vertices */
-    vtkSmartPointer<vtkPolyDataNormals> filter = vtkPolyDataNormals::New();
-    filter->ComputePointNormalsOn();
-    filter->ComputeCellNormalsOff();
-    filter->SetInputConnection(reader->GetOutputPort());
+    /* ASCII files are parsed in parallel by MappedPLYReader, vtkPLYReader
+       takes the rest. */
+    vtkSmartPointer<vtkAlgorithm> reader;
+    if (mesh::MappedPLYReader::CanReadFile(filename))
+    {
+        vtkSmartPointer<mesh::MappedPLYReader> mapped =
+            mesh::MappedPLYReader::New();
+        mapped->SetFileName(filename);
+        reader = mapped.GetPointer();
+    }
+    else
+    {
+        vtkSmartPointer<vtkPLYReader> ply = vtkPLYReader::New();
+        ply->SetFileName(filename.c_str());
+        reader = ply.GetPointer();
+    }
+
+    /* Reordering the triangles for the vertex cache and the vertices in
+       first use order, this also speeds up the normal computation. Meshes
+       with other polygons are passed through. */
+    vtkSmartPointer<mesh::VertexCacheOptimizer> optimizer =
+        vtkSmartPointer<mesh::VertexCacheOptimizer>::New();
+    optimizer->SetInputConnection(reader->GetOutputPort());
+    optimizer->Update();
+    std::cout << "Average cache miss ratio "
+              << optimizer->GetInputCacheMissRatio() << " -> "
+              << optimizer->GetOutputCacheMissRatio() << std::endl;
+    return optimizer->GetOutput();
+}
+
+/* Smoothing the model. The smoothing simply computes per vertex normals
+   and assigns them as attribute data to the vertices. VertexNormalsFilter
+   does it in parallel, vtkPolyDataNormals also makes the polygon
+   orientation consistent and splits sharp edges. */
+vtkSmartPointer<vtkPolyData> smoothModel(vtkPolyData *model,
+                                         const bool vtkNormals)
+{
+    vtkSmartPointer<vtkPolyDataAlgorithm> filter;
+    if (vtkNormals)
+    {
+        vtkSmartPointer<vtkPolyDataNormals> normals =
+            vtkPolyDataNormals::New();
+        normals->ComputePointNormalsOn();
+        normals->ComputeCellNormalsOff();
+        filter = normals.GetPointer();
+    }
+    else
+    {
+        vtkSmartPointer<mesh::VertexNormalsFilter> normals =
+            vtkSmartPointer<mesh::VertexNormalsFilter>::New();
+        filter = normals.GetPointer();
+    }
+    filter->SetInputDataObject(0, model);
     filter->Update();
+    return filter->GetOutput();
+}
 
+/* Smooths a triangle mesh and keeps it as a CompactMesh (float points and
+   32 bit indices), which computes the normals in parallel from its index
+   list. vtkPolyDataNormals needs a VTK cell array, its output is
+   converted. */
+std::unique_ptr<mesh::CompactMesh> smoothTriangles(vtkPolyData *model,
+                                                   const bool vtkNormals)
+{
+    if (!vtkNormals)
+    {
+        std::unique_ptr<mesh::CompactMesh> compact(
+            new mesh::CompactMesh(model));
+        compact->computeNormals();
+        return compact;
+    }
+    vtkSmartPointer<vtkPolyData> smoothed = smoothModel(model, true);
+    std::unique_ptr<mesh::CompactMesh> compact(
+        new mesh::CompactMesh(smoothed));
+    compact->setNormals(
+        vtkFloatArray::SafeDownCast(smoothed->GetPointData()->GetNormals()));
+    return compact;
+}
+
+vtkSmartPointer<vtkActor> addModelActor(vtkRenderer *renderer,
+                                        vtkPolyData *data)
+{
     vtkSmartPointer<vtkPolyDataMapper> mapper = vtkPolyDataMapper::New();
-    mapper->SetInputConnection(filter->GetOutputPort());
+    mapper->SetInputDataObject(0, data);
 
     vtkSmartPointer<vtkActor> actor = vtkActor::New();
     actor->SetPosition(5, -1, 0);
@@ -159,28 +325,87 @@ void loadPlyModel(vtkRenderer *renderer)
     actor->SetMapper(mapper);
     actor->GetProperty()->SetColor(1, 1, 0.5);
     renderer->AddActor(actor);
+    return actor;
 }
 
-
-class Animation : public vtkCommand
+void loadPlyModel(vtkRenderer *renderer, const bool vtkNormals)
 {
-public:
-    static Animation *New()
-    {
-        return new Animation;
-    }
+    const std::string filename = common::dataPath() + "/bunny.ply";
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
 
-    virtual void Execute(vtkObject *caller, unsigned long, void*)
+    /* The smoothed model is cached on disk, the next runs map it in
+       without parsing the file nor computing the normals. Each normals
+       method has its own entries. */
+    std::ostringstream pipeline;
+    pipeline << (vtkNormals ? "vtk_normals" : "vertex_normals") << ".v"
+             << PLY_PROCESSING_VERSION;
+    mesh::MeshCache cache(pipeline.str());
+    std::unique_ptr<mesh::CompactMesh> model = cache.loadCompact(filename);
+    const bool cached = model.get() != 0;
+    if (!cached)
     {
-        vtkRenderer *renderer = static_cast<vtkRenderer*>(caller);
-        renderer->GetActiveCamera()->Azimuth(1);
-        renderer->GetRenderWindow()->Start();
-        std::cout << "HELLO" << std::endl;
+        vtkSmartPointer<vtkPolyData> polygons = readPlyModel(filename);
+        /* A failed read leaves an empty mesh, which must not be cached:
+           it would be mapped in on the next runs instead of reading the
+           file again. */
+        if (polygons->GetNumberOfPolys() == 0)
+        {
+            std::cerr << "No polygons read from " << filename << std::endl;
+            return;
+        }
+        /* The cache, CompactMesh and the meshlets only take triangles,
+           other polygon meshes are smoothed and drawn whole. */
+        if (!mesh::isTriangleMesh(polygons))
+        {
+            std::cout << filename << " has other polygons than triangles,"
+                      << " drawn without caching nor culling" << std::endl;
+            addModelActor(renderer, smoothModel(polygons, vtkNormals));
+            return;
+        }
+        model = smoothTriangles(polygons, vtkNormals);
+        try
+        {
+            cache.store(filename, *model);
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
     }
-};
+    std::cout << filename << (cached ? " mapped from " : " cached in ")
+              << cache.entryFilename(filename) << " in "
+              << std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - start).count()
+              << " ms" << std::endl;
 
-void addAnimation(vtkRenderer *renderer)
+    /* The mapper draws only the meshlets that may be visible, back faces
+       are culled by the actor as well so the normal cones can be used.
+       Only the visible triangles are expanded to a VTK cell array. */
+    std::unique_ptr<mesh::MeshletCuller> culler(
+        new mesh::MeshletCuller(*model));
+    std::cout << culler->meshletCount() << " meshlets" << std::endl;
+
+    vtkSmartPointer<vtkActor> actor =
+        addModelActor(renderer, culler->output());
+    actor->GetProperty()->BackfaceCullingOn();
+
+    vtkSmartPointer<MeshletCulling> culling =
+        MeshletCulling::New(std::move(culler), actor);
+    renderer->AddObserver(vtkCommand::StartEvent, culling);
+}
+
+
+void addAnimation(vtkRenderWindowInteractor *interactor,
+                  vtkRenderer *renderer, const double fps)
 {
-    vtkSmartPointer<Animation> animation = Animation::New();
-    renderer->AddObserver(vtkCommand::EndEvent, animation);
+    /* The camera orbits at a constant speed whatever the frame rate */
+    vtkCamera *camera = renderer->GetActiveCamera();
+    vtkSmartPointer<common::AnimationScheduler> animation =
+        common::AnimationScheduler::New();
+    animation->SetStep([camera](const double seconds)
+    {
+        camera->Azimuth(ORBIT_DEGREES_PER_SECOND * seconds);
+    });
+    animation->Start(interactor, fps);
 }
@@ -0,0 +1,114 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+
+#include "instances.h"
+
+#include "common/parallel.h"
+
+#include <vtkActor.h>
+#include <vtkFloatArray.h>
+#include <vtkGlyph3DMapper.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <algorithm>
+
+namespace mesh
+{
+
+namespace
+{
+
+const size_t INSTANCE_CHUNK = 1 << 14;
+
+}
+
+vtkSmartPointer<vtkPolyData> instancePolyData(const Instance *instances,
+                                              const size_t count)
+{
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataTypeToFloat();
+    points->SetNumberOfPoints(count);
+    vtkSmartPointer<vtkFloatArray> orientations =
+        vtkSmartPointer<vtkFloatArray>::New();
+    orientations->SetName("Orientation");
+    orientations->SetNumberOfComponents(3);
+    orientations->SetNumberOfTuples(count);
+    vtkSmartPointer<vtkFloatArray> scales =
+        vtkSmartPointer<vtkFloatArray>::New();
+    scales->SetName("Scale");
+    scales->SetNumberOfComponents(3);
+    scales->SetNumberOfTuples(count);
+    vtkSmartPointer<vtkUnsignedCharArray> colors =
+        vtkSmartPointer<vtkUnsignedCharArray>::New();
+    colors->SetName("Colors");
+    colors->SetNumberOfComponents(4);
+    colors->SetNumberOfTuples(count);
+
+    float *position = static_cast<float *>(points->GetVoidPointer(0));
+    float *orientation = orientations->GetPointer(0);
+    float *scale = scales->GetPointer(0);
+    uint8_t *color = colors->GetPointer(0);
+    common::parallelForChunks(0, count, INSTANCE_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const Instance &instance = instances[i];
+            std::copy(instance.position, instance.position + 3,
+                      position + i * 3);
+            std::copy(instance.orientation, instance.orientation + 3,
+                      orientation + i * 3);
+            std::copy(instance.scale, instance.scale + 3, scale + i * 3);
+            std::copy(instance.color, instance.color + 4, color + i * 4);
+        }
+    });
+
+    vtkSmartPointer<vtkPolyData> data = vtkSmartPointer<vtkPolyData>::New();
+    data->SetPoints(points);
+    data->GetPointData()->AddArray(orientations);
+    data->GetPointData()->AddArray(scales);
+    data->GetPointData()->SetScalars(colors);
+    return data;
+}
+
+vtkSmartPointer<vtkActor> instancedActor(vtkPolyData *source,
+                                         const Instance *instances,
+                                         const size_t count)
+{
+    vtkSmartPointer<vtkGlyph3DMapper> mapper =
+        vtkSmartPointer<vtkGlyph3DMapper>::New();
+    mapper->SetSourceData(source);
+    mapper->SetInputData(instancePolyData(instances, count));
+    mapper->SetOrientationArray("Orientation");
+    mapper->SetOrientationModeToRotation();
+    mapper->SetScaleArray("Scale");
+    mapper->SetScaleModeToScaleByVectorComponents();
+    /* Unsigned char scalars are used as colors by the default color
+       mode */
+
+    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mapper);
+    return actor;
+}
+
+}
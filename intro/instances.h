@@ -0,0 +1,67 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_INSTANCES_H
+#define INTRO_INSTANCES_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <cstdint>
+
+class vtkActor;
+class vtkPolyData;
+
+namespace mesh
+{
+
+/**
+   Placement and color of a copy of a shared geometry, 40 bytes.
+ */
+struct Instance
+{
+    float position[3];
+    /* Rotations in degrees around the x, y and z axes, with the same
+       convention as vtkProp3D::SetOrientation */
+    float orientation[3];
+    float scale[3];
+    /* RGBA */
+    uint8_t color[4];
+};
+
+/**
+   Poly data with a point per instance and the point arrays that
+   vtkGlyph3DMapper reads: "Orientation" and "Scale" with 3 float
+   components and "Colors", the RGBA scalars. Filled in parallel.
+ */
+vtkSmartPointer<vtkPolyData> instancePolyData(const Instance *instances,
+                                              size_t count);
+
+/**
+   Returns a single actor that draws a copy of source for every instance
+   with a vtkGlyph3DMapper, instead of an actor and a mapper per copy.
+   The colors of the instances replace the actor color.
+ */
+vtkSmartPointer<vtkActor> instancedActor(vtkPolyData *source,
+                                         const Instance *instances,
+                                         size_t count);
+
+}
+
+#endif
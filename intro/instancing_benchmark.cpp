@@ -0,0 +1,244 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+
+/* Setup time, memory and frame times of 10^4 to 10^6 cones drawn with
+   an actor and a mapper per cone and with a single instanced actor,
+   rendered offscreen. Each scene is built in a child process so the
+   resident memory it adds is measured from a clean heap. */
+
+#include "instances.h"
+
+#include "common/timing.h"
+
+#include <vtkActor.h>
+#include <vtkCamera.h>
+#include <vtkConeSource.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+const int FRAMES = 5;
+
+struct Result
+{
+    double setup;
+    /* Resident memory added by the scene before the first frame */
+    double megabytes;
+    double firstFrame;
+    double frame;
+};
+
+size_t residentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/* Random cones in a cube of side 100 */
+std::vector<mesh::Instance> randomInstances(const size_t count)
+{
+    std::mt19937 random(0);
+    std::uniform_real_distribution<float> position(-50, 50);
+    std::uniform_real_distribution<float> angle(0, 360);
+    std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+    std::uniform_int_distribution<int> channel(64, 255);
+    std::vector<mesh::Instance> instances(count);
+    for (size_t i = 0; i != count; ++i)
+    {
+        mesh::Instance &instance = instances[i];
+        for (int j = 0; j != 3; ++j)
+        {
+            instance.position[j] = position(random);
+            instance.orientation[j] = angle(random);
+            instance.scale[j] = scale(random);
+            instance.color[j] = uint8_t(channel(random));
+        }
+        instance.color[3] = 255;
+    }
+    return instances;
+}
+
+void addActors(vtkRenderer *renderer, vtkPolyData *source,
+               const std::vector<mesh::Instance> &instances)
+{
+    for (size_t i = 0; i != instances.size(); ++i)
+    {
+        const mesh::Instance &instance = instances[i];
+        vtkSmartPointer<vtkPolyDataMapper> mapper =
+            vtkSmartPointer<vtkPolyDataMapper>::New();
+        mapper->SetInputDataObject(0, source);
+        vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+        actor->SetMapper(mapper);
+        actor->SetPosition(instance.position[0], instance.position[1],
+                           instance.position[2]);
+        actor->SetOrientation(instance.orientation[0],
+                              instance.orientation[1],
+                              instance.orientation[2]);
+        actor->SetScale(instance.scale[0], instance.scale[1],
+                        instance.scale[2]);
+        actor->GetProperty()->SetColor(instance.color[0] / 255.0,
+                                       instance.color[1] / 255.0,
+                                       instance.color[2] / 255.0);
+        renderer->AddActor(actor);
+    }
+}
+
+/* Builds a scene with addProps in a child process and renders it */
+Result measure(const std::function<void(vtkRenderer *)> &addProps)
+{
+    Result result = Result();
+    int channel[2];
+    if (pipe(channel) != 0)
+        return result;
+    const pid_t child = fork();
+    if (child == 0)
+    {
+        close(channel[0]);
+        const size_t before = residentBytes();
+        vtkSmartPointer<vtkRenderer> renderer =
+            vtkSmartPointer<vtkRenderer>::New();
+        result.setup = common::measure([&]() { addProps(renderer); });
+        result.megabytes = (residentBytes() - double(before)) / (1 << 20);
+
+        vtkSmartPointer<vtkRenderWindow> window =
+            vtkSmartPointer<vtkRenderWindow>::New();
+        window->SetOffScreenRendering(1);
+        window->AddRenderer(renderer);
+        window->SetSize(512, 512);
+        renderer->ResetCamera();
+        result.firstFrame = common::measure([&]() { window->Render(); });
+        result.frame = common::measure([&]()
+        {
+            for (int i = 0; i != FRAMES; ++i)
+            {
+                renderer->GetActiveCamera()->Azimuth(1);
+                window->Render();
+            }
+        }) / FRAMES;
+        if (write(channel[1], &result, sizeof(result)) != sizeof(result))
+            _exit(1);
+        _exit(0);
+    }
+    close(channel[1]);
+    if (child == -1 ||
+        read(channel[0], &result, sizeof(result)) != sizeof(result))
+        result = Result();
+    close(channel[0]);
+    if (child != -1)
+        waitpid(child, 0, 0);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    int maxExponent = 6;
+    /* An actor and a mapper take a few KB, a million of them several GB */
+    int maxActorExponent = 5;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxExponent = atoi(argv[++i]);
+        else if (arg == "--max-actors" && i + 1 < argc)
+            maxActorExponent = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--max exponent] [--max-actors exponent]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    vtkSmartPointer<vtkConeSource> cone =
+        vtkSmartPointer<vtkConeSource>::New();
+    cone->SetResolution(16);
+    cone->Update();
+    vtkPolyData *source = cone->GetOutput();
+
+    std::cout << "Actors / instanced, " << FRAMES
+              << " frames of 512x512 after the first one" << std::endl;
+    std::cout << std::setw(10) << "instances" << std::setw(22) << "setup ms"
+              << std::setw(20) << "MB" << std::setw(22) << "first frame ms"
+              << std::setw(20) << "frame ms" << std::setw(14)
+              << "us/actor" << std::endl;
+    for (int exponent = 4; exponent <= maxExponent; ++exponent)
+    {
+        const std::vector<mesh::Instance> instances =
+            randomInstances(size_t(std::pow(10.0, exponent)));
+        const Result instanced = measure([&](vtkRenderer *renderer)
+        {
+            renderer->AddActor(mesh::instancedActor(
+                source, instances.data(), instances.size()));
+        });
+        Result actors = Result();
+        const bool withActors = exponent <= maxActorExponent;
+        if (withActors)
+            actors = measure([&](vtkRenderer *renderer)
+            {
+                addActors(renderer, source, instances);
+            });
+
+        /* Each pair is printed as actors / instanced */
+        std::cout << std::setw(10) << instances.size() << std::fixed
+                  << std::setprecision(1);
+        const double columns[4][2] = {
+            {actors.setup * 1e3, instanced.setup * 1e3},
+            {actors.megabytes, instanced.megabytes},
+            {actors.firstFrame * 1e3, instanced.firstFrame * 1e3},
+            {actors.frame * 1e3, instanced.frame * 1e3}};
+        const int widths[4] = {22, 20, 22, 20};
+        for (int i = 0; i != 4; ++i)
+        {
+            std::cout << std::setw(widths[i] - 11);
+            if (withActors)
+                std::cout << columns[i][0];
+            else
+                std::cout << "-";
+            std::cout << " / " << std::setw(8) << columns[i][1];
+        }
+        /* Frame time per actor that instancing saves */
+        std::cout << std::setw(14);
+        if (withActors)
+            std::cout << (actors.frame - instanced.frame) /
+                             instances.size() * 1e6;
+        else
+            std::cout << "-";
+        std::cout << std::endl;
+    }
+}
@@ -0,0 +1,669 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "mapped_ply_reader.h"
+
+#include "common/mapped_file.h"
+#include "common/parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace mesh
+{
+
+namespace
+{
+
+/* Body bytes per parsing chunk */
+const size_t CHUNK_BYTES = 1 << 20;
+/* Longer numbers are copied into a string before calling strtod */
+const size_t MAX_NUMBER_LENGTH = 64;
+/* Largest mantissa and power of 10 that are exact doubles */
+const uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 53;
+const int MAX_EXACT_EXPONENT = 22;
+const double POWERS_OF_10[MAX_EXACT_EXPONENT + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* Vertex properties read, in the order of their components */
+const char *const VERTEX_PROPERTIES[] = {"x", "y", "z", "nx", "ny", "nz"};
+const int VERTEX_PROPERTY_COUNT = 6;
+/* Properties vtkPLYReader reads that this reader doesn't support */
+const char *const UNSUPPORTED_VERTEX_PROPERTIES[] = {
+    "red", "green", "blue", "diffuse_red", "diffuse_green", "diffuse_blue",
+    "u", "v", "texture_u", "texture_v"};
+const char *const UNSUPPORTED_FACE_PROPERTIES[] = {
+    "intensity", "red", "green", "blue"};
+
+inline bool isBlank(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+double slowParseDouble(const char *begin, const char *end)
+{
+    const size_t length = end - begin;
+    if (length < MAX_NUMBER_LENGTH)
+    {
+        char buffer[MAX_NUMBER_LENGTH];
+        memcpy(buffer, begin, length);
+        buffer[length] = 0;
+        return strtod(buffer, 0);
+    }
+    return strtod(std::string(begin, end).c_str(), 0);
+}
+
+/* Same result as strtod for a whole token. Numbers with up to 19
+   significant digits whose mantissa and power of 10 are exact doubles
+   are converted with a single multiplication or division, which is
+   correctly rounded. */
+double parseDouble(const char *begin, const char *end)
+{
+    const char *p = begin;
+    const bool negative = *p == '-';
+    if (*p == '-' || *p == '+')
+        ++p;
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    for (; p != end && isDigit(*p); ++p)
+    {
+        any = true;
+        if (mantissa == 0 && *p == '0')
+            continue;
+        if (++digits > 19)
+            return slowParseDouble(begin, end);
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p != end && *p == '.')
+    {
+        for (++p; p != end && isDigit(*p); ++p)
+        {
+            any = true;
+            --exponent;
+            if (mantissa == 0 && *p == '0')
+                continue;
+            if (++digits > 19)
+                return slowParseDouble(begin, end);
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+    }
+    if (any && p != end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        const bool negativeExponent = p != end && *p == '-';
+        if (p != end && (*p == '-' || *p == '+'))
+            ++p;
+        if (p == end || !isDigit(*p))
+            return slowParseDouble(begin, end);
+        int value = 0;
+        for (; p != end && isDigit(*p); ++p)
+        {
+            if (value > 10000)
+                return slowParseDouble(begin, end);
+            value = value * 10 + (*p - '0');
+        }
+        exponent += negativeExponent ? -value : value;
+    }
+    /* Hexadecimal, infinities, NaNs and anything strtod stops in */
+    if (!any || p != end)
+        return slowParseDouble(begin, end);
+
+    double value;
+    if (mantissa == 0)
+        value = 0;
+    else if (mantissa <= MAX_EXACT_MANTISSA &&
+             exponent >= -MAX_EXACT_EXPONENT &&
+             exponent <= MAX_EXACT_EXPONENT)
+        value = exponent < 0 ? mantissa / POWERS_OF_10[-exponent] :
+                               mantissa * POWERS_OF_10[exponent];
+    else
+        return slowParseDouble(begin, end);
+    return negative ? -value : value;
+}
+
+/* Same result as atoi for a token */
+int parseInt(const char *p, const char *end)
+{
+    const bool negative = *p == '-';
+    if (*p == '-' || *p == '+')
+        ++p;
+    int64_t value = 0;
+    for (; p != end && isDigit(*p); ++p)
+        value = value * 10 + (*p - '0');
+    return int(negative ? -value : value);
+}
+
+/* Reads the values of a line as vtkPLY does for ASCII files: integer
+   properties with atoi and the rest with atof */
+class LineParser
+{
+public:
+    LineParser(const char *begin, const char *end)
+        : _position(begin)
+        , _end(end)
+    {
+    }
+
+    double nextValue(const bool integer)
+    {
+        const char *end = _next();
+        const double value = integer ? parseInt(_token, end) :
+                                       parseDouble(_token, end);
+        return value;
+    }
+
+    int nextInt(const bool integer)
+    {
+        const char *end = _next();
+        return integer ? parseInt(_token, end) :
+                         int(parseDouble(_token, end));
+    }
+
+    void skip() { _next(); }
+
+    /* Skips a property, list properties take their count and values */
+    void skip(const bool list, const bool integer)
+    {
+        if (!list)
+        {
+            skip();
+            return;
+        }
+        const int count = nextInt(true);
+        for (int i = 0; i < count; ++i)
+            nextValue(integer);
+    }
+
+private:
+    const char *_position;
+    const char *_end;
+    const char *_token;
+
+    /* Moves to the next token and returns its end */
+    const char *_next()
+    {
+        while (_position != _end && isBlank(*_position))
+            ++_position;
+        if (_position == _end)
+            throw std::runtime_error("Missing values in a PLY line");
+        _token = _position;
+        while (_position != _end && !isBlank(*_position))
+            ++_position;
+        return _position;
+    }
+};
+
+/* Calls f(line, begin, end) for the lines of [begin, end) until the line
+   number reaches lastLine. */
+template<typename F>
+void forEachLine(const char *begin, const char *end, size_t line,
+                 const size_t lastLine, const F &f)
+{
+    while (begin != end && line < lastLine)
+    {
+        const char *newline =
+            static_cast<const char *>(memchr(begin, '\n', end - begin));
+        const char *lineEnd = newline ? newline : end;
+        f(line, begin, lineEnd);
+        ++line;
+        begin = newline ? newline + 1 : end;
+    }
+}
+
+bool parseIntegerType(const std::string &type, bool &integer)
+{
+    static const char *const INTEGERS[] = {
+        "char", "uchar", "short", "ushort", "int", "uint", "int8", "uint8",
+        "int16", "uint16", "int32", "uint32"};
+    static const char *const FLOATS[] = {
+        "float", "double", "float32", "float64"};
+    integer = std::find(INTEGERS, INTEGERS + 12, type) != INTEGERS + 12;
+    return integer || std::find(FLOATS, FLOATS + 4, type) != FLOATS + 4;
+}
+
+template<size_t N>
+bool contains(const char *const (&names)[N], const std::string &name)
+{
+    return std::find(names, names + N, name) != names + N;
+}
+
+}
+
+vtkStandardNewMacro(MappedPLYReader);
+
+MappedPLYReader::MappedPLYReader()
+{
+    SetNumberOfInputPorts(0);
+}
+
+MappedPLYReader::~MappedPLYReader()
+{
+}
+
+void MappedPLYReader::SetFileName(const std::string &filename)
+{
+    if (filename == _filename)
+        return;
+    _filename = filename;
+    Modified();
+}
+
+bool MappedPLYReader::CanReadFile(const std::string &filename)
+{
+    try
+    {
+        vtkSmartPointer<common::MappedFile> file =
+            vtkSmartPointer<common::MappedFile>::New();
+        file->Open(filename);
+        Header header;
+        std::string error;
+        return _parseHeader(file->GetData(), file->GetSize(), header, error);
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+}
+
+int MappedPLYReader::RequestData(vtkInformation *, vtkInformationVector **,
+                                 vtkInformationVector *outputVector)
+{
+    vtkPolyData *output = vtkPolyData::GetData(outputVector);
+    try
+    {
+        vtkSmartPointer<common::MappedFile> file =
+            vtkSmartPointer<common::MappedFile>::New();
+        file->Open(_filename);
+        Header header;
+        std::string error;
+        if (!_parseHeader(file->GetData(), file->GetSize(), header, error))
+        {
+            vtkErrorMacro(<< _filename << ": " << error);
+            return 0;
+        }
+        _parseBody(file->GetData(), file->GetSize(), header, output);
+    }
+    catch (const std::runtime_error &e)
+    {
+        vtkErrorMacro(<< _filename << ": " << e.what());
+        return 0;
+    }
+    return 1;
+}
+
+bool MappedPLYReader::_parseHeader(const char *data, const size_t size,
+                                   Header &header, std::string &error)
+{
+    header.elements.clear();
+    header.offset = 0;
+
+    const char *position = data;
+    const char *end = data + size;
+    bool format = false;
+    for (size_t line = 0; position != end && header.offset == 0; ++line)
+    {
+        const char *newline = static_cast<const char *>(
+            memchr(position, '\n', end - position));
+        const char *lineEnd = newline ? newline : end;
+        std::vector<std::string> words;
+        for (const char *p = position; p != lineEnd;)
+        {
+            while (p != lineEnd && isBlank(*p))
+                ++p;
+            const char *word = p;
+            while (p != lineEnd && !isBlank(*p))
+                ++p;
+            if (p != word)
+                words.push_back(std::string(word, p));
+        }
+        position = newline ? newline + 1 : end;
+
+        if (line == 0)
+        {
+            if (words.size() != 1 || words[0] != "ply")
+            {
+                error = "Not a PLY file";
+                return false;
+            }
+            continue;
+        }
+        if (words.empty() || words[0] == "comment" ||
+            words[0] == "obj_info")
+            continue;
+
+        if (words[0] == "format")
+        {
+            if (words.size() < 2 || words[1] != "ascii")
+            {
+                error = "Only ASCII PLY files are parsed";
+                return false;
+            }
+            format = true;
+        }
+        else if (words[0] == "element" && words.size() == 3)
+        {
+            Element element;
+            element.name = words[1];
+            element.count = strtoull(words[2].c_str(), 0, 10);
+            header.elements.push_back(element);
+        }
+        else if (words[0] == "property" && !header.elements.empty())
+        {
+            Property property;
+            property.list = words.size() == 5 && words[1] == "list";
+            if (!property.list && words.size() != 3)
+            {
+                error = "Invalid property";
+                return false;
+            }
+            bool countInteger = true;
+            if (!parseIntegerType(words[words.size() - 2],
+                                  property.integer) ||
+                (property.list && !parseIntegerType(words[2], countInteger)))
+            {
+                error = "Unsupported property type";
+                return false;
+            }
+            property.name = words.back();
+            header.elements.back().properties.push_back(property);
+        }
+        else if (words[0] == "end_header")
+            header.offset = position - data;
+        else
+        {
+            error = "Invalid header line";
+            return false;
+        }
+    }
+    if (!format || header.offset == 0)
+    {
+        error = "Incomplete header";
+        return false;
+    }
+
+    bool vertices = false;
+    for (size_t i = 0; i != header.elements.size(); ++i)
+    {
+        const Element &element = header.elements[i];
+        if (element.name == "vertex")
+        {
+            int coordinates = 0;
+            for (size_t j = 0; j != element.properties.size(); ++j)
+            {
+                const Property &property = element.properties[j];
+                if (contains(UNSUPPORTED_VERTEX_PROPERTIES, property.name))
+                {
+                    error = "Vertex colors and texture coordinates are not "
+                            "supported";
+                    return false;
+                }
+                if (!property.list &&
+                    (property.name == "x" || property.name == "y" ||
+                     property.name == "z"))
+                    ++coordinates;
+            }
+            vertices = coordinates == 3;
+        }
+        else if (element.name == "face")
+        {
+            bool indices = false;
+            for (size_t j = 0; j != element.properties.size(); ++j)
+            {
+                const Property &property = element.properties[j];
+                if (contains(UNSUPPORTED_FACE_PROPERTIES, property.name))
+                {
+                    error = "Face colors and intensities are not supported";
+                    return false;
+                }
+                indices |= property.list && property.name == "vertex_indices";
+            }
+            if (!indices)
+            {
+                error = "Faces without vertex_indices";
+                return false;
+            }
+        }
+    }
+    if (!vertices)
+    {
+        error = "No vertex coordinates";
+        return false;
+    }
+    return true;
+}
+
+void MappedPLYReader::_parseBody(const char *data, const size_t size,
+                                 const Header &header, vtkPolyData *output)
+{
+    const std::vector<Element> &elements = header.elements;
+    /* First line of each element and line after the last element */
+    std::vector<size_t> elementLines(elements.size() + 1, 0);
+    size_t vertexElement = elements.size();
+    size_t faceElement = elements.size();
+    for (size_t i = 0; i != elements.size(); ++i)
+    {
+        elementLines[i + 1] = elementLines[i] + elements[i].count;
+        if (elements[i].name == "vertex")
+            vertexElement = i;
+        else if (elements[i].name == "face")
+            faceElement = i;
+    }
+    const size_t lineCount = elementLines.back();
+    /* Lines of the faces, none if there's no face element */
+    const bool hasFaces = faceElement != elements.size();
+    const size_t firstFaceLine = hasFaces ? elementLines[faceElement] : 0;
+    const size_t lastFaceLine = hasFaces ? elementLines[faceElement + 1] : 0;
+
+    /* Component of the vertex properties read, -1 for skipped ones */
+    const Element &vertex = elements[vertexElement];
+    std::vector<int> components(vertex.properties.size(), -1);
+    int found = 0;
+    for (size_t i = 0; i != vertex.properties.size(); ++i)
+    {
+        const char *const *name = std::find(
+            VERTEX_PROPERTIES, VERTEX_PROPERTIES + VERTEX_PROPERTY_COUNT,
+            vertex.properties[i].name);
+        if (name != VERTEX_PROPERTIES + VERTEX_PROPERTY_COUNT &&
+            !vertex.properties[i].list)
+        {
+            components[i] = name - VERTEX_PROPERTIES;
+            found |= 1 << components[i];
+        }
+    }
+    /* Normals are read only if the three components are present */
+    const bool hasNormals = (found & 070) == 070;
+
+    /* Chunks of the body ending right after a newline */
+    const char *body = data + header.offset;
+    const char *end = data + size;
+    const size_t bodySize = end - body;
+    const size_t chunkCount = std::max(size_t(1), bodySize / CHUNK_BYTES);
+    std::vector<const char *> bounds(chunkCount + 1);
+    bounds[0] = body;
+    bounds[chunkCount] = end;
+    for (size_t i = 1; i < chunkCount; ++i)
+    {
+        const char *p = std::max(body + bodySize / chunkCount * i,
+                                 bounds[i - 1]);
+        const char *newline =
+            static_cast<const char *>(memchr(p, '\n', end - p));
+        bounds[i] = newline ? newline + 1 : end;
+    }
+
+    /* Pass 1: first line of each chunk */
+    std::vector<size_t> firstLines(chunkCount + 1, 0);
+    common::parallelForChunks(0, chunkCount, 1,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            size_t lines = std::count(bounds[i], bounds[i + 1], '\n');
+            if (bounds[i + 1] != bounds[i] && bounds[i + 1][-1] != '\n')
+                ++lines;
+            firstLines[i + 1] = lines;
+        }
+    });
+    for (size_t i = 0; i != chunkCount; ++i)
+        firstLines[i + 1] += firstLines[i];
+    if (firstLines.back() < lineCount)
+        throw std::runtime_error("Truncated PLY body");
+
+    /* Pass 2: connectivity offset of the faces of each chunk */
+    std::vector<size_t> cellOffsets(chunkCount + 1, 0);
+    size_t vertexIndices = 0;
+    if (hasFaces)
+    {
+        const Element &face = elements[faceElement];
+        while (face.properties[vertexIndices].name != "vertex_indices" ||
+               !face.properties[vertexIndices].list)
+            ++vertexIndices;
+        common::parallelForChunks(0, chunkCount, 1,
+                                  [&](const size_t first, const size_t last)
+        {
+            for (size_t i = first; i != last; ++i)
+            {
+                size_t connectivity = 0;
+                forEachLine(bounds[i], bounds[i + 1], firstLines[i],
+                            lastFaceLine,
+                            [&](const size_t line, const char *begin,
+                                const char *lineEnd)
+                {
+                    if (line < firstFaceLine)
+                        return;
+                    LineParser values(begin, lineEnd);
+                    for (size_t j = 0; j != vertexIndices; ++j)
+                        values.skip(face.properties[j].list,
+                                    face.properties[j].integer);
+                    const int count = values.nextInt(true);
+                    if (count < 0)
+                        throw std::runtime_error("Invalid face");
+                    connectivity += count + 1;
+                });
+                cellOffsets[i + 1] = connectivity;
+            }
+        });
+        for (size_t i = 0; i != chunkCount; ++i)
+            cellOffsets[i + 1] += cellOffsets[i];
+    }
+
+    /* Pass 3: values */
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataTypeToFloat();
+    points->SetNumberOfPoints(vertex.count);
+    float *positions = static_cast<float *>(points->GetVoidPointer(0));
+    vtkSmartPointer<vtkFloatArray> normals;
+    float *normal = 0;
+    if (hasNormals)
+    {
+        normals = vtkSmartPointer<vtkFloatArray>::New();
+        normals->SetName("Normals");
+        normals->SetNumberOfComponents(3);
+        normals->SetNumberOfTuples(vertex.count);
+        normal = normals->GetPointer(0);
+    }
+    vtkSmartPointer<vtkCellArray> cells;
+    vtkIdType *connectivity = 0;
+    if (hasFaces)
+    {
+        cells = vtkSmartPointer<vtkCellArray>::New();
+        connectivity = cells->WritePointer(elements[faceElement].count,
+                                           cellOffsets.back());
+    }
+
+    common::parallelForChunks(0, chunkCount, 1,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            vtkIdType *cell = connectivity + cellOffsets[i];
+            forEachLine(bounds[i], bounds[i + 1], firstLines[i], lineCount,
+                        [&](const size_t line, const char *begin,
+                            const char *lineEnd)
+            {
+                LineParser values(begin, lineEnd);
+                if (line >= elementLines[vertexElement] &&
+                    line < elementLines[vertexElement + 1])
+                {
+                    const size_t index = line - elementLines[vertexElement];
+                    for (size_t j = 0; j != components.size(); ++j)
+                    {
+                        const Property &property = vertex.properties[j];
+                        const int component = components[j];
+                        if (component == -1)
+                            values.skip(property.list, property.integer);
+                        else if (component < 3)
+                            positions[index * 3 + component] =
+                                values.nextValue(property.integer);
+                        else if (normal)
+                            normal[index * 3 + component - 3] =
+                                values.nextValue(property.integer);
+                        else
+                            values.skip();
+                    }
+                }
+                else if (line >= firstFaceLine && line < lastFaceLine)
+                {
+                    const Element &face = elements[faceElement];
+                    for (size_t j = 0; j != face.properties.size(); ++j)
+                    {
+                        const Property &property = face.properties[j];
+                        if (j != vertexIndices)
+                        {
+                            values.skip(property.list, property.integer);
+                            continue;
+                        }
+                        const int count = values.nextInt(true);
+                        *cell++ = count;
+                        for (int k = 0; k != count; ++k)
+                            *cell++ = values.nextInt(property.integer);
+                    }
+                }
+            });
+        }
+    });
+
+    output->SetPoints(points);
+    if (normals)
+        output->GetPointData()->SetNormals(normals);
+    if (cells)
+        output->SetPolys(cells);
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_MAPPED_PLY_READER_H
+#define INTRO_MAPPED_PLY_READER_H
+
+#include <vtkPolyDataAlgorithm.h>
+
+#include <string>
+#include <vector>
+
+namespace mesh
+{
+
+/**
+   Parallel reader for ASCII PLY meshes with the same output as
+   vtkPLYReader.
+
+   The file is mapped in memory and its body split in chunks at line
+   boundaries, every element taking one line. The chunks are parsed by all
+   threads in three passes: counting the lines of each chunk, adding up the
+   connectivity size of the faces in each chunk, and finally parsing the
+   values straight into the point, normal and cell arrays, preallocated
+   from the prefix sums of the first two passes. Decimal numbers are
+   converted with a single rounding when their digits and exponent allow
+   it and with strtod otherwise, so the values are the same ones
+   vtkPLYReader gets from atof.
+
+   Vertex positions and normals (x, y, z, nx, ny, nz) and the
+   vertex_indices of the faces are read; other elements and properties
+   are skipped. Binary files and the attributes vtkPLYReader reads besides
+   those (colors, texture coordinates and face intensities) are not
+   supported, CanReadFile() tells them apart.
+ */
+class MappedPLYReader : public vtkPolyDataAlgorithm
+{
+public:
+    static MappedPLYReader *New();
+    vtkTypeMacro(MappedPLYReader, vtkPolyDataAlgorithm);
+
+    void SetFileName(const std::string &filename);
+    const std::string &GetFileName() const { return _filename; }
+
+    /** Returns true if the file is an ASCII PLY file whose output would be
+        the same as vtkPLYReader's. */
+    static bool CanReadFile(const std::string &filename);
+
+protected:
+    MappedPLYReader();
+    ~MappedPLYReader();
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    struct Property
+    {
+        std::string name;
+        bool integer;
+        bool list;
+    };
+
+    struct Element
+    {
+        std::string name;
+        size_t count;
+        std::vector<Property> properties;
+    };
+
+    struct Header
+    {
+        std::vector<Element> elements;
+        /* Start of the body */
+        size_t offset;
+    };
+
+    std::string _filename;
+
+    static bool _parseHeader(const char *data, size_t size, Header &header,
+                             std::string &error);
+    /* Throws std::runtime_error on malformed bodies */
+    static void _parseBody(const char *data, size_t size,
+                           const Header &header, vtkPolyData *output);
+
+    MappedPLYReader(const MappedPLYReader &);
+    void operator=(const MappedPLYReader &);
+};
+
+}
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "mesh_adjacency.h"
+
+#include "common/parallel.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace mesh
+{
+
+namespace
+{
+
+/* Minimum number of polygons per chunk of the parallel build */
+const size_t ADJACENCY_CHUNK = 1 << 16;
+
+/* Adds a polygon to the counts of its points */
+template<typename Point>
+void countPolygon(const Point *point, const size_t size,
+                  const size_t pointCount, uint32_t *counts)
+{
+    for (size_t j = 0; j != size; ++j)
+    {
+        if (size_t(point[j]) >= pointCount)
+            throw std::runtime_error("Polygon with an invalid point");
+        ++counts[point[j]];
+    }
+}
+
+/*
+   Serial end of the adjacency build: turns the polygon counts of each
+   vertex stored in first[1..pointCount] into list offsets and writes the
+   lists.
+ */
+template<typename Points>
+void scatterPolygons(const Points &points, const size_t polygonCount,
+                     const size_t pointCount, const size_t corners,
+                     std::vector<uint32_t> &first,
+                     std::vector<uint32_t> &polygons)
+{
+    for (size_t i = 0; i != pointCount; ++i)
+        first[i + 1] += first[i];
+
+    polygons.resize(corners);
+    std::vector<uint32_t> next(first.begin(), first.end() - 1);
+    uint32_t *list = polygons.data();
+    for (size_t i = 0; i != polygonCount; ++i)
+    {
+        size_t size;
+        const auto *point = points(i, size);
+        for (size_t j = 0; j != size; ++j)
+            list[next[point[j]]++] = uint32_t(i);
+    }
+}
+
+/*
+   Fills the CSR lists of polygons around each vertex. points(i, size)
+   returns the points of polygon i and their number.
+
+   Like a radix sort scatter: every chunk of polygons counts the polygons
+   of each vertex, the counts are turned into the offset of each chunk
+   within the list of each vertex and then each chunk writes its polygons
+   independently, in the same order as a serial walk. The per chunk counts
+   take chunks * pointCount integers, so the number of chunks is limited
+   to keep them no larger than the lists themselves. With a single chunk
+   the counts go straight into first, as in a serial build.
+ */
+template<typename Points>
+void fillAdjacency(const Points &points, const size_t polygonCount,
+                   const size_t pointCount, const size_t corners,
+                   std::vector<uint32_t> &first,
+                   std::vector<uint32_t> &polygons)
+{
+    const size_t maxChunks =
+        std::max(size_t(1), std::min(size_t(common::threadCount()),
+                                     corners / std::max(pointCount,
+                                                        size_t(1))));
+    const size_t chunkSize =
+        std::max(ADJACENCY_CHUNK,
+                 (polygonCount + maxChunks - 1) / maxChunks);
+    const size_t chunks = (polygonCount + chunkSize - 1) / chunkSize;
+    if (chunks <= 1)
+    {
+        first.assign(pointCount + 1, 0);
+        for (size_t i = 0; i != polygonCount; ++i)
+        {
+            size_t size;
+            const auto *point = points(i, size);
+            countPolygon(point, size, pointCount, first.data() + 1);
+        }
+        scatterPolygons(points, polygonCount, pointCount, corners, first,
+                        polygons);
+        return;
+    }
+    /* Polygon counts of each chunk, turned into scatter offsets */
+    std::unique_ptr<uint32_t[]> offsets(new uint32_t[chunks * pointCount]);
+
+    common::parallelForChunks(0, polygonCount, chunkSize,
+                              [&](const size_t begin, const size_t end)
+    {
+        uint32_t *counts = &offsets[begin / chunkSize * pointCount];
+        std::fill(counts, counts + pointCount, 0);
+        for (size_t i = begin; i != end; ++i)
+        {
+            size_t size;
+            const auto *point = points(i, size);
+            for (size_t j = 0; j != size; ++j)
+            {
+                if (size_t(point[j]) >= pointCount)
+                    throw std::runtime_error("Polygon with an invalid point");
+                ++counts[point[j]];
+            }
+        }
+    });
+
+    first.resize(pointCount + 1);
+    first[0] = 0;
+    common::parallelForChunks(0, pointCount, ADJACENCY_CHUNK,
+                              [&](const size_t begin, const size_t end)
+    {
+        for (size_t vertex = begin; vertex != end; ++vertex)
+        {
+            uint32_t degree = 0;
+            for (size_t chunk = 0; chunk != chunks; ++chunk)
+            {
+                uint32_t &entry = offsets[chunk * pointCount + vertex];
+                const uint32_t count = entry;
+                entry = degree;
+                degree += count;
+            }
+            first[vertex + 1] = degree;
+        }
+    });
+    for (size_t i = 0; i != pointCount; ++i)
+        first[i + 1] += first[i];
+
+    polygons.resize(corners);
+    common::parallelForChunks(0, polygonCount, chunkSize,
+                              [&](const size_t begin, const size_t end)
+    {
+        uint32_t *next = &offsets[begin / chunkSize * pointCount];
+        for (size_t i = begin; i != end; ++i)
+        {
+            size_t size;
+            const auto *point = points(i, size);
+            for (size_t j = 0; j != size; ++j)
+                polygons[first[point[j]] + next[point[j]]++] = uint32_t(i);
+        }
+    });
+}
+
+}
+
+VertexAdjacency::VertexAdjacency(const vtkIdType *cells,
+                                 const size_t polygonCount,
+                                 const size_t pointCount)
+    : _cells(cells)
+{
+    /* With one thread the polygons of each vertex are counted in the same
+       walk that finds the polygon sizes, the parallel build needs the
+       number of corners first. */
+    const bool serial = common::threadCount() == 1;
+    if (serial)
+        _first.assign(pointCount + 1, 0);
+    uint32_t *counts = serial ? _first.data() + 1 : 0;
+    bool allTriangles = true;
+    size_t corners = 0;
+    const vtkIdType *cell = cells;
+    for (size_t i = 0; i != polygonCount; ++i)
+    {
+        const vtkIdType size = *cell;
+        allTriangles &= size == 3;
+        corners += size;
+        if (counts)
+            countPolygon(cell + 1, size, pointCount, counts);
+        cell += size + 1;
+    }
+    if (corners > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Too many polygon vertices");
+
+    if (!allTriangles)
+    {
+        _offsets.resize(polygonCount);
+        cell = cells;
+        for (size_t i = 0; i != polygonCount; ++i)
+        {
+            _offsets[i] = cell - cells;
+            cell += *cell + 1;
+        }
+    }
+
+    const auto points = [this](const size_t i,
+                               size_t &size) -> const vtkIdType *
+    {
+        const vtkIdType *p = polygon(i);
+        size = p[0];
+        return p + 1;
+    };
+    if (serial)
+        scatterPolygons(points, polygonCount, pointCount, corners, _first,
+                        _polygons);
+    else
+        fillAdjacency(points, polygonCount, pointCount, corners, _first,
+                      _polygons);
+}
+
+VertexAdjacency::VertexAdjacency(const uint32_t *triangles,
+                                 const size_t triangleCount,
+                                 const size_t pointCount)
+    : _cells(0)
+{
+    if (triangleCount * 3 > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Too many polygon vertices");
+    fillAdjacency([triangles](const size_t i,
+                             size_t &size) -> const uint32_t *
+                  {
+                      size = 3;
+                      return triangles + i * 3;
+                  },
+                  triangleCount, pointCount, triangleCount * 3, _first,
+                  _polygons);
+}
+
+}
@@ -0,0 +1,89 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_MESH_ADJACENCY_H
+#define INTRO_MESH_ADJACENCY_H
+
+#include <vtkType.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace mesh
+{
+
+/**
+   Polygons around each vertex of a mesh in compressed sparse row form.
+
+   The polygons of each vertex are listed in increasing order.
+ */
+class VertexAdjacency
+{
+public:
+    /**
+       Builds the adjacency of the polygons of a vtkCellArray id array.
+       The polygon sizes are walked serially, then the polygons of each
+       vertex are counted and the lists filled in parallel over chunks of
+       polygons.
+       Throws std::runtime_error if a polygon refers to a point that
+       doesn't exist or there are 2^32 polygon vertices or more.
+     */
+    VertexAdjacency(const vtkIdType *cells, size_t polygonCount,
+                    size_t pointCount);
+
+    /**
+       Builds the adjacency of a list of triangles given by 3 indices
+       each. polygon() can't be used with this adjacency.
+       Throws std::runtime_error like the constructor above.
+     */
+    VertexAdjacency(const uint32_t *triangles, size_t triangleCount,
+                    size_t pointCount);
+
+    /** Polygons around a vertex, degree(vertex) of them */
+    const uint32_t *polygons(const size_t vertex) const
+    {
+        return _polygons.data() + _first[vertex];
+    }
+
+    size_t degree(const size_t vertex) const
+    {
+        return _first[vertex + 1] - _first[vertex];
+    }
+
+    /** True if all polygons are triangles */
+    bool triangles() const { return _offsets.empty(); }
+
+    /** Start of polygon i in the cell array */
+    const vtkIdType *polygon(const size_t i) const
+    {
+        return _cells + (_offsets.empty() ? i * 4 : _offsets[i]);
+    }
+
+private:
+    const vtkIdType *_cells;
+    std::vector<uint32_t> _first;
+    std::vector<uint32_t> _polygons;
+    /* Cell array positions of the polygons, empty if all of them are
+       triangles and polygon i starts at i * 4. */
+    std::vector<size_t> _offsets;
+};
+
+}
+
+#endif
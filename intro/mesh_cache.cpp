@@ -0,0 +1,339 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "mesh_cache.h"
+#include "compact_mesh.h"
+
+#include "common/binary_io.h"
+#include "common/mapped_file.h"
+
+#include <vtkFloatArray.h>
+#include <vtkUnsignedIntArray.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mesh
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'V', 'T', 'K', 'D', 'M', 'E', 'S', 'H'};
+const uint32_t VERSION = 4;
+/* Size of the header without the source path and pipeline tag */
+const size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(uint32_t) * 2 +
+                           sizeof(uint64_t) + sizeof(int64_t) * 2 +
+                           sizeof(uint64_t) * 4;
+/* Alignment of the sections, a cache line */
+const size_t ALIGNMENT = 64;
+
+/* What the cached mesh was made from */
+struct SourceKey
+{
+    std::string path;
+    uint64_t size;
+    int64_t seconds;
+    int64_t nanoseconds;
+
+    bool operator==(const SourceKey &other) const
+    {
+        return path == other.path && size == other.size &&
+               seconds == other.seconds && nanoseconds == other.nanoseconds;
+    }
+};
+
+struct Header
+{
+    SourceKey source;
+    std::string pipeline;
+    uint32_t version;
+    /* 1 if the entry has point normals, 0 otherwise */
+    uint32_t hasNormals;
+    uint64_t pointCount;
+    uint64_t triangleCount;
+};
+
+struct Layout
+{
+    size_t points;
+    size_t normals;
+    size_t triangles;
+    size_t end;
+};
+
+bool sourceKey(const std::string &source, SourceKey &key)
+{
+    struct stat status;
+    if (stat(source.c_str(), &status) == -1)
+        return false;
+    char path[PATH_MAX];
+    key.path = realpath(source.c_str(), path) ? path : source;
+    key.size = status.st_size;
+    key.seconds = status.st_mtim.tv_sec;
+    key.nanoseconds = status.st_mtim.tv_nsec;
+    return true;
+}
+
+size_t align(const size_t offset)
+{
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+Layout layout(const Header &header)
+{
+    const size_t coordinates = header.pointCount * 3 * sizeof(float);
+    Layout sections;
+    sections.points = align(HEADER_SIZE + header.source.path.size() +
+                            header.pipeline.size());
+    sections.normals = align(sections.points + coordinates);
+    sections.triangles =
+        align(sections.normals + (header.hasNormals ? coordinates : 0));
+    sections.end = sections.triangles +
+                   header.triangleCount * 3 * sizeof(uint32_t);
+    return sections;
+}
+
+void writeSection(std::ofstream &out, const size_t offset,
+                  const void *data, const size_t size)
+{
+    static const char padding[ALIGNMENT] = {0};
+    out.write(padding, offset - size_t(out.tellp()));
+    out.write(static_cast<const char *>(data), size);
+}
+
+void createDirectories(const std::string &path)
+{
+    for (size_t slash = path.find('/', 1); ;
+         slash = path.find('/', slash + 1))
+    {
+        const std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) == -1 && errno != EEXIST)
+            throw std::runtime_error("Could not create directory " + prefix);
+        if (slash == std::string::npos)
+            return;
+    }
+}
+
+/* Maps the entry in filename and reads its header, returns null if it's
+   not a valid entry of the source and pipeline */
+vtkSmartPointer<common::MappedFile> openEntry(const std::string &filename,
+                                              const SourceKey &key,
+                                              const std::string &pipeline,
+                                              Header &header,
+                                              Layout &sections)
+{
+    vtkSmartPointer<common::MappedFile> file =
+        vtkSmartPointer<common::MappedFile>::New();
+    try
+    {
+        file->Open(filename);
+    }
+    catch (const std::runtime_error &)
+    {
+        return 0;
+    }
+    const size_t size = file->GetSize();
+    if (size < HEADER_SIZE || memcmp(file->GetData(), MAGIC, sizeof(MAGIC)))
+        return 0;
+
+    uint64_t pathLength;
+    uint64_t pipelineLength;
+    const char *in = file->GetData() + sizeof(MAGIC);
+    in = common::readValue(in, header.version);
+    in = common::readValue(in, header.hasNormals);
+    in = common::readValue(in, header.source.size);
+    in = common::readValue(in, header.source.seconds);
+    in = common::readValue(in, header.source.nanoseconds);
+    in = common::readValue(in, header.pointCount);
+    in = common::readValue(in, header.triangleCount);
+    in = common::readValue(in, pathLength);
+    in = common::readValue(in, pipelineLength);
+    if (header.version != VERSION || header.hasNormals > 1 ||
+        pathLength > size - HEADER_SIZE ||
+        pipelineLength > size - HEADER_SIZE - pathLength)
+        return 0;
+    header.source.path.assign(in, pathLength);
+    header.pipeline.assign(in + pathLength, pipelineLength);
+    if (!(header.source == key) || header.pipeline != pipeline)
+        return 0;
+
+    /* The counts come from the file, reject any that can't fit in it before
+       they are multiplied into section offsets */
+    if (header.pointCount > size / (3 * sizeof(float)) ||
+        header.triangleCount > size / (3 * sizeof(uint32_t)))
+        return 0;
+    sections = layout(header);
+    if (sections.end > size)
+        return 0;
+    return file;
+}
+
+/* Writes an entry to a temporary file and renames it to filename */
+void writeEntry(const std::string &directory, const std::string &filename,
+                const Header &header, const float *points,
+                const float *normals, const uint32_t *triangles)
+{
+    const Layout sections = layout(header);
+
+    createDirectories(directory);
+    std::ostringstream temporary;
+    temporary << filename << '.' << getpid() << ".tmp";
+    {
+        std::ofstream out(temporary.str().c_str(), std::ios::binary);
+        if (!out)
+            throw std::runtime_error("Could not open file " +
+                                     temporary.str());
+        out.write(MAGIC, sizeof(MAGIC));
+        common::writeValue(out, header.version);
+        common::writeValue(out, header.hasNormals);
+        common::writeValue(out, header.source.size);
+        common::writeValue(out, header.source.seconds);
+        common::writeValue(out, header.source.nanoseconds);
+        common::writeValue(out, header.pointCount);
+        common::writeValue(out, header.triangleCount);
+        common::writeValue(out, uint64_t(header.source.path.size()));
+        common::writeValue(out, uint64_t(header.pipeline.size()));
+        out.write(header.source.path.data(), header.source.path.size());
+        out.write(header.pipeline.data(), header.pipeline.size());
+
+        const size_t coordinates = header.pointCount * 3 * sizeof(float);
+        writeSection(out, sections.points, points, coordinates);
+        if (normals)
+            writeSection(out, sections.normals, normals, coordinates);
+        writeSection(out, sections.triangles, triangles,
+                     header.triangleCount * 3 * sizeof(uint32_t));
+        if (out.fail())
+        {
+            out.close();
+            remove(temporary.str().c_str());
+            throw std::runtime_error("Error writing file " + temporary.str());
+        }
+    }
+    if (rename(temporary.str().c_str(), filename.c_str()) == -1)
+    {
+        remove(temporary.str().c_str());
+        throw std::runtime_error("Could not write file " + filename);
+    }
+}
+
+}
+
+MeshCache::MeshCache(const std::string &pipeline)
+    : _pipeline(pipeline)
+{
+    const char *cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (cache && *cache)
+        _directory = std::string(cache) + "/vtkdemos";
+    else if (home && *home)
+        _directory = std::string(home) + "/.cache/vtkdemos";
+    else
+        _directory = "/tmp/vtkdemos";
+}
+
+MeshCache::MeshCache(const std::string &directory,
+                     const std::string &pipeline)
+    : _directory(directory)
+    , _pipeline(pipeline)
+{
+}
+
+std::string MeshCache::entryFilename(const std::string &source) const
+{
+    SourceKey key;
+    const std::string path = sourceKey(source, key) ? key.path : source;
+    /* Collisions are told apart by the path stored in the entry */
+    std::ostringstream name;
+    name << _directory << '/' << std::hex
+         << std::hash<std::string>()(path) << '.' << _pipeline << ".mesh";
+    return name.str();
+}
+
+std::unique_ptr<CompactMesh> MeshCache::loadCompact(
+    const std::string &source) const
+{
+    SourceKey key;
+    if (!sourceKey(source, key))
+        return std::unique_ptr<CompactMesh>();
+    Header header;
+    Layout sections;
+    vtkSmartPointer<common::MappedFile> file =
+        openEntry(entryFilename(source), key, _pipeline, header, sections);
+    if (!file)
+        return std::unique_ptr<CompactMesh>();
+
+    try
+    {
+        vtkSmartPointer<vtkFloatArray> points =
+            vtkSmartPointer<vtkFloatArray>::New();
+        points->SetNumberOfComponents(3);
+        file->Attach(points, sections.points, header.pointCount * 3);
+
+        vtkSmartPointer<vtkUnsignedIntArray> triangles =
+            vtkSmartPointer<vtkUnsignedIntArray>::New();
+        file->Attach(triangles, sections.triangles,
+                     header.triangleCount * 3);
+
+        vtkSmartPointer<vtkFloatArray> normals;
+        if (header.hasNormals)
+        {
+            normals = vtkSmartPointer<vtkFloatArray>::New();
+            normals->SetNumberOfComponents(3);
+            normals->SetName("Normals");
+            file->Attach(normals, sections.normals, header.pointCount * 3);
+        }
+        return std::unique_ptr<CompactMesh>(
+            new CompactMesh(points, triangles, normals));
+    }
+    catch (const std::runtime_error &)
+    {
+        return std::unique_ptr<CompactMesh>();
+    }
+}
+
+void MeshCache::store(const std::string &source,
+                      const CompactMesh &mesh) const
+{
+    Header header;
+    if (!sourceKey(source, header.source))
+        throw std::runtime_error("Could not stat file " + source);
+    header.pipeline = _pipeline;
+    header.version = VERSION;
+    header.hasNormals = mesh.normals() ? 1 : 0;
+    header.pointCount = mesh.pointCount();
+    header.triangleCount = mesh.triangleCount();
+    writeEntry(_directory, entryFilename(source), header,
+               mesh.points()->GetPointer(0),
+               mesh.normals() ? mesh.normals()->GetPointer(0) : 0,
+               mesh.triangles()->GetPointer(0));
+}
+
+}
@@ -0,0 +1,92 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_MESH_CACHE_H
+#define INTRO_MESH_CACHE_H
+
+#include <memory>
+#include <string>
+
+namespace mesh
+{
+
+class CompactMesh;
+
+/**
+   On-disk cache of processed meshes, keyed by the path, size and
+   modification time of the file they were loaded from and by a tag naming
+   the processing pipeline that made them.
+
+   Each entry is a single file with a header followed by the float points,
+   the float point normals if any and the 32 bit triangle indices of a
+   CompactMesh, every section aligned to 64 bytes. Loading an entry maps
+   the file and attaches the arrays to the mapping, so a cached mesh is
+   available without parsing or processing and its pages are read when
+   first touched.
+
+   Entries are stored in the native byte order; entries from another
+   machine are ignored like stale ones. The pipeline tag has to
+   change whenever the processing does (e.g. with a version number in it),
+   otherwise the entries of the old processing are served as the output of
+   the new one.
+ */
+class MeshCache
+{
+public:
+    /**
+       Uses $XDG_CACHE_HOME/vtkdemos or $HOME/.cache/vtkdemos.
+       The pipeline tag is part of the entry filenames, so it has to be a
+       valid filename component.
+     */
+    explicit MeshCache(const std::string &pipeline);
+
+    MeshCache(const std::string &directory, const std::string &pipeline);
+
+    const std::string &directory() const { return _directory; }
+
+    const std::string &pipeline() const { return _pipeline; }
+
+    /** Path of the entry for a source file */
+    std::string entryFilename(const std::string &source) const;
+
+    /**
+       Returns the cached mesh of a source file, or null if there is no
+       entry for this pipeline or the source changed since the entry was
+       stored.
+       The points, triangles and normals of the mesh point into the
+       read-only mapping of the entry.
+     */
+    std::unique_ptr<CompactMesh> loadCompact(const std::string &source) const;
+
+    /**
+       Stores mesh as the processed version of a source file. The entry is
+       written to a temporary file and renamed, so concurrent loads never
+       see it partially written.
+       Throws std::runtime_error on failure.
+     */
+    void store(const std::string &source, const CompactMesh &mesh) const;
+
+private:
+    std::string _directory;
+    std::string _pipeline;
+};
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+
+/* Meshlet partitioning and per frame culling times of sphere meshes of
+   10^4 to 10^6 triangles, and the fraction of triangles kept by the
+   culling for a camera that sees the whole sphere and for a close up. */
+
+#include "meshlets.h"
+
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCamera.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+const int CULL_RUNS = 10;
+
+/* Unit sphere of about count triangles */
+vtkSmartPointer<vtkPolyData> sphereMesh(const size_t count)
+{
+    const int resolution = std::max(3, int(std::sqrt(count / 2.0)));
+    vtkSmartPointer<vtkSphereSource> sphere =
+        vtkSmartPointer<vtkSphereSource>::New();
+    sphere->SetThetaResolution(resolution);
+    sphere->SetPhiResolution(resolution);
+    sphere->Update();
+    return sphere->GetOutput();
+}
+
+/* Percentage of the triangles drawn for a camera at distance from the
+   center of the unit sphere, and the average culling time */
+double visiblePercentage(mesh::MeshletCuller &culler, const double distance,
+                         double &cullTime)
+{
+    vtkSmartPointer<vtkCamera> camera = vtkSmartPointer<vtkCamera>::New();
+    camera->SetPosition(0, 0, distance);
+    camera->SetFocalPoint(0, 0, 0);
+    camera->SetViewUp(0, 1, 0);
+    camera->SetClippingRange(distance - 1, distance + 1);
+    cullTime = common::measure([&]()
+    {
+        for (int i = 0; i != CULL_RUNS; ++i)
+            culler.update(camera, 1);
+    }) / CULL_RUNS;
+    return 100.0 * culler.visibleTriangleCount() / culler.triangleCount();
+}
+
+int main(int argc, char *argv[])
+{
+    int maxExponent = 6;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxExponent = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max exponent]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << common::threadCount() << " threads, up to "
+              << mesh::MAX_MESHLET_TRIANGLES << " triangles per meshlet"
+              << std::endl;
+    std::cout << std::setw(12) << "triangles" << std::setw(12) << "meshlets"
+              << std::setw(12) << "build ms" << std::setw(12) << "cull ms"
+              << std::setw(12) << "far %" << std::setw(12) << "close %"
+              << std::endl;
+    for (int exponent = 4; exponent <= maxExponent; ++exponent)
+    {
+        vtkSmartPointer<vtkPolyData> sphere =
+            sphereMesh(size_t(std::pow(10.0, exponent)));
+        std::unique_ptr<mesh::MeshletCuller> culler;
+        const double build = common::measure([&]()
+        {
+            culler.reset(new mesh::MeshletCuller(sphere));
+        });
+
+        /* The default view angle of 30 degrees sees the whole sphere from
+           a distance of 4 and a small part of it from 1.2 */
+        double farTime, closeTime;
+        const double far = visiblePercentage(*culler, 4, farTime);
+        const double close = visiblePercentage(*culler, 1.2, closeTime);
+
+        std::cout << std::setw(12) << culler->triangleCount()
+                  << std::setw(12) << culler->meshletCount()
+                  << std::setw(12) << build * 1e3
+                  << std::setw(12) << (farTime + closeTime) * 0.5e3
+                  << std::setw(12) << far << std::setw(12) << close
+                  << std::endl;
+    }
+}
@@ -0,0 +1,512 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+
+#include "meshlets.h"
+#include "compact_mesh.h"
+#include "vertex_cache_optimizer.h"
+
+#include "common/cells.h"
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedIntArray.h>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <stdexcept>
+
+namespace mesh
+{
+
+namespace
+{
+
+const size_t TRIANGLE_CHUNK = 1 << 14;
+/* Subtrees of at least this many triangles are split in parallel */
+const size_t PARALLEL_SUBTREE = 1 << 14;
+const size_t SUBTREES_PER_THREAD = 4;
+
+/* Sorts order[0] to order[count - 1] so the triangles of each meshlet
+   are contiguous. The ranges of the meshlets only depend on count and
+   maxTriangles, see addMeshlets. */
+void split(const float *centroids, uint32_t *order, const size_t count,
+           const unsigned int maxTriangles, const int depth)
+{
+    if (count <= maxTriangles)
+        return;
+
+    float min[3], max[3];
+    std::fill(min, min + 3, std::numeric_limits<float>::max());
+    std::fill(max, max + 3, -std::numeric_limits<float>::max());
+    for (size_t i = 0; i != count; ++i)
+    {
+        const float *centroid = centroids + size_t(order[i]) * 3;
+        for (int j = 0; j != 3; ++j)
+        {
+            min[j] = std::min(min[j], centroid[j]);
+            max[j] = std::max(max[j], centroid[j]);
+        }
+    }
+    int axis = 0;
+    for (int j = 1; j != 3; ++j)
+        if (max[j] - min[j] > max[axis] - min[axis])
+            axis = j;
+
+    const size_t middle = count / 2;
+    std::nth_element(order, order + middle, order + count,
+                     [&](const uint32_t a, const uint32_t b)
+                     {
+                         return centroids[size_t(a) * 3 + axis] <
+                                centroids[size_t(b) * 3 + axis];
+                     });
+
+    if (count >= PARALLEL_SUBTREE &&
+        (size_t(1) << std::min(depth, 31)) <
+            common::threadCount() * SUBTREES_PER_THREAD)
+    {
+        std::future<void> left = std::async(std::launch::async, [&]()
+        {
+            split(centroids, order, middle, maxTriangles, depth + 1);
+        });
+        split(centroids, order + middle, count - middle, maxTriangles,
+              depth + 1);
+        left.get();
+    }
+    else
+    {
+        split(centroids, order, middle, maxTriangles, depth + 1);
+        split(centroids, order + middle, count - middle, maxTriangles,
+              depth + 1);
+    }
+}
+
+void addMeshlets(const uint32_t first, const uint32_t count,
+                 const unsigned int maxTriangles,
+                 std::vector<Meshlet> &meshlets)
+{
+    if (count <= maxTriangles)
+    {
+        Meshlet meshlet = Meshlet();
+        meshlet.first = first;
+        meshlet.count = count;
+        meshlets.push_back(meshlet);
+        return;
+    }
+    const uint32_t middle = count / 2;
+    addMeshlets(first, middle, maxTriangles, meshlets);
+    addMeshlets(first + middle, count - middle, maxTriangles, meshlets);
+}
+
+/* Bounding sphere and normal cone of the triangles of a meshlet, given
+   in order. The point indices of triangle i start at indices + i * stride,
+   which is 4 for the ids of a cell array past the first size and 3 for a
+   plain index list. */
+template<typename T, typename Id>
+void computeBounds(const T *points, const Id *indices, const size_t stride,
+                   const uint32_t *order, Meshlet &meshlet)
+{
+    double min[3], max[3];
+    std::fill(min, min + 3, std::numeric_limits<double>::max());
+    std::fill(max, max + 3, -std::numeric_limits<double>::max());
+    double sum[3] = {0, 0, 0};
+    std::vector<double> normals(meshlet.count * 3);
+    for (uint32_t i = 0; i != meshlet.count; ++i)
+    {
+        const Id *triangle = indices + size_t(order[i]) * stride;
+        double p[3][3];
+        for (int j = 0; j != 3; ++j)
+        {
+            const T *point = points + triangle[j] * 3;
+            for (int k = 0; k != 3; ++k)
+            {
+                p[j][k] = double(point[k]);
+                min[k] = std::min(min[k], p[j][k]);
+                max[k] = std::max(max[k], p[j][k]);
+            }
+        }
+        const double u[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1],
+                             p[1][2] - p[0][2]};
+        const double v[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1],
+                             p[2][2] - p[0][2]};
+        double *normal = &normals[i * 3];
+        normal[0] = u[1] * v[2] - u[2] * v[1];
+        normal[1] = u[2] * v[0] - u[0] * v[2];
+        normal[2] = u[0] * v[1] - u[1] * v[0];
+        const double length = std::sqrt(normal[0] * normal[0] +
+                                         normal[1] * normal[1] +
+                                         normal[2] * normal[2]);
+        /* Degenerate triangles are never drawn and don't widen the cone */
+        for (int k = 0; k != 3; ++k)
+        {
+            normal[k] = length > 0 ? normal[k] / length : 0;
+            sum[k] += normal[k];
+        }
+    }
+
+    const double center[3] = {(min[0] + max[0]) * 0.5,
+                              (min[1] + max[1]) * 0.5,
+                              (min[2] + max[2]) * 0.5};
+    double radius2 = 0;
+    for (uint32_t i = 0; i != meshlet.count; ++i)
+    {
+        const Id *triangle = indices + size_t(order[i]) * stride;
+        for (int j = 0; j != 3; ++j)
+        {
+            const T *point = points + triangle[j] * 3;
+            double distance2 = 0;
+            for (int k = 0; k != 3; ++k)
+            {
+                const double d = double(point[k]) - center[k];
+                distance2 += d * d;
+            }
+            radius2 = std::max(radius2, distance2);
+        }
+    }
+    for (int k = 0; k != 3; ++k)
+        meshlet.center[k] = float(center[k]);
+    /* Rounding up so the float sphere still contains the vertices */
+    meshlet.radius = std::nextafter(float(std::sqrt(radius2)) * 1.00001f,
+                                    std::numeric_limits<float>::max());
+
+    const double length =
+        std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+    double minDot = length > 0 ? 1 : -1;
+    for (uint32_t i = 0; i != meshlet.count && length > 0; ++i)
+    {
+        const double *normal = &normals[i * 3];
+        if (normal[0] == 0 && normal[1] == 0 && normal[2] == 0)
+            continue;
+        minDot = std::min(minDot, (normal[0] * sum[0] + normal[1] * sum[1] +
+                                   normal[2] * sum[2]) / length);
+    }
+    for (int k = 0; k != 3; ++k)
+        meshlet.axis[k] = length > 0 ? float(sum[k] / length) : 0;
+    /* The sine of the half angle, with some slack for the rounding of
+       the axis */
+    meshlet.cutoff = minDot <= 0 ? 1 : float(std::min(
+        1.0, std::sqrt(1 - minDot * minDot) + 1e-4));
+}
+
+template<typename T, typename Id>
+void computeCentroids(const T *points, const size_t pointCount,
+                      const Id *indices, const size_t stride,
+                      const size_t triangleCount, float *centroids)
+{
+    common::parallelForChunks(0, triangleCount, TRIANGLE_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const Id *triangle = indices + i * stride;
+            double centroid[3] = {0, 0, 0};
+            for (int j = 0; j != 3; ++j)
+            {
+                /* Negative ids wrap around to large values */
+                if (size_t(triangle[j]) >= pointCount)
+                    throw std::runtime_error("Invalid point id in triangle");
+                const T *point = points + triangle[j] * 3;
+                for (int k = 0; k != 3; ++k)
+                    centroid[k] += double(point[k]);
+            }
+            for (int k = 0; k != 3; ++k)
+                centroids[i * 3 + k] = float(centroid[k] / 3);
+        }
+    });
+}
+
+template<typename T, typename Id>
+void partition(const T *points, const size_t pointCount, const Id *indices,
+               const size_t stride, const size_t triangleCount,
+               const unsigned int maxTriangles, std::vector<uint32_t> &order,
+               std::vector<Meshlet> &meshlets)
+{
+    std::vector<float> centroids(triangleCount * 3);
+    computeCentroids(points, pointCount, indices, stride, triangleCount,
+                     centroids.data());
+
+    order.resize(triangleCount);
+    for (size_t i = 0; i != triangleCount; ++i)
+        order[i] = uint32_t(i);
+    split(centroids.data(), order.data(), triangleCount, maxTriangles, 0);
+
+    meshlets.clear();
+    addMeshlets(0, uint32_t(triangleCount), maxTriangles, meshlets);
+    common::parallelFor(0, meshlets.size(), [&](const size_t i)
+    {
+        Meshlet &meshlet = meshlets[i];
+        uint32_t *triangles = &order[meshlet.first];
+        /* Restoring the input order within the meshlet */
+        std::sort(triangles, triangles + meshlet.count);
+        computeBounds(points, indices, stride, triangles, meshlet);
+    });
+}
+
+}
+
+vtkSmartPointer<vtkPolyData> buildMeshlets(vtkPolyData *mesh,
+                                           std::vector<Meshlet> &meshlets,
+                                           unsigned int maxTriangles)
+{
+    maxTriangles = std::max(maxTriangles, 1u);
+    const size_t triangleCount = mesh->GetNumberOfPolys();
+    if (triangleCount != 0 && !isTriangleMesh(mesh))
+        throw std::runtime_error("Only triangle meshes are supported");
+    if (triangleCount >= std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Too many triangles");
+
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    output->SetPoints(mesh->GetPoints());
+    output->GetPointData()->ShallowCopy(mesh->GetPointData());
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    output->SetPolys(cells);
+    meshlets.clear();
+    if (triangleCount == 0)
+        return output;
+
+    vtkDataArray *points = mesh->GetPoints()->GetData();
+    const size_t pointCount = points->GetNumberOfTuples();
+    const vtkIdType *input = mesh->GetPolys()->GetData()->GetPointer(0);
+    std::vector<uint32_t> order;
+    switch (points->GetDataType())
+    {
+        vtkTemplateMacro(
+            partition(static_cast<const VTK_TT *>(points->GetVoidPointer(0)),
+                      pointCount, input + 1, 4, triangleCount, maxTriangles,
+                      order, meshlets));
+    default:
+        throw std::runtime_error("Unsupported point type");
+    }
+
+    vtkIdType *ids = cells->WritePointer(triangleCount, triangleCount * 4);
+    common::parallelForChunks(0, triangleCount, TRIANGLE_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+            std::copy(input + size_t(order[i]) * 4,
+                      input + size_t(order[i]) * 4 + 4, ids + i * 4);
+    });
+    return output;
+}
+
+bool outsideFrustum(const Meshlet &meshlet, const double planes[24])
+{
+    for (int i = 0; i != 6; ++i)
+    {
+        const double *plane = planes + i * 4;
+        const double distance = plane[0] * meshlet.center[0] +
+                                plane[1] * meshlet.center[1] +
+                                plane[2] * meshlet.center[2] + plane[3];
+        if (distance < -meshlet.radius)
+            return true;
+    }
+    return false;
+}
+
+bool backfacing(const Meshlet &meshlet, const double eye[3])
+{
+    if (meshlet.cutoff >= 1)
+        return false;
+    /* All the triangles face away if the direction to any point of the
+       bounding sphere is less than 90 degrees away from all the normals.
+       The sphere spans asin(radius / distance) around the direction to
+       its center, and sin(a + b) <= sin(a) + sin(b) for these angles. */
+    const double d[3] = {meshlet.center[0] - eye[0],
+                         meshlet.center[1] - eye[1],
+                         meshlet.center[2] - eye[2]};
+    const double distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    return d[0] * meshlet.axis[0] + d[1] * meshlet.axis[1] +
+           d[2] * meshlet.axis[2] >= meshlet.cutoff * distance + meshlet.radius;
+}
+
+MeshletCuller::MeshletCuller(vtkPolyData *mesh,
+                             const unsigned int maxTriangles)
+    : _output(vtkSmartPointer<vtkPolyData>::New())
+    , _cells(vtkSmartPointer<vtkCellArray>::New())
+    , _backface(true)
+    , _visibleTriangles(0)
+    , _updateTime(0)
+{
+    vtkSmartPointer<vtkPolyData> reordered =
+        buildMeshlets(mesh, _meshlets, maxTriangles);
+    _triangles = compactTriangles(reordered);
+    _output->SetPoints(reordered->GetPoints());
+    _output->GetPointData()->ShallowCopy(reordered->GetPointData());
+    _output->SetPolys(_cells);
+    _showAll();
+}
+
+MeshletCuller::MeshletCuller(const CompactMesh &mesh,
+                             unsigned int maxTriangles)
+    : _output(vtkSmartPointer<vtkPolyData>::New())
+    , _cells(vtkSmartPointer<vtkCellArray>::New())
+    , _backface(true)
+    , _visibleTriangles(0)
+    , _updateTime(0)
+{
+    maxTriangles = std::max(maxTriangles, 1u);
+    const size_t triangleCount = mesh.triangleCount();
+    if (triangleCount >= std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Too many triangles");
+
+    /* Partitioning the 32 bit indices directly, the mesh is never
+       expanded to a full cell array */
+    const uint32_t *triangles = mesh.triangles()->GetPointer(0);
+    std::vector<uint32_t> order;
+    if (triangleCount != 0)
+        partition(mesh.points()->GetPointer(0), mesh.pointCount(),
+                  triangles, 3, triangleCount, maxTriangles, order,
+                  _meshlets);
+    _triangles.resize(triangleCount * 3);
+    common::parallelForChunks(0, triangleCount, TRIANGLE_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+            std::copy(triangles + size_t(order[i]) * 3,
+                      triangles + size_t(order[i]) * 3 + 3,
+                      &_triangles[i * 3]);
+    });
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(mesh.points());
+    _output->SetPoints(points);
+    if (mesh.normals())
+        _output->GetPointData()->SetNormals(mesh.normals());
+    _output->SetPolys(_cells);
+    _showAll();
+}
+
+void MeshletCuller::update(vtkCamera *camera, const double aspect,
+                           vtkMatrix4x4 *model)
+{
+    _updateTime = common::measure([&]()
+    {
+        _cull(camera, aspect, model);
+        if (_visible != _written)
+            _writeCells();
+    });
+}
+
+void MeshletCuller::cull(vtkCamera *camera, const double aspect,
+                         vtkMatrix4x4 *model)
+{
+    _updateTime = common::measure([&]() { _cull(camera, aspect, model); });
+}
+
+void MeshletCuller::_cull(vtkCamera *camera, const double aspect,
+                          vtkMatrix4x4 *model)
+{
+    double planes[24];
+    camera->GetFrustumPlanes(aspect, planes);
+    double eye[3];
+    camera->GetPosition(eye);
+    bool backface = _backface;
+
+    if (model)
+    {
+        /* A point x is on the positive side of plane p in world
+           coordinates if M x is, that is, if M^T p . x > 0 */
+        const double (&m)[4][4] = model->Element;
+        for (int i = 0; i != 6; ++i)
+        {
+            double *plane = planes + i * 4;
+            double transformed[4];
+            for (int j = 0; j != 4; ++j)
+                transformed[j] = plane[0] * m[0][j] + plane[1] * m[1][j] +
+                                 plane[2] * m[2][j] + plane[3] * m[3][j];
+            const double length = std::sqrt(
+                transformed[0] * transformed[0] +
+                transformed[1] * transformed[1] +
+                transformed[2] * transformed[2]);
+            for (int j = 0; j != 4; ++j)
+                plane[j] = transformed[j] / length;
+        }
+
+        double inverse[16];
+        vtkMatrix4x4::Invert(&m[0][0], inverse);
+        double position[3];
+        for (int i = 0; i != 3; ++i)
+            position[i] = inverse[i * 4] * eye[0] +
+                          inverse[i * 4 + 1] * eye[1] +
+                          inverse[i * 4 + 2] * eye[2] + inverse[i * 4 + 3];
+        std::copy(position, position + 3, eye);
+        /* Mirroring transformations swap the front and back faces */
+        if (model->Determinant() < 0)
+            backface = false;
+    }
+
+    _flags.resize(_meshlets.size());
+    common::parallelFor(0, _meshlets.size(), [&](const size_t i)
+    {
+        const Meshlet &meshlet = _meshlets[i];
+        _flags[i] = !outsideFrustum(meshlet, planes) &&
+                    !(backface && backfacing(meshlet, eye));
+    });
+
+    _visible.clear();
+    _offsets.clear();
+    _visibleTriangles = 0;
+    for (size_t i = 0; i != _meshlets.size(); ++i)
+    {
+        if (!_flags[i])
+            continue;
+        _visible.push_back(uint32_t(i));
+        _offsets.push_back(_visibleTriangles);
+        _visibleTriangles += _meshlets[i].count;
+    }
+}
+
+void MeshletCuller::_showAll()
+{
+    /* Everything is visible until the first update */
+    for (size_t i = 0; i != _meshlets.size(); ++i)
+    {
+        _visible.push_back(uint32_t(i));
+        _offsets.push_back(_visibleTriangles);
+        _visibleTriangles += _meshlets[i].count;
+    }
+    _writeCells();
+}
+
+void MeshletCuller::_writeCells()
+{
+    _written = _visible;
+    vtkIdType *connectivity =
+        _cells->WritePointer(_visibleTriangles, _visibleTriangles * 4);
+    common::parallelFor(0, _visible.size(), [&](const size_t i)
+    {
+        const Meshlet &meshlet = _meshlets[_visible[i]];
+        expandTriangles(&_triangles[size_t(meshlet.first) * 3],
+                        meshlet.count, connectivity + _offsets[i] * 4);
+    });
+    common::cellsRewritten(_output, _cells);
+}
+
+}
@@ -0,0 +1,176 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_MESHLETS_H
+#define INTRO_MESHLETS_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstdint>
+#include <vector>
+
+class vtkCamera;
+class vtkCellArray;
+class vtkMatrix4x4;
+class vtkPolyData;
+
+namespace mesh
+{
+
+class CompactMesh;
+
+/**
+   A cluster of spatially close triangles with the bounds needed to cull
+   it as a whole.
+ */
+struct Meshlet
+{
+    /* Triangles first to first + count - 1 of the partitioned mesh */
+    uint32_t first;
+    uint32_t count;
+    /* Bounding sphere of the vertices */
+    float center[3];
+    float radius;
+    /* Normal cone. The normals of all the triangles are at most
+       asin(cutoff) away from the axis, cutoff is 1 if the half angle is
+       90 degrees or more and the cone can't cull anything. */
+    float axis[3];
+    float cutoff;
+};
+
+/** Maximum number of triangles in the meshlets, the minimum is half */
+const unsigned int MAX_MESHLET_TRIANGLES = 128;
+
+/**
+   Splits a triangle mesh into meshlets of maxTriangles / 2 to maxTriangles
+   triangles (except meshes smaller than that) and returns a copy of the
+   mesh with the triangles of each meshlet in a contiguous range. The copy
+   shares the points and point data, cell data is not kept.
+
+   The triangles are split recursively at the median of their centroids
+   along the longest axis of their bounds, large subtrees in parallel.
+   Within a meshlet the triangles keep their input order, so the vertex
+   cache order given by optimizeVertexCache is mostly preserved.
+
+   Throws std::runtime_error if the polygons are not triangles.
+ */
+vtkSmartPointer<vtkPolyData> buildMeshlets(
+    vtkPolyData *mesh, std::vector<Meshlet> &meshlets,
+    unsigned int maxTriangles = MAX_MESHLET_TRIANGLES);
+
+/**
+   True if the bounding sphere of a meshlet is completely outside one of
+   the planes, whose normals point inwards as the ones returned by
+   vtkCamera::GetFrustumPlanes.
+ */
+bool outsideFrustum(const Meshlet &meshlet, const double planes[24]);
+
+/**
+   True if all the triangles of a meshlet face away from the eye, tested
+   conservatively with the normal cone and the bounding sphere.
+ */
+bool backfacing(const Meshlet &meshlet, const double eye[3]);
+
+/**
+   Per frame culling of the meshlets of a triangle mesh.
+
+   The output poly data shares the points and point arrays of the mesh
+   returned by buildMeshlets, but its polygons are only the triangles of
+   the meshlets that may be visible from the camera given to the last
+   update(): the ones whose bounding sphere intersects the view frustum
+   and, if backface culling is enabled, which have some triangle facing
+   the camera. Backface culling only makes sense if the actor culls back
+   faces too (vtkProperty::BackfaceCullingOn), VTK draws both sides by
+   default.
+
+   The camera is transformed to the model coordinates of the mesh, so the
+   culling works for any actor matrix.
+ */
+class MeshletCuller
+{
+public:
+    explicit MeshletCuller(vtkPolyData *mesh,
+                           unsigned int maxTriangles = MAX_MESHLET_TRIANGLES);
+
+    /**
+       Culls a compact mesh, whose triangles are partitioned and kept with
+       32 bit indices without going through a cell array. The output
+       shares the points and normals of the mesh.
+       Throws std::runtime_error if a triangle has an invalid point.
+     */
+    explicit MeshletCuller(const CompactMesh &mesh,
+                           unsigned int maxTriangles = MAX_MESHLET_TRIANGLES);
+
+    vtkPolyData *output() { return _output; }
+
+    const std::vector<Meshlet> &meshlets() const { return _meshlets; }
+
+    /** Enables or disables the normal cone test, enabled by default */
+    void setBackfaceCulling(bool enable) { _backface = enable; }
+
+    /**
+       Recomputes the visible meshlets for a camera, the aspect ratio of
+       the viewport and the model matrix of the actor (identity if null),
+       and updates the polygons of the output. The polygons are left
+       untouched if the visible meshlets haven't changed since the last
+       update.
+     */
+    void update(vtkCamera *camera, double aspect, vtkMatrix4x4 *model = 0);
+
+    /** Like update, but only computes visible() and leaves the output
+        untouched. */
+    void cull(vtkCamera *camera, double aspect, vtkMatrix4x4 *model = 0);
+
+    /** Indices of the meshlets that passed the last update or cull */
+    const std::vector<uint32_t> &visible() const { return _visible; }
+
+    size_t meshletCount() const { return _meshlets.size(); }
+    size_t visibleCount() const { return _visible.size(); }
+    /** Triangles in the meshlets that passed the last update or cull */
+    size_t visibleTriangleCount() const { return _visibleTriangles; }
+    size_t triangleCount() const { return _triangles.size() / 3; }
+    /** Duration of the last update or cull in seconds */
+    double updateTime() const { return _updateTime; }
+
+private:
+    vtkSmartPointer<vtkPolyData> _output;
+    /* All the triangles with 32 bit indices, expanded to VTK cells only
+       for the visible meshlets */
+    std::vector<uint32_t> _triangles;
+    vtkSmartPointer<vtkCellArray> _cells;
+    std::vector<Meshlet> _meshlets;
+    bool _backface;
+
+    std::vector<uint8_t> _flags;
+    std::vector<uint32_t> _visible;
+    /* Meshlets whose triangles are in the output */
+    std::vector<uint32_t> _written;
+    /* First triangle of each visible meshlet in the output */
+    std::vector<size_t> _offsets;
+    size_t _visibleTriangles;
+    double _updateTime;
+
+    void _cull(vtkCamera *camera, double aspect, vtkMatrix4x4 *model);
+    void _showAll();
+    void _writeCells();
+};
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/* Vertex normal computation time of grid meshes of 10^3 to 10^7
+   triangles with vtkPolyDataNormals, as configured in hello and without
+   splitting and consistency checks, and with the parallel
+   VertexNormalsFilter. */
+
+#include "vertex_normals.h"
+
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCellArray.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+/* Wavy height field of about count triangles */
+vtkSmartPointer<vtkPolyData> gridMesh(const size_t count)
+{
+    const size_t side = std::max(size_t(2),
+                                 size_t(std::sqrt(count / 2.0)) + 1);
+    const size_t triangles = (side - 1) * (side - 1) * 2;
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataTypeToFloat();
+    points->SetNumberOfPoints(side * side);
+    float *p = static_cast<float *>(points->GetVoidPointer(0));
+    common::parallelFor(0, side, [&](const size_t y)
+    {
+        for (size_t x = 0; x != side; ++x)
+        {
+            float *point = p + (y * side + x) * 3;
+            point[0] = float(x) / side;
+            point[1] = float(y) / side;
+            point[2] = 0.05f * std::sin(point[0] * 40) *
+                       std::cos(point[1] * 30);
+        }
+    });
+
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    vtkIdType *ids = cells->WritePointer(triangles, triangles * 4);
+    common::parallelFor(0, side - 1, [&](const size_t y)
+    {
+        vtkIdType *cell = ids + y * (side - 1) * 8;
+        for (size_t x = 0; x + 1 != side; ++x)
+        {
+            const vtkIdType a = y * side + x;
+            const vtkIdType b = a + side;
+            const vtkIdType quad[8] = {3, a, a + 1, b + 1, 3, a, b + 1, b};
+            std::copy(quad, quad + 8, cell);
+            cell += 8;
+        }
+    });
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints(points);
+    mesh->SetPolys(cells);
+    return mesh;
+}
+
+double vtkNormalsTime(vtkPolyData *mesh, const bool lite)
+{
+    vtkSmartPointer<vtkPolyDataNormals> normals =
+        vtkSmartPointer<vtkPolyDataNormals>::New();
+    normals->ComputePointNormalsOn();
+    normals->ComputeCellNormalsOff();
+    if (lite)
+    {
+        normals->SplittingOff();
+        normals->ConsistencyOff();
+    }
+    normals->SetInputData(mesh);
+    return common::measure([&]() { normals->Update(); });
+}
+
+int main(int argc, char *argv[])
+{
+    int maxExponent = 7;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxExponent = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max exponent]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << common::threadCount() << " threads" << std::endl;
+    std::cout << std::setw(12) << "triangles" << std::setw(12) << "vtk ms"
+              << std::setw(12) << "vtk lite ms" << std::setw(12)
+              << "parallel ms" << std::setw(12) << "speedup" << std::endl;
+    for (int exponent = 3; exponent <= maxExponent; ++exponent)
+    {
+        vtkSmartPointer<vtkPolyData> mesh =
+            gridMesh(size_t(std::pow(10.0, exponent)));
+
+        const double vtk = vtkNormalsTime(mesh, false);
+        const double lite = vtkNormalsTime(mesh, true);
+        vtkSmartPointer<mesh::VertexNormalsFilter> normals =
+            vtkSmartPointer<mesh::VertexNormalsFilter>::New();
+        normals->SetInputData(mesh);
+        const double parallel = common::measure([&]() { normals->Update(); });
+
+        std::cout << std::setw(12) << mesh->GetNumberOfPolys()
+                  << std::setw(12) << vtk * 1e3 << std::setw(12)
+                  << lite * 1e3 << std::setw(12) << parallel * 1e3
+                  << std::setw(12) << vtk / parallel << std::endl;
+    }
+}
@@ -0,0 +1,127 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/* Load time of a PLY mesh with vtkPLYReader and with the parallel
+   MappedPLYReader. Both outputs are compared and the program fails if
+   they are not identical. */
+
+#include "mapped_ply_reader.h"
+
+#include "common/parallel.h"
+#include "common/timing.h"
+#include "common/paths.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPLYReader.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+/* Loads of each reader, the fastest one is reported */
+const int RUNS = 5;
+
+bool sameArrays(vtkDataArray *a, vtkDataArray *b)
+{
+    if (!a || !b)
+        return a == b;
+    if (a->GetDataType() != b->GetDataType() ||
+        a->GetNumberOfComponents() != b->GetNumberOfComponents() ||
+        a->GetNumberOfTuples() != b->GetNumberOfTuples())
+        return false;
+    const size_t bytes = size_t(a->GetNumberOfTuples()) *
+                         a->GetNumberOfComponents() * a->GetDataTypeSize();
+    return bytes == 0 ||
+           memcmp(a->GetVoidPointer(0), b->GetVoidPointer(0), bytes) == 0;
+}
+
+bool samePolyData(vtkPolyData *a, vtkPolyData *b)
+{
+    return sameArrays(a->GetPoints()->GetData(), b->GetPoints()->GetData()) &&
+           a->GetNumberOfPolys() == b->GetNumberOfPolys() &&
+           sameArrays(a->GetPolys()->GetData(), b->GetPolys()->GetData()) &&
+           sameArrays(a->GetPointData()->GetNormals(),
+                      b->GetPointData()->GetNormals());
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filename = common::dataPath() + "/bunny.ply";
+    if (argc == 2)
+        filename = argv[1];
+    else if (argc > 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [file.ply]" << std::endl;
+        return -1;
+    }
+    if (!mesh::MappedPLYReader::CanReadFile(filename))
+    {
+        std::cerr << filename << ": not supported by MappedPLYReader"
+                  << std::endl;
+        return -1;
+    }
+
+    vtkSmartPointer<vtkPolyData> reference;
+    vtkSmartPointer<vtkPolyData> mapped;
+    double vtkTime = 0;
+    double mappedTime = 0;
+    for (int run = 0; run != RUNS; ++run)
+    {
+        vtkSmartPointer<vtkPLYReader> ply = vtkPLYReader::New();
+        ply->SetFileName(filename.c_str());
+        const double t0 = common::measure([&]() { ply->Update(); });
+        reference = ply->GetOutput();
+
+        vtkSmartPointer<mesh::MappedPLYReader> reader =
+            mesh::MappedPLYReader::New();
+        reader->SetFileName(filename);
+        const double t1 = common::measure([&]() { reader->Update(); });
+        mapped = reader->GetOutput();
+
+        vtkTime = run == 0 ? t0 : std::min(vtkTime, t0);
+        mappedTime = run == 0 ? t1 : std::min(mappedTime, t1);
+    }
+
+    std::cout << filename << ": " << reference->GetNumberOfPoints()
+              << " vertices, " << reference->GetNumberOfPolys() << " faces, "
+              << common::threadCount() << " threads" << std::endl;
+    std::cout << std::setw(12) << "reader" << std::setw(12) << "ms"
+              << std::setw(12) << "speedup" << std::endl;
+    std::cout << std::setw(12) << "vtkPLY" << std::setw(12) << vtkTime * 1e3
+              << std::setw(12) << 1 << std::endl;
+    std::cout << std::setw(12) << "mapped" << std::setw(12)
+              << mappedTime * 1e3 << std::setw(12) << vtkTime / mappedTime
+              << std::endl;
+
+    if (!samePolyData(reference, mapped))
+    {
+        std::cerr << "The outputs differ" << std::endl;
+        return 1;
+    }
+    std::cout << "The outputs are identical" << std::endl;
+}
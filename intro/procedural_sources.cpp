@@ -0,0 +1,340 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+
+#include "procedural_sources.h"
+
+#include "common/parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace mesh
+{
+
+namespace
+{
+
+const size_t POINT_CHUNK = 1 << 14;
+const size_t STRIP_CHUNK = 64;
+
+const double PI = 3.14159265358979323846;
+
+enum Shape
+{
+    SPHERE,
+    CONE
+};
+
+typedef std::tuple<Shape, int, int> GeometryKey;
+
+std::mutex geometryMutex;
+std::map<GeometryKey, vtkSmartPointer<vtkPolyData>> geometryCache;
+
+/* Poly data with float points and normals and strips, all allocated */
+vtkSmartPointer<vtkPolyData> allocate(const size_t pointCount,
+                                      const size_t stripCount,
+                                      const size_t stripIds, float *&points,
+                                      float *&normals, vtkIdType *&strips)
+{
+    vtkSmartPointer<vtkPoints> vertices = vtkSmartPointer<vtkPoints>::New();
+    vertices->SetDataTypeToFloat();
+    vertices->SetNumberOfPoints(pointCount);
+    vtkSmartPointer<vtkFloatArray> normalArray =
+        vtkSmartPointer<vtkFloatArray>::New();
+    normalArray->SetName("Normals");
+    normalArray->SetNumberOfComponents(3);
+    normalArray->SetNumberOfTuples(pointCount);
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+
+    points = static_cast<float *>(vertices->GetVoidPointer(0));
+    normals = normalArray->GetPointer(0);
+    strips = cells->WritePointer(stripCount, stripIds);
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints(vertices);
+    mesh->GetPointData()->SetNormals(normalArray);
+    mesh->SetStrips(cells);
+    return mesh;
+}
+
+inline void store(float *out, const double x, const double y,
+                  const double z)
+{
+    out[0] = float(x);
+    out[1] = float(y);
+    out[2] = float(z);
+}
+
+/* Points 0 and 1 are the north and south poles, then the rings from
+   north to south, thetaResolution points each. */
+vtkSmartPointer<vtkPolyData> generateSphere(const int thetaResolution,
+                                            const int phiResolution)
+{
+    const size_t meridians = thetaResolution;
+    const size_t rings = phiResolution - 1;
+    const size_t pointCount = 2 + meridians * rings;
+    /* Each strip has both poles and two points per ring */
+    const size_t stripSize = rings * 2 + 2;
+
+    float *points, *normals;
+    vtkIdType *strips;
+    vtkSmartPointer<vtkPolyData> mesh =
+        allocate(pointCount, meridians, meridians * (stripSize + 1),
+                 points, normals, strips);
+
+    /* Sines and cosines of the meridian and ring angles */
+    std::vector<double> thetaCos(meridians), thetaSin(meridians);
+    for (size_t j = 0; j != meridians; ++j)
+    {
+        const double theta = 2 * PI * j / thetaResolution;
+        thetaCos[j] = std::cos(theta);
+        thetaSin[j] = std::sin(theta);
+    }
+    std::vector<double> phiCos(rings), phiSin(rings);
+    for (size_t i = 0; i != rings; ++i)
+    {
+        const double phi = PI * (i + 1) / phiResolution;
+        phiCos[i] = std::cos(phi);
+        phiSin[i] = std::sin(phi);
+    }
+
+    store(points, 0, 0, 1);
+    store(points + 3, 0, 0, -1);
+    common::parallelForChunks(2, pointCount, POINT_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const size_t ring = (i - 2) / meridians;
+            const size_t meridian = (i - 2) % meridians;
+            store(points + i * 3, phiSin[ring] * thetaCos[meridian],
+                  phiSin[ring] * thetaSin[meridian], phiCos[ring]);
+        }
+    });
+    /* The normals of a unit sphere are its points */
+    std::copy(points, points + pointCount * 3, normals);
+
+    /* Alternating between meridians j and j + 1 keeps the first triangle,
+       and so the whole strip, counterclockwise seen from outside */
+    common::parallelForChunks(0, meridians, STRIP_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t j = first; j != last; ++j)
+        {
+            vtkIdType *strip = strips + j * (stripSize + 1);
+            const size_t next = (j + 1) % meridians;
+            *strip++ = stripSize;
+            *strip++ = 0;
+            for (size_t ring = 0; ring != rings; ++ring)
+            {
+                *strip++ = 2 + ring * meridians + j;
+                *strip++ = 2 + ring * meridians + next;
+            }
+            *strip++ = 1;
+        }
+    });
+    return mesh;
+}
+
+/* Apex points, base points of the side and base points of the cap, a
+   set of resolution points each. The base angles go clockwise seen from
+   the apex so the strips start with a counterclockwise triangle. */
+vtkSmartPointer<vtkPolyData> generateCone(const int resolution)
+{
+    const double height = 1;
+    const double radius = 0.5;
+    const size_t sides = resolution;
+    const size_t sideStrip = sides * 2 + 1;
+    const size_t capStrip = sides;
+
+    float *points, *normals;
+    vtkIdType *strips;
+    vtkSmartPointer<vtkPolyData> mesh =
+        allocate(sides * 3, 2, sideStrip + capStrip + 2, points, normals,
+                 strips);
+
+    const double slope = 1 / std::sqrt(height * height + radius * radius);
+    common::parallelForChunks(0, sides, POINT_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const double angle = -2 * PI * i / resolution;
+            const double middle = -2 * PI * (i + 0.5) / resolution;
+            const double c = std::cos(angle);
+            const double s = std::sin(angle);
+            /* Apex, with the normal of the middle of its side */
+            store(points + i * 3, height / 2, 0, 0);
+            store(normals + i * 3, radius * slope,
+                  height * slope * std::cos(middle),
+                  height * slope * std::sin(middle));
+            /* Side */
+            float *side = points + (sides + i) * 3;
+            store(side, -height / 2, radius * c, radius * s);
+            store(normals + (sides + i) * 3, radius * slope,
+                  height * slope * c, height * slope * s);
+            /* Cap */
+            std::copy(side, side + 3, points + (sides * 2 + i) * 3);
+            store(normals + (sides * 2 + i) * 3, -1, 0, 0);
+        }
+    });
+
+    /* The side strip alternates base and apex points, its odd triangles
+       join two apex points and are empty. The cap zigzags between both
+       ends of the base. */
+    vtkIdType *strip = strips;
+    *strip++ = sideStrip;
+    for (size_t i = 0; i != sides; ++i)
+    {
+        *strip++ = sides + i;
+        *strip++ = i;
+    }
+    *strip++ = sides;
+    *strip++ = capStrip;
+    for (size_t k = 0; k != sides; ++k)
+        *strip++ = sides * 2 + (k == 0 ? 0 : k % 2 ? (k + 1) / 2
+                                                   : sides - k / 2);
+    return mesh;
+}
+
+vtkSmartPointer<vtkPolyData> cachedGeometry(const GeometryKey &key)
+{
+    std::lock_guard<std::mutex> lock(geometryMutex);
+    vtkSmartPointer<vtkPolyData> &mesh = geometryCache[key];
+    if (!mesh)
+    {
+        if (std::get<0>(key) == SPHERE)
+            mesh = generateSphere(std::get<1>(key), std::get<2>(key));
+        else
+            mesh = generateCone(std::get<1>(key));
+    }
+    return mesh;
+}
+
+}
+
+vtkSmartPointer<vtkPolyData> sphereGeometry(const int thetaResolution,
+                                            const int phiResolution)
+{
+    if (thetaResolution < 3 || phiResolution < 3)
+        throw std::runtime_error("Sphere resolution below 3");
+    return cachedGeometry(
+        GeometryKey(SPHERE, thetaResolution, phiResolution));
+}
+
+vtkSmartPointer<vtkPolyData> coneGeometry(const int resolution)
+{
+    if (resolution < 3)
+        throw std::runtime_error("Cone resolution below 3");
+    return cachedGeometry(GeometryKey(CONE, resolution, 0));
+}
+
+void clearGeometryCache()
+{
+    std::lock_guard<std::mutex> lock(geometryMutex);
+    geometryCache.clear();
+}
+
+vtkStandardNewMacro(ParallelSphereSource);
+
+ParallelSphereSource::ParallelSphereSource()
+    : _thetaResolution(8)
+    , _phiResolution(8)
+{
+    SetNumberOfInputPorts(0);
+}
+
+ParallelSphereSource::~ParallelSphereSource()
+{
+}
+
+void ParallelSphereSource::SetThetaResolution(const int resolution)
+{
+    const int clamped = std::max(resolution, 3);
+    if (clamped == _thetaResolution)
+        return;
+    _thetaResolution = clamped;
+    Modified();
+}
+
+void ParallelSphereSource::SetPhiResolution(const int resolution)
+{
+    const int clamped = std::max(resolution, 3);
+    if (clamped == _phiResolution)
+        return;
+    _phiResolution = clamped;
+    Modified();
+}
+
+int ParallelSphereSource::RequestData(vtkInformation *,
+                                      vtkInformationVector **,
+                                      vtkInformationVector *outputVector)
+{
+    vtkPolyData *output = vtkPolyData::GetData(outputVector);
+    output->ShallowCopy(sphereGeometry(_thetaResolution, _phiResolution));
+    return 1;
+}
+
+vtkStandardNewMacro(ParallelConeSource);
+
+ParallelConeSource::ParallelConeSource()
+    : _resolution(6)
+{
+    SetNumberOfInputPorts(0);
+}
+
+ParallelConeSource::~ParallelConeSource()
+{
+}
+
+void ParallelConeSource::SetResolution(const int resolution)
+{
+    const int clamped = std::max(resolution, 3);
+    if (clamped == _resolution)
+        return;
+    _resolution = clamped;
+    Modified();
+}
+
+int ParallelConeSource::RequestData(vtkInformation *,
+                                    vtkInformationVector **,
+                                    vtkInformationVector *outputVector)
+{
+    vtkPolyData *output = vtkPolyData::GetData(outputVector);
+    output->ShallowCopy(coneGeometry(_resolution));
+    return 1;
+}
+
+}
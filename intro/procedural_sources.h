@@ -0,0 +1,123 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_PROCEDURAL_SOURCES_H
+#define INTRO_PROCEDURAL_SOURCES_H
+
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkSmartPointer.h>
+
+class vtkPolyData;
+
+namespace mesh
+{
+
+/**
+   Unit sphere centered at the origin with thetaResolution meridians and
+   phiResolution segments from pole to pole (both at least 3), as
+   vtkSphereSource with radius 1. The output has float points, unit
+   normals and a triangle strip between each pair of consecutive
+   meridians, from the north pole to the south pole. Points and strips
+   are generated in parallel directly into their arrays.
+
+   Meshes are cached per resolution and returned shared, they must not be
+   modified.
+ */
+vtkSmartPointer<vtkPolyData> sphereGeometry(int thetaResolution,
+                                            int phiResolution);
+
+/**
+   Cone with vtkConeSource defaults: height 1, base radius 0.5, centered
+   at the origin and pointing along +x, capped, with resolution sides
+   (at least 3). The side is a single strip with an apex point per side,
+   so the normals are smooth around the cone but not at the apex, and the
+   cap is another strip with its own points and normals.
+
+   Cached and shared like sphereGeometry.
+ */
+vtkSmartPointer<vtkPolyData> coneGeometry(int resolution);
+
+/** Releases the cached meshes, those still used elsewhere remain alive */
+void clearGeometryCache();
+
+/**
+   Source wrapper of sphereGeometry. The output shares the arrays of the
+   cached mesh, use the actor to scale and place it.
+ */
+class ParallelSphereSource : public vtkPolyDataAlgorithm
+{
+public:
+    static ParallelSphereSource *New();
+    vtkTypeMacro(ParallelSphereSource, vtkPolyDataAlgorithm);
+
+    /** Meridians, 8 by default */
+    void SetThetaResolution(int resolution);
+    int GetThetaResolution() const { return _thetaResolution; }
+
+    /** Segments from pole to pole, 8 by default */
+    void SetPhiResolution(int resolution);
+    int GetPhiResolution() const { return _phiResolution; }
+
+protected:
+    ParallelSphereSource();
+    ~ParallelSphereSource();
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    int _thetaResolution;
+    int _phiResolution;
+
+    ParallelSphereSource(const ParallelSphereSource &);
+    void operator=(const ParallelSphereSource &);
+};
+
+/**
+   Source wrapper of coneGeometry.
+ */
+class ParallelConeSource : public vtkPolyDataAlgorithm
+{
+public:
+    static ParallelConeSource *New();
+    vtkTypeMacro(ParallelConeSource, vtkPolyDataAlgorithm);
+
+    /** Sides, 6 by default */
+    void SetResolution(int resolution);
+    int GetResolution() const { return _resolution; }
+
+protected:
+    ParallelConeSource();
+    ~ParallelConeSource();
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    int _resolution;
+
+    ParallelConeSource(const ParallelConeSource &);
+    void operator=(const ParallelConeSource &);
+};
+
+}
+
+#endif
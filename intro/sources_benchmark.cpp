@@ -0,0 +1,107 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+
+/* Generation time of spheres of resolution 256 to 4096 and of cones with
+   256 times as many sides, with vtkSphereSource and vtkConeSource, with
+   the parallel generators and from the geometry cache. */
+
+#include "procedural_sources.h"
+
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkConeSource.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSphereSource.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+void printRow(const char *shape, const int resolution, const double vtk,
+              const double parallel, const double cached)
+{
+    std::cout << std::setw(8) << shape << std::setw(12) << resolution
+              << std::setw(12) << vtk * 1e3 << std::setw(12)
+              << parallel * 1e3 << std::setw(12) << cached * 1e3
+              << std::setw(11) << vtk / parallel << 'x' << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int maxResolution = 4096;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxResolution = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max resolution]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << common::threadCount() << " threads" << std::endl;
+    std::cout << std::setw(8) << "shape" << std::setw(12) << "resolution"
+              << std::setw(12) << "vtk ms" << std::setw(12) << "parallel ms"
+              << std::setw(12) << "cached ms" << std::setw(12) << "speedup"
+              << std::endl;
+    for (int resolution = 256; resolution <= maxResolution; resolution *= 2)
+    {
+        vtkSmartPointer<vtkSphereSource> sphere =
+            vtkSmartPointer<vtkSphereSource>::New();
+        sphere->SetThetaResolution(resolution);
+        sphere->SetPhiResolution(resolution);
+        const double vtk = common::measure([&]() { sphere->Update(); });
+        mesh::clearGeometryCache();
+        const double parallel = common::measure([&]()
+        {
+            mesh::sphereGeometry(resolution, resolution);
+        });
+        const double cached = common::measure([&]()
+        {
+            mesh::sphereGeometry(resolution, resolution);
+        });
+        printRow("sphere", resolution, vtk, parallel, cached);
+    }
+    /* Cones are tiny, their resolution goes 256 times higher */
+    for (int resolution = 256; resolution <= maxResolution;
+         resolution *= 2)
+    {
+        vtkSmartPointer<vtkConeSource> cone =
+            vtkSmartPointer<vtkConeSource>::New();
+        cone->SetResolution(resolution * 256);
+        const double vtk = common::measure([&]() { cone->Update(); });
+        mesh::clearGeometryCache();
+        const double parallel = common::measure([&]()
+        {
+            mesh::coneGeometry(resolution * 256);
+        });
+        const double cached = common::measure([&]()
+        {
+            mesh::coneGeometry(resolution * 256);
+        });
+        printRow("cone", resolution * 256, vtk, parallel, cached);
+    }
+}
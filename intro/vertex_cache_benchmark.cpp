@@ -0,0 +1,171 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/* Average cache miss ratio and downstream filter times of grid meshes of
+   10^4 to 10^6 triangles with shuffled vertices and triangles, before and
+   after reordering them with optimizeVertexCache. */
+
+#include "vertex_cache_optimizer.h"
+#include "vertex_normals.h"
+
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCellArray.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkSmoothPolyDataFilter.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/* Post-transform cache size of the reordering and the miss ratio */
+const int CACHE_SIZE = 16;
+const int SMOOTHING_ITERATIONS = 10;
+
+/* Wavy height field of about count triangles in random order */
+vtkSmartPointer<vtkPolyData> shuffledGridMesh(const size_t count)
+{
+    const size_t side = std::max(size_t(2),
+                                 size_t(std::sqrt(count / 2.0)) + 1);
+    std::mt19937 random(0);
+    std::vector<vtkIdType> vertices(side * side);
+    for (size_t i = 0; i != vertices.size(); ++i)
+        vertices[i] = i;
+    std::shuffle(vertices.begin(), vertices.end(), random);
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataTypeToFloat();
+    points->SetNumberOfPoints(side * side);
+    float *p = static_cast<float *>(points->GetVoidPointer(0));
+    for (size_t y = 0; y != side; ++y)
+    {
+        for (size_t x = 0; x != side; ++x)
+        {
+            float *point = p + vertices[y * side + x] * 3;
+            point[0] = float(x) / side;
+            point[1] = float(y) / side;
+            point[2] = 0.05f * std::sin(point[0] * 40) *
+                       std::cos(point[1] * 30);
+        }
+    }
+
+    std::vector<vtkIdType> triangles;
+    triangles.reserve((side - 1) * (side - 1) * 6);
+    for (size_t y = 0; y + 1 != side; ++y)
+    {
+        for (size_t x = 0; x + 1 != side; ++x)
+        {
+            const vtkIdType a = vertices[y * side + x];
+            const vtkIdType b = vertices[y * side + x + 1];
+            const vtkIdType c = vertices[(y + 1) * side + x + 1];
+            const vtkIdType d = vertices[(y + 1) * side + x];
+            const vtkIdType quad[6] = {a, b, c, a, c, d};
+            triangles.insert(triangles.end(), quad, quad + 6);
+        }
+    }
+    const size_t triangleCount = triangles.size() / 3;
+    std::vector<size_t> order(triangleCount);
+    for (size_t i = 0; i != triangleCount; ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), random);
+
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    vtkIdType *ids = cells->WritePointer(triangleCount, triangleCount * 4);
+    for (size_t i = 0; i != triangleCount; ++i)
+    {
+        ids[i * 4] = 3;
+        std::copy(&triangles[order[i] * 3], &triangles[order[i] * 3] + 3,
+                  ids + i * 4 + 1);
+    }
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints(points);
+    mesh->SetPolys(cells);
+    return mesh;
+}
+
+double normalsTime(vtkPolyData *mesh)
+{
+    return common::measure([&]() { mesh::computeVertexNormals(mesh); });
+}
+
+double smoothingTime(vtkPolyData *mesh)
+{
+    vtkSmartPointer<vtkSmoothPolyDataFilter> smooth =
+        vtkSmartPointer<vtkSmoothPolyDataFilter>::New();
+    smooth->SetNumberOfIterations(SMOOTHING_ITERATIONS);
+    smooth->SetInputData(mesh);
+    return common::measure([&]() { smooth->Update(); });
+}
+
+int main(int argc, char *argv[])
+{
+    int maxExponent = 6;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxExponent = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max exponent]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << common::threadCount() << " threads, cache size "
+              << CACHE_SIZE << std::endl;
+    std::cout << std::setw(12) << "triangles" << std::setw(12) << "ACMR in"
+              << std::setw(12) << "ACMR out" << std::setw(12) << "reorder ms"
+              << std::setw(12) << "normals" << std::setw(12) << "smoothing"
+              << std::endl;
+    for (int exponent = 4; exponent <= maxExponent; ++exponent)
+    {
+        vtkSmartPointer<vtkPolyData> mesh =
+            shuffledGridMesh(size_t(std::pow(10.0, exponent)));
+        vtkSmartPointer<vtkPolyData> optimized;
+        const double reorder = common::measure([&]()
+        {
+            optimized = mesh::optimizeVertexCache(mesh, CACHE_SIZE);
+        });
+
+        /* Speedups of the filters on the reordered mesh */
+        const double normals = normalsTime(mesh) / normalsTime(optimized);
+        const double smoothing =
+            smoothingTime(mesh) / smoothingTime(optimized);
+
+        std::cout << std::setw(12) << mesh->GetNumberOfPolys()
+                  << std::setw(12)
+                  << mesh::averageCacheMissRatio(mesh, CACHE_SIZE)
+                  << std::setw(12)
+                  << mesh::averageCacheMissRatio(optimized, CACHE_SIZE)
+                  << std::setw(12) << reorder * 1e3 << std::setw(11)
+                  << normals << 'x' << std::setw(11) << smoothing << 'x'
+                  << std::endl;
+    }
+}
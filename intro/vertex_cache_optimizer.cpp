@@ -0,0 +1,340 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "vertex_cache_optimizer.h"
+#include "mesh_adjacency.h"
+
+#include "common/parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkDataSetAttributes.h>
+#include <vtkFieldData.h>
+#include <vtkIdTypeArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace mesh
+{
+
+namespace
+{
+
+const size_t COPY_CHUNK = 1 << 14;
+
+/* Returns the cell array of a mesh made only of triangles */
+const vtkIdType *triangleCells(vtkPolyData *mesh, size_t &count)
+{
+    count = mesh->GetNumberOfPolys();
+    if (count != 0 && !isTriangleMesh(mesh))
+        throw std::runtime_error("Only triangle meshes are supported");
+    return mesh->GetPolys()->GetData()->GetPointer(0);
+}
+
+/* Tipsify, returns the triangles in drawing order */
+std::vector<uint32_t> tipsify(const vtkIdType *cells,
+                              const size_t triangleCount,
+                              const size_t pointCount, const int cacheSize)
+{
+    const VertexAdjacency adjacency(cells, triangleCount, pointCount);
+    /* Triangles left to draw around each vertex */
+    std::vector<uint32_t> live(pointCount);
+    for (size_t v = 0; v != pointCount; ++v)
+        live[v] = uint32_t(adjacency.degree(v));
+    /* Time at which each vertex entered the cache. Time advances with
+       every cache miss and starts past the cache size so no vertex is
+       in the cache initially. */
+    std::vector<size_t> entered(pointCount, 0);
+    size_t time = cacheSize + 1;
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    /* Recently used vertices to go back to when a fan ends */
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    size_t cursor = 0;
+
+    std::vector<uint32_t> order;
+    order.reserve(triangleCount);
+    int64_t fanning = pointCount == 0 ? -1 : 0;
+    while (fanning != -1)
+    {
+        candidates.clear();
+        const uint32_t *around = adjacency.polygons(fanning);
+        for (size_t i = 0; i != adjacency.degree(fanning); ++i)
+        {
+            const uint32_t triangle = around[i];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = 1;
+            order.push_back(triangle);
+            const vtkIdType *vertices = cells + size_t(triangle) * 4 + 1;
+            for (int j = 0; j != 3; ++j)
+            {
+                const uint32_t v = uint32_t(vertices[j]);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - entered[v] > size_t(cacheSize))
+                    entered[v] = time++;
+            }
+        }
+
+        /* Next fanning vertex: the candidate that entered the cache the
+           earliest among those that will still be in it after drawing
+           their remaining triangles, or else any candidate with
+           triangles left. */
+        fanning = -1;
+        int64_t best = -1;
+        for (size_t i = 0; i != candidates.size(); ++i)
+        {
+            const uint32_t v = candidates[i];
+            if (live[v] == 0)
+                continue;
+            int64_t priority = 0;
+            if (time - entered[v] + 2 * live[v] <= size_t(cacheSize))
+                priority = time - entered[v];
+            if (priority > best)
+            {
+                best = priority;
+                fanning = v;
+            }
+        }
+        if (fanning != -1)
+            continue;
+
+        /* Dead end, going back to recently used vertices and then to the
+           next unvisited vertex in index order. */
+        while (!deadEnds.empty() && fanning == -1)
+        {
+            const uint32_t v = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[v] != 0)
+                fanning = v;
+        }
+        for (; cursor != pointCount && fanning == -1; ++cursor)
+            if (live[cursor] != 0)
+                fanning = cursor;
+    }
+    return order;
+}
+
+/* out[i] = in[source[i]] for all the tuples of an array */
+void gather(vtkDataArray *in, vtkDataArray *out,
+            const std::vector<uint32_t> &source)
+{
+    out->SetNumberOfComponents(in->GetNumberOfComponents());
+    out->SetNumberOfTuples(source.size());
+    const size_t bytes =
+        size_t(in->GetNumberOfComponents()) * in->GetDataTypeSize();
+    const char *from = static_cast<const char *>(in->GetVoidPointer(0));
+    char *to = static_cast<char *>(out->GetVoidPointer(0));
+    common::parallelForChunks(0, source.size(), COPY_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+            memcpy(to + i * bytes, from + size_t(source[i]) * bytes, bytes);
+    });
+}
+
+/* Permutes all the data arrays of in into out keeping the active
+   attributes. */
+void gatherAttributes(vtkDataSetAttributes *in, vtkDataSetAttributes *out,
+                      const std::vector<uint32_t> &source)
+{
+    for (int i = 0; i != in->GetNumberOfArrays(); ++i)
+    {
+        vtkDataArray *array = in->GetArray(i);
+        if (!array)
+            continue;
+        vtkSmartPointer<vtkDataArray> copy;
+        copy.TakeReference(array->NewInstance());
+        copy->SetName(array->GetName());
+        gather(array, copy, source);
+        const int index = out->AddArray(copy);
+        const int attribute = in->IsArrayAnAttribute(i);
+        if (attribute != -1)
+            out->SetActiveAttribute(index, attribute);
+    }
+}
+
+}
+
+bool isTriangleMesh(vtkPolyData *mesh)
+{
+    if (mesh->GetNumberOfVerts() || mesh->GetNumberOfLines() ||
+        mesh->GetNumberOfStrips())
+        return false;
+    const size_t count = mesh->GetNumberOfPolys();
+    vtkIdTypeArray *ids = mesh->GetPolys()->GetData();
+    if (count == 0 || size_t(ids->GetNumberOfTuples()) != count * 4)
+        return false;
+    const vtkIdType *cells = ids->GetPointer(0);
+    for (size_t i = 0; i != count; ++i)
+        if (cells[i * 4] != 3)
+            return false;
+    return true;
+}
+
+double averageCacheMissRatio(vtkPolyData *mesh, const int cacheSize)
+{
+    size_t triangleCount;
+    const vtkIdType *cells = triangleCells(mesh, triangleCount);
+    if (triangleCount == 0)
+        return 0;
+
+    /* A vertex is in the FIFO cache if fewer than cacheSize vertices were
+       added after it. */
+    std::vector<size_t> added(mesh->GetNumberOfPoints(), 0);
+    size_t misses = 0;
+    for (size_t i = 0; i != triangleCount * 4; ++i)
+    {
+        if (i % 4 == 0)
+            continue;
+        size_t &time = added[cells[i]];
+        if (time == 0 || misses - time >= size_t(cacheSize))
+            time = ++misses;
+    }
+    return double(misses) / triangleCount;
+}
+
+vtkSmartPointer<vtkPolyData> optimizeVertexCache(vtkPolyData *mesh,
+                                                 const int cacheSize)
+{
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    if (!mesh->GetPoints())
+        return output;
+
+    const size_t pointCount = mesh->GetNumberOfPoints();
+    if (pointCount > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Too many points");
+    size_t triangleCount;
+    const vtkIdType *cells = triangleCells(mesh, triangleCount);
+    const std::vector<uint32_t> order =
+        tipsify(cells, triangleCount, pointCount, cacheSize);
+
+    /* Vertex numbers in first use order */
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> renumbering(pointCount, unused);
+    uint32_t next = 0;
+    for (size_t i = 0; i != triangleCount; ++i)
+    {
+        const vtkIdType *vertices = cells + size_t(order[i]) * 4 + 1;
+        for (int j = 0; j != 3; ++j)
+            if (renumbering[vertices[j]] == unused)
+                renumbering[vertices[j]] = next++;
+    }
+    for (size_t v = 0; v != pointCount; ++v)
+        if (renumbering[v] == unused)
+            renumbering[v] = next++;
+    std::vector<uint32_t> source(pointCount);
+    for (size_t v = 0; v != pointCount; ++v)
+        source[renumbering[v]] = uint32_t(v);
+
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+    vtkIdType *out = polys->WritePointer(triangleCount, triangleCount * 4);
+    common::parallelForChunks(0, triangleCount, COPY_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const vtkIdType *vertices = cells + size_t(order[i]) * 4 + 1;
+            vtkIdType *triangle = out + i * 4;
+            triangle[0] = 3;
+            for (int j = 0; j != 3; ++j)
+                triangle[j + 1] = renumbering[vertices[j]];
+        }
+    });
+
+    vtkDataArray *coordinates = mesh->GetPoints()->GetData();
+    vtkSmartPointer<vtkDataArray> reordered;
+    reordered.TakeReference(coordinates->NewInstance());
+    gather(coordinates, reordered, source);
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(reordered);
+
+    output->SetPoints(points);
+    output->SetPolys(polys);
+    gatherAttributes(mesh->GetPointData(), output->GetPointData(), source);
+    gatherAttributes(mesh->GetCellData(), output->GetCellData(), order);
+    output->GetFieldData()->ShallowCopy(mesh->GetFieldData());
+    return output;
+}
+
+vtkStandardNewMacro(VertexCacheOptimizer);
+
+VertexCacheOptimizer::VertexCacheOptimizer()
+    : _cacheSize(16)
+    , _inputRatio(0)
+    , _outputRatio(0)
+{
+}
+
+VertexCacheOptimizer::~VertexCacheOptimizer()
+{
+}
+
+void VertexCacheOptimizer::SetCacheSize(const int size)
+{
+    const int cacheSize = std::max(size, 3);
+    if (cacheSize == _cacheSize)
+        return;
+    _cacheSize = cacheSize;
+    Modified();
+}
+
+int VertexCacheOptimizer::RequestData(vtkInformation *,
+                                      vtkInformationVector **inputVector,
+                                      vtkInformationVector *outputVector)
+{
+    vtkPolyData *input = vtkPolyData::GetData(inputVector[0]);
+    vtkPolyData *output = vtkPolyData::GetData(outputVector);
+    _inputRatio = _outputRatio = 0;
+    if (!isTriangleMesh(input))
+    {
+        output->ShallowCopy(input);
+        return 1;
+    }
+    try
+    {
+        vtkSmartPointer<vtkPolyData> optimized =
+            optimizeVertexCache(input, _cacheSize);
+        _inputRatio = averageCacheMissRatio(input, _cacheSize);
+        _outputRatio = averageCacheMissRatio(optimized, _cacheSize);
+        output->ShallowCopy(optimized);
+    }
+    catch (const std::runtime_error &e)
+    {
+        vtkErrorMacro(<< e.what());
+        return 0;
+    }
+    return 1;
+}
+
+}
@@ -0,0 +1,98 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_VERTEX_CACHE_OPTIMIZER_H
+#define INTRO_VERTEX_CACHE_OPTIMIZER_H
+
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkSmartPointer.h>
+
+class vtkPolyData;
+
+namespace mesh
+{
+
+/** True if the mesh has only triangles, and at least one */
+bool isTriangleMesh(vtkPolyData *mesh);
+
+/**
+   Average cache miss ratio of a triangle mesh: vertices transformed per
+   triangle when drawn in order with a FIFO post-transform cache of
+   cacheSize vertices. It goes from 3 down to about 0.5 for a regular
+   mesh in an ideal order.
+   Throws std::runtime_error if the polygons are not triangles.
+ */
+double averageCacheMissRatio(vtkPolyData *mesh, int cacheSize);
+
+/**
+   Returns a copy of a triangle mesh reordered for locality.
+
+   Triangles are reordered with Tipsify (Sander, Nehab and Barczak, Fast
+   triangle reordering for vertex locality and reduced overdraw, 2007):
+   it fans around vertices in cache and jumps to the most recently used
+   vertex with triangles left when it runs out of them, keeping the
+   working set within cacheSize vertices. Then vertices are renumbered in
+   the order they are first used, so the triangles read the point arrays
+   almost sequentially. Vertices without triangles go last. All the point
+   data arrays are permuted with the points.
+
+   Throws std::runtime_error if the polygons are not triangles or refer
+   to points that don't exist.
+ */
+vtkSmartPointer<vtkPolyData> optimizeVertexCache(vtkPolyData *mesh,
+                                                 int cacheSize);
+
+/**
+   Filter wrapper of optimizeVertexCache which also keeps the average
+   cache miss ratio of its last input and output. Meshes with other cells
+   than triangles are passed through unchanged.
+ */
+class VertexCacheOptimizer : public vtkPolyDataAlgorithm
+{
+public:
+    static VertexCacheOptimizer *New();
+    vtkTypeMacro(VertexCacheOptimizer, vtkPolyDataAlgorithm);
+
+    /** Post-transform cache size, 16 by default */
+    void SetCacheSize(int size);
+    int GetCacheSize() const { return _cacheSize; }
+
+    double GetInputCacheMissRatio() const { return _inputRatio; }
+    double GetOutputCacheMissRatio() const { return _outputRatio; }
+
+protected:
+    VertexCacheOptimizer();
+    ~VertexCacheOptimizer();
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    int _cacheSize;
+    double _inputRatio;
+    double _outputRatio;
+
+    VertexCacheOptimizer(const VertexCacheOptimizer &);
+    void operator=(const VertexCacheOptimizer &);
+};
+
+}
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "vertex_normals.h"
+#include "mesh_adjacency.h"
+
+#include "common/parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace mesh
+{
+
+namespace
+{
+
+const size_t POLYGON_CHUNK = 1 << 14;
+const size_t VERTEX_CHUNK = 1 << 14;
+
+/* Cross product of the edges from o to a and b */
+template<typename T>
+inline void triangleNormal(const double *o, const T *a, const T *b,
+                           double *normal)
+{
+    const double u[3] = {double(a[0]) - o[0], double(a[1]) - o[1],
+                         double(a[2]) - o[2]};
+    const double v[3] = {double(b[0]) - o[0], double(b[1]) - o[1],
+                         double(b[2]) - o[2]};
+    normal[0] = u[1] * v[2] - u[2] * v[1];
+    normal[1] = u[2] * v[0] - u[0] * v[2];
+    normal[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+inline void storeNormal(const double *normal, float *out)
+{
+    out[0] = float(normal[0]);
+    out[1] = float(normal[1]);
+    out[2] = float(normal[2]);
+}
+
+/* The length of the polygon normals is twice their area. Triangles use
+   the cross product of two edges and other polygons Newell's method,
+   relative to their first vertex to keep the precision far from the
+   origin. */
+template<typename T>
+void polygonNormals(const T *points, const VertexAdjacency &adjacency,
+                    const size_t count, float *normals)
+{
+    common::parallelForChunks(0, count, POLYGON_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const vtkIdType *polygon = adjacency.polygon(i);
+            const vtkIdType size = polygon[0];
+            double normal[3] = {0, 0, 0};
+            if (size >= 3)
+            {
+                const T *origin = points + polygon[1] * 3;
+                const double o[3] = {double(origin[0]), double(origin[1]),
+                                     double(origin[2])};
+                double p[3] = {0, 0, 0};
+                if (size == 3)
+                    triangleNormal(o, points + polygon[2] * 3,
+                                   points + polygon[3] * 3, normal);
+                else
+                {
+                    for (vtkIdType j = 2; j <= size + 1; ++j)
+                    {
+                        const T *r = points + polygon[j > size ? 1 : j] * 3;
+                        const double q[3] = {double(r[0]) - o[0],
+                                             double(r[1]) - o[1],
+                                             double(r[2]) - o[2]};
+                        normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+                        normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+                        normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+                        std::copy(q, q + 3, p);
+                    }
+                }
+            }
+            storeNormal(normal, normals + i * 3);
+        }
+    });
+}
+
+/* Normals of a triangle list with 32 bit indices, as polygonNormals */
+void triangleNormals(const float *points, const uint32_t *triangles,
+                     const size_t count, float *normals)
+{
+    common::parallelForChunks(0, count, POLYGON_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const uint32_t *triangle = triangles + i * 3;
+            const float *origin = points + size_t(triangle[0]) * 3;
+            const double o[3] = {double(origin[0]), double(origin[1]),
+                                 double(origin[2])};
+            double normal[3];
+            triangleNormal(o, points + size_t(triangle[1]) * 3,
+                           points + size_t(triangle[2]) * 3, normal);
+            storeNormal(normal, normals + i * 3);
+        }
+    });
+}
+
+/* Every vertex adds up the normals of its polygons */
+vtkSmartPointer<vtkFloatArray> gatherNormals(
+    const VertexAdjacency &adjacency, const std::vector<float> &polygons,
+    const size_t pointCount)
+{
+    vtkSmartPointer<vtkFloatArray> normals =
+        vtkSmartPointer<vtkFloatArray>::New();
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(pointCount);
+    float *out = normals->GetPointer(0);
+    common::parallelForChunks(0, pointCount, VERTEX_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t v = first; v != last; ++v)
+        {
+            float sum[3] = {0, 0, 0};
+            const uint32_t *around = adjacency.polygons(v);
+            for (size_t i = 0; i != adjacency.degree(v); ++i)
+            {
+                const float *normal = &polygons[size_t(around[i]) * 3];
+                sum[0] += normal[0];
+                sum[1] += normal[1];
+                sum[2] += normal[2];
+            }
+            const float length =
+                std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+            const float scale = length > 0 ? 1 / length : 0;
+            out[v * 3] = sum[0] * scale;
+            out[v * 3 + 1] = sum[1] * scale;
+            out[v * 3 + 2] = sum[2] * scale;
+        }
+    });
+    return normals;
+}
+
+}
+
+vtkSmartPointer<vtkFloatArray> computeVertexNormals(vtkPolyData *mesh)
+{
+    if (!mesh->GetPoints())
+    {
+        vtkSmartPointer<vtkFloatArray> normals =
+            vtkSmartPointer<vtkFloatArray>::New();
+        normals->SetName("Normals");
+        normals->SetNumberOfComponents(3);
+        return normals;
+    }
+
+    vtkDataArray *points = mesh->GetPoints()->GetData();
+    const size_t pointCount = points->GetNumberOfTuples();
+    const size_t polygonCount = mesh->GetPolys()->GetNumberOfCells();
+    const vtkIdType *cells = mesh->GetPolys()->GetData()->GetPointer(0);
+
+    const VertexAdjacency adjacency(cells, polygonCount, pointCount);
+
+    std::vector<float> polygons(polygonCount * 3);
+    switch (points->GetDataType())
+    {
+        vtkTemplateMacro(
+            polygonNormals(static_cast<const VTK_TT *>(
+                               points->GetVoidPointer(0)),
+                           adjacency, polygonCount, polygons.data()));
+    default:
+        throw std::runtime_error("Unsupported point type");
+    }
+
+    return gatherNormals(adjacency, polygons, pointCount);
+}
+
+vtkSmartPointer<vtkFloatArray> computeVertexNormals(const float *points,
+                                                    const size_t pointCount,
+                                                    const uint32_t *triangles,
+                                                    const size_t triangleCount)
+{
+    const VertexAdjacency adjacency(triangles, triangleCount, pointCount);
+    std::vector<float> polygons(triangleCount * 3);
+    triangleNormals(points, triangles, triangleCount, polygons.data());
+    return gatherNormals(adjacency, polygons, pointCount);
+}
+
+vtkStandardNewMacro(VertexNormalsFilter);
+
+VertexNormalsFilter::VertexNormalsFilter()
+{
+}
+
+VertexNormalsFilter::~VertexNormalsFilter()
+{
+}
+
+int VertexNormalsFilter::RequestData(vtkInformation *,
+                                     vtkInformationVector **inputVector,
+                                     vtkInformationVector *outputVector)
+{
+    vtkPolyData *input = vtkPolyData::GetData(inputVector[0]);
+    vtkPolyData *output = vtkPolyData::GetData(outputVector);
+    try
+    {
+        vtkSmartPointer<vtkFloatArray> normals = computeVertexNormals(input);
+        output->ShallowCopy(input);
+        output->GetPointData()->SetNormals(normals);
+    }
+    catch (const std::runtime_error &e)
+    {
+        vtkErrorMacro(<< e.what());
+        return 0;
+    }
+    return 1;
+}
+
+}
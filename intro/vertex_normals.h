@@ -0,0 +1,87 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef INTRO_VERTEX_NORMALS_H
+#define INTRO_VERTEX_NORMALS_H
+
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <cstdint>
+
+class vtkFloatArray;
+class vtkPolyData;
+
+namespace mesh
+{
+
+/**
+   Computes the unit normals of the vertices of a polygonal mesh as the
+   sum of the normals of the polygons around them, weighted by polygon
+   area.
+
+   Unlike vtkPolyDataNormals there are no consistency checks nor edge
+   splitting, the mesh is used as it is. Polygon normals are computed in
+   parallel, then a vertex to polygon adjacency in compressed sparse row
+   form is built and every vertex gathers the normals of its polygons in
+   parallel, so no thread writes to another vertex and no atomics are
+   needed. The sums follow the polygon order, the result doesn't depend
+   on the number of threads.
+
+   Vertices without polygons get a zero normal. Throws std::runtime_error
+   if a polygon refers to a point that doesn't exist.
+ */
+vtkSmartPointer<vtkFloatArray> computeVertexNormals(vtkPolyData *mesh);
+
+/**
+   Same as above for a triangle list with float points and 3 indices of
+   32 bits per triangle, see CompactMesh.
+ */
+vtkSmartPointer<vtkFloatArray> computeVertexNormals(const float *points,
+                                                    size_t pointCount,
+                                                    const uint32_t *triangles,
+                                                    size_t triangleCount);
+
+/**
+   Filter wrapper of computeVertexNormals. The output shares the input
+   arrays and adds the normals to the point data.
+ */
+class VertexNormalsFilter : public vtkPolyDataAlgorithm
+{
+public:
+    static VertexNormalsFilter *New();
+    vtkTypeMacro(VertexNormalsFilter, vtkPolyDataAlgorithm);
+
+protected:
+    VertexNormalsFilter();
+    ~VertexNormalsFilter();
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    VertexNormalsFilter(const VertexNormalsFilter &);
+    void operator=(const VertexNormalsFilter &);
+};
+
+}
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/* Renders the sphere grid of ray_cast_spheres with the CPU ray caster,
+   without a GPU nor an X server.
+
+   The frame is written as prefix.png and prefix_depth.vtk. Given a frame
+   captured from the shaders with ray_cast_spheres --snapshot, it is
+   compared with it and the program fails if they differ, so it can be
+   used as a regression test of the shaders. With --quantize the spheres
+   are quantized as in ray_cast_spheres --quantize. */
+
+#include "frame_io.h"
+#include "sphere_grid.h"
+#include "sphere_quantization.h"
+#include "sphere_ray_caster.h"
+
+#include "common/parallel.h"
+
+#include <vtkActor.h>
+#include <vtkCamera.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Pixels allowed to differ, mostly along the silhouettes */
+const double MAX_MISMATCH_RATIO = 0.005;
+const double MAX_DEPTH_DIFFERENCE = 1e-4;
+
+double seconds(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    std::string output = "cpu_spheres";
+    std::string reference;
+    int size[2] = {800, 800};
+    bool quantize = false;
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "--compare" && i + 1 < argc)
+            reference = argv[++i];
+        else if (arg == "--quantize")
+            quantize = true;
+        else if (arg == "--size" && i + 2 < argc)
+        {
+            size[0] = atoi(argv[++i]);
+            size[1] = atoi(argv[++i]);
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            std::cerr << "Usage: " << argv[0] << " [--size W H] "
+                      << "[--output prefix] [--compare prefix] [--quantize] "
+                      << "[width [height depth]]" << std::endl;
+            return -1;
+        }
+        else
+            sizes.push_back(atoi(argv[i]));
+    }
+    /* Same grid and window as ray_cast_spheres */
+    size_t dimensions[3] = {5, 5, 5};
+    if (sizes.size() == 1)
+        dimensions[0] = dimensions[1] = dimensions[2] = sizes[0];
+    else if (sizes.size() >= 3)
+        std::copy(sizes.begin(), sizes.begin() + 3, dimensions);
+
+    vtkSmartPointer<vtkPolyData> data =
+        spheres::sphereGrid(dimensions[0], dimensions[1], dimensions[2]);
+    if (quantize)
+        data = spheres::quantizeSpheres(data);
+
+    /* The camera is placed by a renderer with the same props and window
+       size as the interactive demo. The window is never rendered. */
+    vtkSmartPointer<vtkPolyDataMapper> mapper =
+        vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputDataObject(data);
+    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mapper);
+    if (quantize)
+        actor->SetUserMatrix(spheres::dequantizationMatrix(
+            spheres::sphereQuantization(data)));
+    vtkSmartPointer<vtkRenderer> renderer =
+        vtkSmartPointer<vtkRenderer>::New();
+    renderer->AddActor(actor);
+    vtkSmartPointer<vtkRenderWindow> window =
+        vtkSmartPointer<vtkRenderWindow>::New();
+    window->SetSize(size[0], size[1]);
+    window->AddRenderer(renderer);
+    renderer->ResetCamera();
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    spheres::SphereRayCaster caster(data);
+    const double buildTime = seconds(start);
+    caster.setBackground(0.2, 0.3, 0.4);
+
+    start = std::chrono::steady_clock::now();
+    caster.render(renderer->GetActiveCamera(), size[0], size[1]);
+    const double renderTime = seconds(start);
+
+    std::cout << caster.sphereCount() << " spheres, "
+              << caster.bvh().nodes().size() << " BVH nodes built in "
+              << buildTime << " s" << std::endl;
+    std::cout << size[0] << "x" << size[1] << " rendered in " << renderTime
+              << " s with " << common::threadCount() << " threads ("
+              << size[0] * size[1] / renderTime * 1e-6 << " Mrays/s)"
+              << std::endl;
+
+    spheres::Frame frame;
+    frame.color = caster.colorImage();
+    frame.depth = caster.depthImage();
+    spheres::writeFrame(frame, output);
+
+    if (reference.empty())
+        return 0;
+
+    try
+    {
+        const spheres::FrameDifference difference =
+            spheres::compareFrames(frame, spheres::readFrame(reference));
+        const double mismatchRatio =
+            double(difference.colorMismatches) / difference.pixels;
+        std::cout << "Compared with " << reference << ": "
+                  << difference.colorMismatches << " pixels differ ("
+                  << mismatchRatio * 100 << "%), largest color difference "
+                  << difference.maxColorDifference
+                  << ", largest depth difference "
+                  << difference.maxDepthDifference << std::endl;
+        if (mismatchRatio > MAX_MISMATCH_RATIO ||
+            difference.maxDepthDifference > MAX_DEPTH_DIFFERENCE)
+        {
+            std::cerr << "Frames differ" << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
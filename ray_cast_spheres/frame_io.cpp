@@ -0,0 +1,159 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "frame_io.h"
+
+#include <vtkDataArray.h>
+#include <vtkDataSetReader.h>
+#include <vtkDataSetWriter.h>
+#include <vtkImageData.h>
+#include <vtkPNGReader.h>
+#include <vtkPNGWriter.h>
+#include <vtkPointData.h>
+#include <vtkRenderWindow.h>
+#include <vtkWindowToImageFilter.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace spheres
+{
+
+namespace
+{
+
+vtkSmartPointer<vtkImageData> readBuffer(vtkRenderWindow *window,
+                                         const bool depth)
+{
+    vtkSmartPointer<vtkWindowToImageFilter> capture =
+        vtkSmartPointer<vtkWindowToImageFilter>::New();
+    capture->SetInput(window);
+    if (depth)
+        capture->SetInputBufferTypeToZBuffer();
+    else
+        capture->SetInputBufferTypeToRGBA();
+    capture->ReadFrontBufferOff();
+    capture->ShouldRerenderOff();
+    capture->Update();
+
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    image->DeepCopy(capture->GetOutput());
+    return image;
+}
+
+}
+
+Frame captureFrame(vtkRenderWindow *window)
+{
+    Frame frame;
+    frame.color = readBuffer(window, false);
+    frame.depth = readBuffer(window, true);
+    return frame;
+}
+
+void writeFrame(const Frame &frame, const std::string &prefix)
+{
+    vtkSmartPointer<vtkPNGWriter> color = vtkSmartPointer<vtkPNGWriter>::New();
+    color->SetInputData(frame.color);
+    color->SetFileName((prefix + ".png").c_str());
+    color->Write();
+
+    vtkSmartPointer<vtkDataSetWriter> depth =
+        vtkSmartPointer<vtkDataSetWriter>::New();
+    depth->SetInputData(frame.depth);
+    depth->SetFileName((prefix + "_depth.vtk").c_str());
+    depth->SetFileTypeToBinary();
+    depth->Write();
+}
+
+Frame readFrame(const std::string &prefix)
+{
+    Frame frame;
+    const std::string colorFile = prefix + ".png";
+    vtkSmartPointer<vtkPNGReader> color = vtkSmartPointer<vtkPNGReader>::New();
+    if (!color->CanReadFile(colorFile.c_str()))
+        throw std::runtime_error("Could not read " + colorFile);
+    color->SetFileName(colorFile.c_str());
+    color->Update();
+    frame.color = color->GetOutput();
+
+    const std::string depthFile = prefix + "_depth.vtk";
+    vtkSmartPointer<vtkDataSetReader> depth =
+        vtkSmartPointer<vtkDataSetReader>::New();
+    depth->SetFileName(depthFile.c_str());
+    depth->Update();
+    frame.depth = vtkImageData::SafeDownCast(depth->GetOutput());
+    if (!frame.depth || !frame.depth->GetPointData()->GetScalars())
+        throw std::runtime_error("Could not read " + depthFile);
+    return frame;
+}
+
+FrameDifference compareFrames(const Frame &frame, const Frame &reference,
+                              const int colorTolerance)
+{
+    int size[3];
+    frame.color->GetDimensions(size);
+    if (!std::equal(size, size + 2, reference.color->GetDimensions()) ||
+        !std::equal(size, size + 2, frame.depth->GetDimensions()) ||
+        !std::equal(size, size + 2, reference.depth->GetDimensions()))
+        throw std::runtime_error("Frame sizes differ");
+
+    FrameDifference difference;
+    difference.pixels = size_t(size[0]) * size[1];
+    difference.colorMismatches = 0;
+    difference.maxColorDifference = 0;
+    difference.maxDepthDifference = 0;
+
+    const int components = frame.color->GetNumberOfScalarComponents();
+    const int referenceComponents =
+        reference.color->GetNumberOfScalarComponents();
+    const unsigned char *color =
+        static_cast<unsigned char *>(frame.color->GetScalarPointer());
+    const unsigned char *referenceColor =
+        static_cast<unsigned char *>(reference.color->GetScalarPointer());
+    vtkDataArray *depth = frame.depth->GetPointData()->GetScalars();
+    vtkDataArray *referenceDepth =
+        reference.depth->GetPointData()->GetScalars();
+
+    for (size_t i = 0; i != difference.pixels; ++i)
+    {
+        int pixelDifference = 0;
+        for (int j = 0; j != 3; ++j)
+            pixelDifference = std::max(
+                pixelDifference,
+                std::abs(int(color[i * components + j]) -
+                         int(referenceColor[i * referenceComponents + j])));
+        difference.maxColorDifference =
+            std::max(difference.maxColorDifference, pixelDifference);
+        if (pixelDifference > colorTolerance)
+            ++difference.colorMismatches;
+
+        const double z = depth->GetComponent(i, 0);
+        const double referenceZ = referenceDepth->GetComponent(i, 0);
+        if (z < 1 && referenceZ < 1)
+            difference.maxDepthDifference =
+                std::max(difference.maxDepthDifference,
+                         std::fabs(z - referenceZ));
+    }
+    return difference;
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_FRAME_IO_H
+#define RAY_CAST_SPHERES_FRAME_IO_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <string>
+
+class vtkImageData;
+class vtkRenderWindow;
+
+namespace spheres
+{
+
+/**
+   Color and depth buffers of a rendered frame, used to compare the
+   impostor shaders with the CPU ray caster.
+ */
+struct Frame
+{
+    /** Unsigned char RGB or RGBA image */
+    vtkSmartPointer<vtkImageData> color;
+    /** Float depth in window coordinates */
+    vtkSmartPointer<vtkImageData> depth;
+};
+
+/** Reads back the color and depth buffers of the last rendered frame */
+Frame captureFrame(vtkRenderWindow *window);
+
+/** Writes prefix.png and prefix_depth.vtk */
+void writeFrame(const Frame &frame, const std::string &prefix);
+
+/** Reads a frame written by writeFrame. Throws std::runtime_error if the
+    files can't be read. */
+Frame readFrame(const std::string &prefix);
+
+struct FrameDifference
+{
+    size_t pixels;
+    /** Pixels with any RGB channel differing by more than the tolerance */
+    size_t colorMismatches;
+    int maxColorDifference;
+    /** Largest depth difference among the pixels covered in both frames */
+    double maxDepthDifference;
+};
+
+/** Throws std::runtime_error if the frames have different sizes */
+FrameDifference compareFrames(const Frame &frame, const Frame &reference,
+                              int colorTolerance = 2);
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_grid.h"
+#include "sphere_trajectory.h"
+
+#include "common/parallel.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Writes a trajectory of a cubic sphere grid in which every sphere
+   oscillates around its grid position with its own phase and the radii
+   pulse, to test ray_cast_spheres --trajectory. */
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    size_t frames = 100;
+    size_t size = 50;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (arg == "--size" && i + 1 < argc)
+            size = atoi(argv[++i]);
+        else
+            args.push_back(arg);
+    }
+    if (args.size() != 1 || frames == 0 || size == 0)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " output.traj [--frames count] [--size grid_size]"
+                  << std::endl;
+        return 1;
+    }
+
+    const size_t count = size * size * size;
+    std::vector<float> positions(count * 3);
+    std::vector<float> radii(count);
+    try
+    {
+        spheres::TrajectoryWriter writer(args[0], count, frames);
+        for (size_t frame = 0; frame != frames; ++frame)
+        {
+            const float angle = 2 * M_PI * frame / frames;
+            common::parallelFor(0, count, [&](const size_t index)
+            {
+                const size_t i = index / (size * size);
+                const size_t j = index / size % size;
+                const size_t k = index % size;
+                const float phase = angle + (i + j + k) * 0.3f;
+                const float offset =
+                    0.3f * spheres::GRID_SPACING * std::sin(phase);
+                positions[index * 3] = i * spheres::GRID_SPACING + offset;
+                positions[index * 3 + 1] =
+                    j * spheres::GRID_SPACING + std::cos(phase) * offset;
+                positions[index * 3 + 2] = k * spheres::GRID_SPACING;
+                radii[index] = spheres::gridRadius(i, j, k, size, size, size) *
+                               (0.9f + 0.1f * std::cos(phase));
+            });
+            writer.writeFrame(positions.data(), radii.data());
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << frames << " frames of " << count << " spheres written to "
+              << args[0] << std::endl;
+    return 0;
+}
@@ -16,11 +16,24 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include "frame_io.h"
+#include "shader_sources.h"
+#include "shader_watcher.h"
+#include "sphere_bvh.h"
+#include "sphere_culler.h"
+#include "sphere_grid.h"
+#include "sphere_lod.h"
+#include "sphere_quantization.h"
+#include "sphere_sorter.h"
+#include "sphere_trajectory.h"
+
 #include "common/paths.h"
 
 #include <vtkActor.h>
 #include <vtkCellArray.h>
+#include <vtkCommand.h>
 #include <vtkInformation.h>
+#include <vtkMatrix4x4.h>
 #include <vtkFloatArray.h>
 #include <vtkOpenGLProperty.h>
 #include <vtkPolyData.h>
@@ -35,39 +48,570 @@
 #include <vtkShaderProgram2.h>
 #include <vtkShader2Collection.h>
 #include <vtkSmartPointer.h>
-
+#include <vtkTextActor.h>
+#include <vtkTextProperty.h>
+#include <vtkUniformVariables.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
 #include <sstream>
-#include <fstream>
+#include <stdexcept>
+#include <memory>
+#include <vector>
 
 #include <vtkOpenGLExtensionManager.h>
 #include <GL/gl.h>
 
-vtkSmartPointer<vtkPolyDataMapper> pointGrid();
-vtkSmartPointer<vtkShaderProgram2> createSphereShadingProgram();
+vtkSmartPointer<vtkPolyDataMapper> pointGrid(size_t width, size_t height,
+                                              size_t depth);
+vtkSmartPointer<vtkPolyDataMapper> sphereMapper(vtkPolyData *data);
+/* Sphere shader stages in the order they are added to the program */
+const size_t SHADER_STAGES = 3;
+const char *const SHADER_FILES[SHADER_STAGES] = {
+    "sphere.vert", "sphere.geom", "sphere.frag"};
+const int SHADER_TYPES[SHADER_STAGES] = {
+    VTK_SHADER_TYPE_VERTEX, VTK_SHADER_TYPE_GEOMETRY,
+    VTK_SHADER_TYPE_FRAGMENT};
+typedef std::vector<vtkSmartPointer<vtkShader2>> Shaders;
+
+/* The quantization is null for unquantized spheres */
+vtkSmartPointer<vtkShader2> createShader(
+    size_t stage, const std::string &code,
+    const spheres::SphereQuantization *quantization);
+Shaders createSphereShaders(const std::string &shaderDirectory,
+                            const spheres::SphereQuantization *quantization);
+vtkSmartPointer<vtkShaderProgram2> createSphereShadingProgram(
+    const Shaders &shaders, const spheres::SphereQuantization *quantization);
+void releaseProgram(vtkShaderProgram2 *program, const Shaders &keep);
+
+/* Prints the sphere under the mouse pointer when 'p' is pressed. The
+   BVH is built on the first pick and rebuilt when the data changes. */
+class SpherePicker : public vtkCommand
+{
+public:
+    static SpherePicker *New(vtkPolyData *data, vtkRenderer *renderer)
+    {
+        return new SpherePicker(data, renderer);
+    }
+
+    virtual void Execute(vtkObject *caller, unsigned long, void*)
+    {
+        vtkRenderWindowInteractor *interactor =
+            static_cast<vtkRenderWindowInteractor *>(caller);
+        if (interactor->GetKeyCode() != 'p')
+            return;
+        if (!_bvh || _data->GetMTime() != _time)
+        {
+            _time = _data->GetMTime();
+            _spheres = spheres::packSpheres(_data);
+            _bvh.reset(new spheres::SphereBVH(_spheres.data(),
+                                              _spheres.size() / 4));
+        }
+
+        /* Ray through the pixel from the near to the far plane */
+        const int *position = interactor->GetEventPosition();
+        double ends[2][3];
+        for (int i = 0; i != 2; ++i)
+        {
+            _renderer->SetDisplayPoint(position[0], position[1], i);
+            _renderer->DisplayToWorld();
+            const double *point = _renderer->GetWorldPoint();
+            for (int j = 0; j != 3; ++j)
+                ends[i][j] = point[j] / point[3];
+        }
+        const double direction[3] = {ends[1][0] - ends[0][0],
+                                     ends[1][1] - ends[0][1],
+                                     ends[1][2] - ends[0][2]};
+        uint32_t index;
+        double t;
+        if (!_bvh->pick(_spheres.data(), ends[0], direction, index, t))
+        {
+            std::cout << "No sphere picked" << std::endl;
+            return;
+        }
+        const float *sphere = &_spheres[size_t(index) * 4];
+        std::cout << "Sphere " << index << " at (" << sphere[0] << ", "
+                  << sphere[1] << ", " << sphere[2] << "), radius "
+                  << sphere[3] << std::endl;
+    }
+
+private:
+    vtkPolyData *_data;
+    vtkRenderer *_renderer;
+    unsigned long _time;
+    std::vector<float> _spheres;
+    std::unique_ptr<spheres::SphereBVH> _bvh;
+
+    SpherePicker(vtkPolyData *data, vtkRenderer *renderer)
+        : _data(data)
+        , _renderer(renderer)
+        , _time(0)
+    {
+    }
+};
+
+/* Renders a new frame whenever the trajectory stream has one ready and
+   prints the sustained frame rate about once per second. */
+class Playback : public vtkCommand
+{
+public:
+    static Playback *New(spheres::TrajectoryStream *stream,
+                         vtkRenderWindow *window)
+    {
+        return new Playback(stream, window);
+    }
+
+    virtual void Execute(vtkObject *, unsigned long, void*)
+    {
+        if (!_stream->update())
+            return;
+        _window->Render();
+        ++_frames;
+
+        const std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        const double elapsed =
+            std::chrono::duration<double>(now - _start).count();
+        if (elapsed < 1)
+            return;
+        std::cout << _frames / elapsed << " fps, frame "
+                  << _stream->currentFrame() << " of "
+                  << _stream->frameCount() << std::endl;
+        _frames = 0;
+        _start = now;
+    }
+
+private:
+    spheres::TrajectoryStream *_stream;
+    vtkRenderWindow *_window;
+    size_t _frames;
+    std::chrono::steady_clock::time_point _start;
+
+    Playback(spheres::TrajectoryStream *stream, vtkRenderWindow *window)
+        : _stream(stream)
+        , _window(window)
+        , _frames(0)
+        , _start(std::chrono::steady_clock::now())
+    {
+    }
+};
+
+/* Culls the spheres before each frame is rendered and reports how many
+   are sent to the mapper in a text actor, if given. */
+class Culling : public vtkCommand
+{
+public:
+    static Culling *New(spheres::SphereCuller *culler, vtkTextActor *text)
+    {
+        return new Culling(culler, text);
+    }
+
+    virtual void Execute(vtkObject *caller, unsigned long, void*)
+    {
+        vtkRenderer *renderer = static_cast<vtkRenderer *>(caller);
+        const int *size = renderer->GetSize();
+        _culler->update(renderer->GetActiveCamera(), size[0], size[1]);
+        if (!_text)
+            return;
+
+        std::stringstream text;
+        text << _culler->visibleCount() << " of " << _culler->sphereCount()
+             << " spheres drawn, " << _culler->frustumCount()
+             << " in frustum (" << _culler->updateTime() * 1000 << " ms)";
+        _text->SetInput(text.str().c_str());
+    }
+
+private:
+    spheres::SphereCuller *_culler;
+    vtkTextActor *_text;
+
+    Culling(spheres::SphereCuller *culler, vtkTextActor *text)
+        : _culler(culler)
+        , _text(text)
+    {
+    }
+};
+
+/* Sorts the spheres back to front before each frame is rendered if the
+   camera moved and reports the sorting time in a text actor, if given. */
+class Sorting : public vtkCommand
+{
+public:
+    static Sorting *New(spheres::SphereSorter *sorter, vtkTextActor *text)
+    {
+        return new Sorting(sorter, text);
+    }
+
+    virtual void Execute(vtkObject *caller, unsigned long, void*)
+    {
+        vtkRenderer *renderer = static_cast<vtkRenderer *>(caller);
+        if (!_sorter->update(renderer->GetActiveCamera()) || !_text)
+            return;
+
+        std::stringstream text;
+        text << _sorter->sphereCount() << " spheres sorted in "
+             << _sorter->sortTime() * 1000 << " ms";
+        _text->SetInput(text.str().c_str());
+    }
+
+private:
+    spheres::SphereSorter *_sorter;
+    vtkTextActor *_text;
+
+    Sorting(spheres::SphereSorter *sorter, vtkTextActor *text)
+        : _sorter(sorter)
+        , _text(text)
+    {
+    }
+};
+
+/* Classifies the spheres in points and impostors before each frame is
+   rendered, after culling them if a culler is given, and reports how
+   many of each are drawn in a text actor, if given. */
+class LevelOfDetail : public vtkCommand
+{
+public:
+    static LevelOfDetail *New(spheres::SphereLOD *lod,
+                              spheres::SphereCuller *culler,
+                              vtkTextActor *text)
+    {
+        return new LevelOfDetail(lod, culler, text);
+    }
+
+    virtual void Execute(vtkObject *caller, unsigned long, void*)
+    {
+        vtkRenderer *renderer = static_cast<vtkRenderer *>(caller);
+        vtkCamera *camera = renderer->GetActiveCamera();
+        const int *size = renderer->GetSize();
+        const std::vector<uint32_t> *subset = 0;
+        double time = 0;
+        if (_culler)
+        {
+            _culler->cull(camera, size[0], size[1]);
+            subset = &_culler->visible();
+            time += _culler->updateTime();
+        }
+        _lod->update(camera, size[0], size[1], subset);
+        time += _lod->updateTime();
+        if (!_text)
+            return;
+
+        std::stringstream text;
+        text << _lod->impostorCount() << " impostors and "
+             << _lod->pointCount() << " points of " << _lod->sphereCount()
+             << " spheres (" << time * 1000 << " ms)";
+        _text->SetInput(text.str().c_str());
+    }
+
+private:
+    spheres::SphereLOD *_lod;
+    spheres::SphereCuller *_culler;
+    vtkTextActor *_text;
+
+    LevelOfDetail(spheres::SphereLOD *lod, spheres::SphereCuller *culler,
+                  vtkTextActor *text)
+        : _lod(lod)
+        , _culler(culler)
+        , _text(text)
+    {
+    }
+};
+
+/* Rebuilds the shading program when the shader files change. Only the
+   changed stages are compiled again, the others are shared with the
+   current program. The new program replaces the current one in the
+   property only if it builds successfully. */
+class ShaderReloading : public vtkCommand
+{
+public:
+    static ShaderReloading *New(
+        spheres::ShaderWatcher *watcher, vtkOpenGLProperty *property,
+        vtkRenderWindow *window, const Shaders &shaders,
+        const spheres::SphereQuantization *quantization)
+    {
+        return new ShaderReloading(watcher, property, window, shaders,
+                                   quantization);
+    }
+
+    virtual void Execute(vtkObject *, unsigned long, void*)
+    {
+        const std::map<std::string, std::string> changes =
+            _watcher->changes();
+        if (changes.empty())
+            return;
+
+        Shaders shaders = _shaders;
+        for (size_t i = 0; i != SHADER_STAGES; ++i)
+        {
+            std::map<std::string, std::string>::const_iterator change =
+                changes.find(SHADER_FILES[i]);
+            if (change != changes.end())
+                shaders[i] = createShader(i, change->second, _quantization);
+        }
+
+        vtkSmartPointer<vtkShaderProgram2> program =
+            createSphereShadingProgram(shaders, _quantization);
+        _window->MakeCurrent();
+        program->SetContext(_window);
+        program->Build();
+        if (program->GetLastBuildStatus() !=
+            VTK_SHADER_PROGRAM2_LINK_SUCCEEDED)
+        {
+            std::cerr << "Shader reload failed, keeping the previous program"
+                      << std::endl;
+            for (size_t i = 0; i != SHADER_STAGES; ++i)
+                if (shaders[i] != _shaders[i] &&
+                    shaders[i]->GetLastCompileLog())
+                    std::cerr << SHADER_FILES[i] << ":\n"
+                              << shaders[i]->GetLastCompileLog() << std::endl;
+            if (program->GetLastBuildStatus() ==
+                VTK_SHADER_PROGRAM2_LINK_FAILED)
+                std::cerr << program->GetLastLinkLog() << std::endl;
+            releaseProgram(program, _shaders);
+            return;
+        }
+
+        releaseProgram(_property->GetPropProgram(), shaders);
+        _property->SetPropProgram(program);
+        _shaders = shaders;
+        std::cout << "Shaders reloaded" << std::endl;
+        _window->Render();
+    }
+
+private:
+    spheres::ShaderWatcher *_watcher;
+    vtkOpenGLProperty *_property;
+    vtkRenderWindow *_window;
+    Shaders _shaders;
+    const spheres::SphereQuantization *_quantization;
+
+    ShaderReloading(spheres::ShaderWatcher *watcher,
+                    vtkOpenGLProperty *property, vtkRenderWindow *window,
+                    const Shaders &shaders,
+                    const spheres::SphereQuantization *quantization)
+        : _watcher(watcher)
+        , _property(property)
+        , _window(window)
+        , _shaders(shaders)
+        , _quantization(quantization)
+    {
+    }
+};
 
-int main()
+void usage(const char *program)
 {
+    std::cerr << "Usage: " << program << " [--snapshot prefix] [--cull] "
+              << "[--lod] [--shaders dir] [--watch] [--quantize] "
+              << "[--opacity alpha] [--trajectory file] "
+              << "[width [height depth]]" << std::endl;
+}
 
-    vtkSmartPointer<vtkPolyDataMapper> mapper = pointGrid();
+int main(int argc, char *argv[])
+{
+    /* With --snapshot the first frame is written to prefix.png and
+       prefix_depth.vtk and the program exits, see cpu_ray_cast_spheres.
+       With --cull only the spheres that may be visible are drawn. With
+       --lod spheres smaller than half a pixel are drawn as points. With
+       --shaders the shader sources are read from a directory instead of
+       using the ones embedded in the executable. With --watch they are
+       also reloaded whenever the files change. With --trajectory the
+       spheres are played back from a trajectory file (see
+       make_sphere_trajectory) instead of using a grid. With --quantize
+       positions and radii are quantized to 16 and 8 bits. With --opacity
+       the spheres are translucent and sorted back to front. */
+    std::string snapshot;
+    std::string shaderDirectory;
+    std::string trajectory;
+    bool cull = false;
+    bool levelOfDetail = false;
+    bool watch = false;
+    bool quantize = false;
+    double opacity = 1;
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--snapshot" && i + 1 < argc)
+            snapshot = argv[++i];
+        else if (arg == "--cull")
+            cull = true;
+        else if (arg == "--lod")
+            levelOfDetail = true;
+        else if (arg == "--shaders" && i + 1 < argc)
+            shaderDirectory = argv[++i];
+        else if (arg == "--watch")
+            watch = true;
+        else if (arg == "--quantize")
+            quantize = true;
+        else if (arg == "--opacity" && i + 1 < argc)
+            opacity = atof(argv[++i]);
+        else if (arg == "--trajectory" && i + 1 < argc)
+            trajectory = argv[++i];
+        else if (arg.compare(0, 2, "--") == 0 || atoi(argv[i]) <= 0)
+        {
+            /* Unknown options, options missing their value and sizes
+               that are not positive numbers */
+            usage(argv[0]);
+            return -1;
+        }
+        else
+            sizes.push_back(atoi(argv[i]));
+    }
+    /* Grid dimensions, a single argument gives a cubic grid */
+    size_t dimensions[3] = {5, 5, 5};
+    if (sizes.size() == 1)
+        dimensions[0] = dimensions[1] = dimensions[2] = sizes[0];
+    else if (sizes.size() >= 3)
+        std::copy(sizes.begin(), sizes.begin() + 3, dimensions);
+
+    vtkSmartPointer<vtkPolyDataMapper> mapper;
+    std::unique_ptr<spheres::TrajectoryStream> stream;
+    if (trajectory.empty())
+        mapper = pointGrid(dimensions[0], dimensions[1], dimensions[2]);
+    else
+    {
+        /* Culling, LOD and quantized outputs are not updated when the
+           points move */
+        if (cull || levelOfDetail || quantize)
+        {
+            std::cerr << "--cull, --lod and --quantize can't be used with "
+                      << "--trajectory" << std::endl;
+            return -1;
+        }
+        try
+        {
+            stream.reset(new spheres::TrajectoryStream(trajectory));
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+        mapper = sphereMapper(stream->output());
+    }
+    vtkSmartPointer<vtkPolyData> data = mapper->GetInput();
+    std::unique_ptr<spheres::SphereQuantization> quantization;
+    if (quantize)
+    {
+        const size_t bytes = spheres::sphereBytes(data);
+        data = spheres::quantizeSpheres(data);
+        quantization.reset(new spheres::SphereQuantization(
+            spheres::sphereQuantization(data)));
+        mapper = sphereMapper(data);
+        std::cout << data->GetNumberOfPoints() << " spheres quantized, "
+                  << spheres::sphereBytes(data) << " bytes per sphere ("
+                  << bytes << " before quantization)" << std::endl;
+    }
+    std::unique_ptr<spheres::SphereCuller> culler;
+    std::unique_ptr<spheres::SphereLOD> lod;
+    std::unique_ptr<spheres::SphereSorter> sorter;
+    if (opacity < 1)
+    {
+        /* Occluded and point spheres would show through translucent ones
+           and trajectory frames are not sorted */
+        if (cull || levelOfDetail || stream)
+        {
+            std::cerr << "--opacity can't be used with --cull, --lod or "
+                      << "--trajectory" << std::endl;
+            return -1;
+        }
+        sorter.reset(new spheres::SphereSorter(data));
+        mapper->SetInputDataObject(sorter->output());
+    }
+    if (cull)
+        culler.reset(new spheres::SphereCuller(data));
+    if (levelOfDetail)
+    {
+        lod.reset(new spheres::SphereLOD(data));
+        mapper->SetInputDataObject(lod->impostors());
+    }
+    else if (culler)
+        mapper->SetInputDataObject(culler->output());
 
     /* Assinging the mapper to an actor */
     vtkSmartPointer<vtkActor> actor = vtkActor::New();
     actor->SetMapper(mapper);
     actor->GetProperty()->SetColor(1, 0, 0);
+    /* Quantized positions are decoded by the model matrix */
+    vtkSmartPointer<vtkMatrix4x4> dequantization;
+    if (quantization)
+    {
+        dequantization = spheres::dequantizationMatrix(*quantization);
+        actor->SetUserMatrix(dequantization);
+    }
 
     /* Adding the ray casting shader to the actor */
     vtkSmartPointer<vtkOpenGLProperty> property =
         vtkOpenGLProperty::New();
     /* Enable shading in the property, otherwise shaders are not applied */
     property->ShadingOn();
-    vtkSmartPointer<vtkShaderProgram2> program = createSphereShadingProgram();
-    property->SetPropProgram(program);
+    property->SetOpacity(opacity);
+    /* The watched files must be the ones compiled */
+    if (watch && shaderDirectory.empty())
+        shaderDirectory = common::shaderPath();
+    Shaders shaders;
+    std::unique_ptr<spheres::ShaderWatcher> watcher;
+    try
+    {
+        shaders = createSphereShaders(shaderDirectory, quantization.get());
+        if (watch)
+            watcher.reset(new spheres::ShaderWatcher(
+                shaderDirectory, std::vector<std::string>(
+                    SHADER_FILES, SHADER_FILES + SHADER_STAGES)));
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    property->SetPropProgram(
+        createSphereShadingProgram(shaders, quantization.get()));
     actor->SetProperty(property);
 
     /* Creating the renderer and the render window */
     vtkSmartPointer<vtkRenderer> renderer = vtkRenderer::New();
     renderer->AddActor(actor);
     renderer->SetBackground(0.2, 0.3, 0.4);
+    if (lod)
+    {
+        /* Small spheres are drawn unlit with their precomputed colors */
+        vtkSmartPointer<vtkPolyDataMapper> pointMapper =
+            vtkSmartPointer<vtkPolyDataMapper>::New();
+        pointMapper->SetInputDataObject(lod->points());
+        vtkSmartPointer<vtkActor> points = vtkSmartPointer<vtkActor>::New();
+        points->SetMapper(pointMapper);
+        points->GetProperty()->SetAmbient(1);
+        points->GetProperty()->SetDiffuse(0);
+        points->GetProperty()->SetSpecular(0);
+        points->SetUserMatrix(dequantization);
+        renderer->AddActor(points);
+    }
+    if (culler || lod || sorter)
+    {
+        /* The outputs have no cells until the first update, the camera is
+           reset from the bounds of their points. */
+        renderer->ResetCamera();
+        /* Snapshots are compared against the CPU ray caster, they
+           don't show the counts. */
+        vtkSmartPointer<vtkTextActor> counts;
+        if (snapshot.empty())
+        {
+            counts = vtkTextActor::New();
+            counts->SetDisplayPosition(10, 10);
+            counts->GetTextProperty()->SetColor(1, 1, 1);
+            renderer->AddActor2D(counts);
+        }
+        vtkSmartPointer<vtkCommand> update;
+        if (lod)
+            update = LevelOfDetail::New(lod.get(), culler.get(), counts);
+        else if (sorter)
+            update = Sorting::New(sorter.get(), counts);
+        else
+            update = Culling::New(culler.get(), counts);
+        renderer->AddObserver(vtkCommand::StartEvent, update);
+    }
 
     vtkSmartPointer<vtkRenderWindow> window = vtkRenderWindow::New();
     window->SetSize(800, 800);
@@ -80,120 +624,124 @@ int main()
 
     interactor->SetRenderWindow(window);
     interactor->Initialize();
+    if (!snapshot.empty())
+    {
+        window->Render();
+        spheres::writeFrame(spheres::captureFrame(window), snapshot);
+        return 0;
+    }
+
+    vtkSmartPointer<SpherePicker> picker =
+        SpherePicker::New(data, renderer);
+    interactor->AddObserver(vtkCommand::KeyPressEvent, picker);
+    if (watcher)
+    {
+        vtkSmartPointer<ShaderReloading> reloading =
+            ShaderReloading::New(watcher.get(), property, window, shaders,
+                                 quantization.get());
+        interactor->AddObserver(vtkCommand::TimerEvent, reloading);
+    }
+    if (stream)
+    {
+        vtkSmartPointer<Playback> playback =
+            Playback::New(stream.get(), window);
+        interactor->AddObserver(vtkCommand::TimerEvent, playback);
+    }
+    /* A single timer serves both observers, playback polls the stream as
+       often as possible. */
+    if (stream)
+        interactor->CreateRepeatingTimer(1);
+    else if (watcher)
+        interactor->CreateRepeatingTimer(200);
     interactor->Start();
 }
 
-vtkSmartPointer<vtkPolyDataMapper> pointGrid()
+vtkSmartPointer<vtkPolyDataMapper> pointGrid(const size_t width,
+                                              const size_t height,
+                                              const size_t depth)
 {
-    /* Creating a poly data object of 10x10x10 points */
-    vtkSmartPointer<vtkPolyData> data = vtkPolyData::New();
-    size_t width = 5;
-    size_t height = 5;
-    size_t depth = 5;
-    vtkSmartPointer<vtkPoints> vertices = vtkPoints::New();
-    for (size_t i = 0; i < width; ++i)
-        for (size_t j = 0; j < height; ++j)
-            for (size_t k = 0; k < depth; ++k)
-                vertices->InsertPoint(i * height * depth + j * depth + k,
-                                      i * 10.0, j * 10.0, k * 10.0);
-    data->SetPoints(vertices);
-
-    vtkSmartPointer<vtkCellArray> points = vtkCellArray::New();
-    for (vtkIdType i = 0; i < vtkIdType(width * height * depth); ++i)
-        points->InsertNextCell(1, &i);
-    data->SetVerts(points);
-
-    /* Adding the radii of spheres as a point dataset */
-    /* Creating the radii array */
-    vtkSmartPointer<vtkFloatArray> radii =
-        vtkSmartPointer<vtkFloatArray>::New();
-    radii->SetName("radii");
-    radii->SetNumberOfTuples(width * height * depth);
-    for (size_t i = 0; i < width; ++i)
-        for (size_t j = 0; j < height; ++j)
-            for (size_t k = 0; k < depth; ++k)
-            {
-                float a = float(i) / (width - 1) - 0.5;
-                float b = float(j) / (height - 1) - 0.5;
-                float c = float(k) / (depth - 1) - 0.5;
-                float radius = 8 - 5 * 2 * sqrt(a * a + b * b + c * c);
-                radii->SetTuple(i * height * depth + j * depth + k, &radius);
-            }
-
-    data->GetPointData()->AddArray(radii);
+    /* Creating a poly data object with a grid of points, a vertex per
+       point and the radii of the spheres as a point dataset. The arrays
+       are filled in bulk, see sphere_grid.h. */
+    return sphereMapper(spheres::sphereGrid(width, height, depth));
+}
 
+vtkSmartPointer<vtkPolyDataMapper> sphereMapper(vtkPolyData *data)
+{
     vtkSmartPointer<vtkPolyDataMapper> mapper = vtkPolyDataMapper::New();
     /* Assigning the data object directly to the poly mapper */
     mapper->SetInputDataObject(data);
-    mapper->MapDataArrayToVertexAttribute(
-        "radiusAttrib", "radii", vtkDataObject::FIELD_ASSOCIATION_POINTS, -1);
+    if (spheres::isQuantized(data))
+        mapper->MapDataArrayToVertexAttribute(
+            "radiusCode", "radiusCodes",
+            vtkDataObject::FIELD_ASSOCIATION_POINTS, -1);
+    else
+        mapper->MapDataArrayToVertexAttribute(
+            "radiusAttrib", "radii",
+            vtkDataObject::FIELD_ASSOCIATION_POINTS, -1);
 
     return mapper;
 }
 
-std::string readSource(const std::string &shaderFile);
+vtkSmartPointer<vtkShader2> createShader(
+    const size_t stage, const std::string &code,
+    const spheres::SphereQuantization *quantization)
+{
+    vtkSmartPointer<vtkShader2> shader = vtkSmartPointer<vtkShader2>::New();
+    shader->SetType(SHADER_TYPES[stage]);
+    /* The vertex shader has no #version directive, the define can go
+       first */
+    if (quantization && SHADER_TYPES[stage] == VTK_SHADER_TYPE_VERTEX)
+        shader->SetSourceCode(("#define QUANTIZED\n" + code).c_str());
+    else
+        shader->SetSourceCode(code.c_str());
+    return shader;
+}
 
-vtkSmartPointer<vtkShaderProgram2> createSphereShadingProgram()
+Shaders createSphereShaders(const std::string &shaderDirectory,
+                            const spheres::SphereQuantization *quantization)
+{
+    Shaders shaders;
+    for (size_t i = 0; i != SHADER_STAGES; ++i)
+        shaders.push_back(createShader(
+            i, spheres::shaderSource(SHADER_FILES[i], shaderDirectory),
+            quantization));
+    return shaders;
+}
+
+vtkSmartPointer<vtkShaderProgram2> createSphereShadingProgram(
+    const Shaders &shaders, const spheres::SphereQuantization *quantization)
 {
     vtkSmartPointer<vtkShaderProgram2> program =
-        vtkShaderProgram2::New();
-    std::string code;
-
-    vtkSmartPointer<vtkShader2> vertex = vtkShader2::New();
-    vertex->SetType(VTK_SHADER_TYPE_VERTEX);
-    code = readSource("sphere.vert");
-    vertex->SetSourceCode(code.c_str());
-    program->GetShaders()->AddItem(vertex);
-
-    vtkSmartPointer<vtkShader2> geometry = vtkShader2::New();
-    geometry->SetType(VTK_SHADER_TYPE_GEOMETRY);
-    code = readSource("sphere.geom");
-    geometry->SetSourceCode(code.c_str());
-    program->GetShaders()->AddItem(geometry);
-
-    vtkSmartPointer<vtkShader2> fragment = vtkShader2::New();
-    fragment->SetType(VTK_SHADER_TYPE_FRAGMENT);
-    code = readSource("sphere.frag");
-    fragment->SetSourceCode(code.c_str());
-    program->GetShaders()->AddItem(fragment);
+        vtkSmartPointer<vtkShaderProgram2>::New();
+    for (size_t i = 0; i != shaders.size(); ++i)
+        program->GetShaders()->AddItem(shaders[i]);
 
     program->SetGeometryTypeIn(VTK_GEOMETRY_SHADER_IN_TYPE_POINTS);
     program->SetGeometryTypeOut(VTK_GEOMETRY_SHADER_OUT_TYPE_TRIANGLE_STRIP);
     program->SetGeometryVerticesOut(4);
 
-    return program;
-}
-
-
-std::string readSource(const std::string &shaderFile)
-{
-    std::string shader = common::shaderPath() + "/" + shaderFile;
-
-    std::ifstream file(shader);
-    if (file.fail())
+    if (quantization)
     {
-        std::cerr << "Couldn't find shader source: " << shader;
-        return "";
+        float scale[3];
+        float offset[3];
+        std::copy(quantization->scale, quantization->scale + 3, scale);
+        std::copy(quantization->offset, quantization->offset + 3, offset);
+        vtkUniformVariables *uniforms = program->GetUniformVariables();
+        uniforms->SetUniformf("positionScale", 3, scale);
+        uniforms->SetUniformf("positionOffset", 3, offset);
+        uniforms->SetUniformfv("radiusTable", 1, spheres::RADIUS_CODES,
+                               quantization->radii);
     }
 
+    return program;
+}
 
-    std::stringstream out;
-    /* Reading until a $ is found or EOF is reached. */
-    do
-    {
-        int c = file.get();
-        if (!file.eof())
-        {
-            if (file.fail())
-            {
-                std::cerr << "Error reading shader source: "
-                          << shaderFile << std::endl;
-                break;
-            }
-            out << (char)c;
-        }
-    }
-    while (!file.eof());
-
-    return out.str();
+void releaseProgram(vtkShaderProgram2 *program, const Shaders &keep)
+{
+    /* Releasing a program releases its shaders, the ones still in use by
+       another program are removed first. */
+    for (size_t i = 0; i != keep.size(); ++i)
+        program->GetShaders()->RemoveItem(keep[i]);
+    program->ReleaseGraphicsResources();
 }
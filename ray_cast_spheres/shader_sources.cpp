@@ -0,0 +1,74 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "shader_sources.h"
+
+#include "shaders/sphere.frag.h"
+#include "shaders/sphere.geom.h"
+#include "shaders/sphere.vert.h"
+
+#include "common/paths.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace spheres
+{
+
+namespace
+{
+
+const struct
+{
+    const char *name;
+    const char *source;
+} EMBEDDED_SHADERS[] = {
+    {"sphere.vert", sphere_vert},
+    {"sphere.geom", sphere_geom},
+    {"sphere.frag", sphere_frag}
+};
+
+}
+
+std::string shaderSource(const std::string &name,
+                         const std::string &directory)
+{
+    if (directory.empty())
+    {
+        for (const auto &shader : EMBEDDED_SHADERS)
+            if (name == shader.name)
+                return shader.source;
+    }
+    return readFile((directory.empty() ? common::shaderPath() : directory) +
+                    "/" + name);
+}
+
+std::string readFile(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.seekg(0, std::ios::end))
+        throw std::runtime_error("Couldn't open file: " + filename);
+    std::string contents(size_t(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    if (!file.read(&contents[0], contents.size()))
+        throw std::runtime_error("Error reading file: " + filename);
+    return contents;
+}
+
+}
@@ -0,0 +1,47 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SHADER_SOURCES_H
+#define RAY_CAST_SPHERES_SHADER_SOURCES_H
+
+#include <string>
+
+namespace spheres
+{
+
+/**
+   Returns the source code of one of the sphere shaders (sphere.vert,
+   sphere.geom or sphere.frag).
+
+   The sphere shaders are embedded in the executable at build time (see
+   EqStringifyShaders.cmake). If a directory is given, or the shader is
+   not embedded, the source is read from that directory or from
+   common::shaderPath() instead, so shaders can be edited without
+   rebuilding.
+   Throws std::runtime_error if the file can't be read.
+ */
+std::string shaderSource(const std::string &name,
+                         const std::string &directory = "");
+
+/** Reads a whole file with a single read call */
+std::string readFile(const std::string &filename);
+
+}
+
+#endif
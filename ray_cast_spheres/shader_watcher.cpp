@@ -0,0 +1,120 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "shader_watcher.h"
+#include "shader_sources.h"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace spheres
+{
+
+namespace
+{
+
+/* Time between checks of the stop flag */
+const int POLL_TIMEOUT_MS = 200;
+
+}
+
+ShaderWatcher::ShaderWatcher(const std::string &directory,
+                             const std::vector<std::string> &files)
+    : _directory(directory)
+    , _files(files)
+    , _inotify(inotify_init1(IN_CLOEXEC))
+    , _stop(false)
+{
+    if (_inotify == -1)
+        throw std::runtime_error(std::string("inotify_init1: ") +
+                                 strerror(errno));
+    if (inotify_add_watch(_inotify, directory.c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+    {
+        const std::string error = strerror(errno);
+        close(_inotify);
+        throw std::runtime_error("Couldn't watch " + directory + ": " +
+                                 error);
+    }
+    _thread = std::thread(&ShaderWatcher::_watch, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    _stop = true;
+    _thread.join();
+    close(_inotify);
+}
+
+std::map<std::string, std::string> ShaderWatcher::changes()
+{
+    std::map<std::string, std::string> changes;
+    std::lock_guard<std::mutex> lock(_mutex);
+    changes.swap(_changes);
+    return changes;
+}
+
+void ShaderWatcher::_watch()
+{
+    /* Aligned as required to read inotify_event structs */
+    char buffer[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    pollfd descriptor = {_inotify, POLLIN, 0};
+    while (!_stop)
+    {
+        if (poll(&descriptor, 1, POLL_TIMEOUT_MS) <= 0)
+            continue;
+        const ssize_t length = read(_inotify, buffer, sizeof(buffer));
+        if (length <= 0)
+            continue;
+
+        for (char *event = buffer; event < buffer + length;)
+        {
+            const inotify_event *info =
+                reinterpret_cast<const inotify_event *>(event);
+            event += sizeof(inotify_event) + info->len;
+            if (info->len == 0)
+                continue;
+            const std::string name = info->name;
+            if (std::find(_files.begin(), _files.end(), name) == _files.end())
+                continue;
+
+            try
+            {
+                const std::string source = readFile(_directory + "/" + name);
+                std::lock_guard<std::mutex> lock(_mutex);
+                _changes[name] = source;
+            }
+            catch (const std::runtime_error &e)
+            {
+                /* The file may have been removed or replaced again */
+                std::cerr << e.what() << std::endl;
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,71 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SHADER_WATCHER_H
+#define RAY_CAST_SPHERES_SHADER_WATCHER_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace spheres
+{
+
+/**
+   Watches a set of files of a directory with inotify and reads them
+   from a background thread whenever they are rewritten.
+
+   The directory is watched instead of the files, so files replaced by
+   editors that save to a temporary file and rename it are still
+   followed. Several changes of a file between two calls to changes()
+   are coalesced into the last one.
+ */
+class ShaderWatcher
+{
+public:
+    /** Throws std::runtime_error if the directory can't be watched */
+    ShaderWatcher(const std::string &directory,
+                  const std::vector<std::string> &files);
+    ~ShaderWatcher();
+
+    /** Returns the contents of the files changed since the last call,
+        indexed by file name. */
+    std::map<std::string, std::string> changes();
+
+private:
+    std::string _directory;
+    std::vector<std::string> _files;
+    int _inotify;
+    std::atomic<bool> _stop;
+    std::mutex _mutex;
+    std::map<std::string, std::string> _changes;
+    std::thread _thread;
+
+    void _watch();
+
+    ShaderWatcher(const ShaderWatcher &);
+    void operator=(const ShaderWatcher &);
+};
+
+}
+
+#endif
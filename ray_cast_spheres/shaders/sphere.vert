@@ -18,12 +18,30 @@
 
 varying vec4 color;
 varying float radius;
+
+#ifdef QUANTIZED
+/* Positions are 16 bit codes relative to the bounding box of the spheres
+   and radii 8 bit indices in a table, see sphere_quantization.h. The model
+   matrix already decodes the positions for gl_Position. */
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+uniform float radiusTable[256];
+attribute float radiusCode;
+#else
 attribute vec4 radiusAttrib;
+#endif
 
 void propFuncVS()
 {
     gl_Position = gl_ModelViewMatrix * vec4(gl_Vertex.xyz, 1.0);
-    color = vec4(gl_Vertex.xyz / 50.0, 1.0);
+    /* The opacity of the actor is the alpha of the diffuse material */
+#ifdef QUANTIZED
+    color = vec4((gl_Vertex.xyz * positionScale + positionOffset) / 50.0,
+                 gl_FrontMaterial.diffuse.a);
+    radius = radiusTable[int(radiusCode)];
+#else
+    color = vec4(gl_Vertex.xyz / 50.0, gl_FrontMaterial.diffuse.a);
     radius = radiusAttrib;
+#endif
 }
 
@@ -0,0 +1,578 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_bvh.h"
+#include "sphere_quantization.h"
+
+#include "common/parallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace spheres
+{
+
+namespace
+{
+
+/* Number of bins in which the centroids are classified to evaluate the
+   surface area heuristic */
+const int BINS = 16;
+/* Nodes with more spheres than this are always split */
+const uint32_t MAX_LEAF_SIZE = 16;
+/* Below this depth nodes are split at the median, which bounds the depth
+   of the tree to MEDIAN_DEPTH + 32. */
+const int MEDIAN_DEPTH = SphereBVH::MAX_DEPTH - 32;
+/* Nodes with more spheres than this build their children in parallel,
+   down to a depth with a few subtrees per thread */
+const uint32_t PARALLEL_SUBTREE = 1 << 14;
+const size_t SUBTREES_PER_THREAD = 4;
+/* Nodes with more spheres than this bin them in parallel, as long as
+   there are less subtrees being built than threads */
+const uint32_t PARALLEL_BINNING = 1 << 16;
+const size_t BINNING_CHUNK = 1 << 14;
+/* Subtrees per thread handed out by cull */
+const size_t CULL_TASKS_PER_THREAD = 8;
+
+struct Box
+{
+    float min[3];
+    float max[3];
+
+    Box()
+    {
+        for (int i = 0; i != 3; ++i)
+        {
+            min[i] = std::numeric_limits<float>::max();
+            max[i] = -std::numeric_limits<float>::max();
+        }
+    }
+
+    void expand(const float *sphere)
+    {
+        for (int i = 0; i != 3; ++i)
+        {
+            min[i] = std::min(min[i], sphere[i] - sphere[3]);
+            max[i] = std::max(max[i], sphere[i] + sphere[3]);
+        }
+    }
+
+    void expandPoint(const float *point)
+    {
+        for (int i = 0; i != 3; ++i)
+        {
+            min[i] = std::min(min[i], point[i]);
+            max[i] = std::max(max[i], point[i]);
+        }
+    }
+
+    void expand(const Box &box)
+    {
+        for (int i = 0; i != 3; ++i)
+        {
+            min[i] = std::min(min[i], box.min[i]);
+            max[i] = std::max(max[i], box.max[i]);
+        }
+    }
+
+    float area() const
+    {
+        const float x = max[0] - min[0];
+        const float y = max[1] - min[1];
+        const float z = max[2] - min[2];
+        if (x < 0)
+            return 0;
+        return 2 * (x * y + y * z + z * x);
+    }
+};
+
+struct Bin
+{
+    Box box;
+    uint32_t count;
+
+    Bin() : count(0) {}
+};
+
+/* Runs f(first, last, partial) over chunks of [0, count), in parallel if
+   requested, and merges the partial results with merge(result, partial) */
+template<typename T, typename F, typename M>
+void reduce(const size_t count, const bool parallel, T &result, const F &f,
+            const M &merge)
+{
+    if (!parallel)
+    {
+        f(0, count, result);
+        return;
+    }
+    std::mutex mutex;
+    common::parallelForChunks(0, count, BINNING_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        T partial;
+        f(first, last, partial);
+        std::lock_guard<std::mutex> lock(mutex);
+        merge(result, partial);
+    });
+}
+
+struct Bounds
+{
+    Box spheres;
+    Box centroids;
+};
+
+}
+
+std::vector<float> packSpheres(vtkPolyData *data)
+{
+    if (isQuantized(data))
+        return dequantizeSpheres(data);
+
+    vtkPoints *points = data->GetPoints();
+    vtkDataArray *radii = data->GetPointData()->GetArray("radii");
+    if (!points || !radii)
+        throw std::runtime_error("Sphere data needs points and radii");
+
+    const size_t count = points->GetNumberOfPoints();
+    std::vector<float> spheres(count * 4);
+    common::parallelFor(0, count, [&](const size_t i)
+    {
+        double point[3];
+        points->GetPoint(i, point);
+        spheres[i * 4] = point[0];
+        spheres[i * 4 + 1] = point[1];
+        spheres[i * 4 + 2] = point[2];
+        spheres[i * 4 + 3] = radii->GetComponent(i, 0);
+    });
+    return spheres;
+}
+
+SphereBVH::SphereBVH(const float *spheres, const size_t count,
+                     const size_t leafSize)
+    : _leafSize(std::max(size_t(1), std::min(leafSize,
+                                             size_t(MAX_LEAF_SIZE))))
+{
+    for (size_t i = 0; i != count; ++i)
+        if (spheres[i * 4 + 3] >= 0)
+            _indices.push_back(i);
+    if (_indices.empty())
+        return;
+
+    /* A binary tree with n leaves has 2n - 1 nodes */
+    _nodes.resize(_indices.size() * 2);
+    std::atomic<uint32_t> nodeCount(1);
+    _build(spheres, 0, 0, _indices.size(), 0, nodeCount);
+    _nodes.resize(nodeCount);
+}
+
+void SphereBVH::refit(const float *spheres)
+{
+    common::parallelFor(0, _nodes.size(), [&](const size_t i)
+    {
+        Node &node = _nodes[i];
+        if (!node.isLeaf())
+            return;
+        Box box;
+        for (uint32_t j = node.first; j != node.first + node.count; ++j)
+        {
+            const float *sphere = spheres + size_t(_indices[j]) * 4;
+            if (sphere[3] >= 0)
+                box.expand(sphere);
+        }
+        std::copy(box.min, box.min + 3, node.min);
+        std::copy(box.max, box.max + 3, node.max);
+    });
+
+    /* Children are stored after their parents */
+    for (size_t i = _nodes.size(); i-- != 0;)
+    {
+        Node &node = _nodes[i];
+        if (node.isLeaf())
+            continue;
+        const Node &left = _nodes[node.first];
+        const Node &right = _nodes[node.first + 1];
+        for (int j = 0; j != 3; ++j)
+        {
+            node.min[j] = std::min(left.min[j], right.min[j]);
+            node.max[j] = std::max(left.max[j], right.max[j]);
+        }
+    }
+}
+
+void SphereBVH::cull(const float *spheres, const double planes[24],
+                     std::vector<uint32_t> &visible) const
+{
+    if (_nodes.empty())
+        return;
+
+    /* Expanding the tree breadth first to have enough subtrees to
+       balance the work among threads. */
+    std::vector<uint32_t> subtrees(1, 0);
+    const size_t tasks = common::threadCount() * CULL_TASKS_PER_THREAD;
+    for (size_t i = 0; i != subtrees.size() && subtrees.size() < tasks;)
+    {
+        const Node &node = _nodes[subtrees[i]];
+        if (node.isLeaf())
+        {
+            ++i;
+            continue;
+        }
+        subtrees[i] = node.first;
+        subtrees.insert(subtrees.begin() + i + 1, node.first + 1);
+    }
+
+    std::vector<std::vector<uint32_t>> results(subtrees.size());
+    common::parallelFor(0, subtrees.size(), [&](const size_t i)
+    {
+        _cull(spheres, planes, subtrees[i], results[i]);
+    });
+    for (size_t i = 0; i != results.size(); ++i)
+        visible.insert(visible.end(), results[i].begin(), results[i].end());
+}
+
+bool SphereBVH::pick(const float *spheres, const double origin[3],
+                     const double direction[3], uint32_t &sphere,
+                     double &t) const
+{
+    if (_nodes.empty())
+        return false;
+
+    double inverse[3];
+    for (int i = 0; i != 3; ++i)
+        inverse[i] = direction[i] == 0 ?
+            std::numeric_limits<double>::max() : 1 / direction[i];
+    const double a = direction[0] * direction[0] +
+                     direction[1] * direction[1] +
+                     direction[2] * direction[2];
+
+    bool hit = false;
+    t = std::numeric_limits<double>::max();
+    uint32_t stack[MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+    while (top != 0)
+    {
+        const Node &node = _nodes[stack[--top]];
+        double near = 0;
+        double far = t;
+        for (int i = 0; i != 3; ++i)
+        {
+            const double t0 = (node.min[i] - origin[i]) * inverse[i];
+            const double t1 = (node.max[i] - origin[i]) * inverse[i];
+            near = std::max(near, std::min(t0, t1));
+            far = std::min(far, std::max(t0, t1));
+        }
+        if (near > far)
+            continue;
+
+        if (!node.isLeaf())
+        {
+            const bool reverse = direction[node.axis] < 0;
+            stack[top++] = node.first + (reverse ? 0 : 1);
+            stack[top++] = node.first + (reverse ? 1 : 0);
+            continue;
+        }
+        for (uint32_t i = node.first; i != node.first + node.count; ++i)
+        {
+            const float *s = spheres + size_t(_indices[i]) * 4;
+            if (s[3] < 0)
+                continue;
+            const double oc[3] = {origin[0] - s[0], origin[1] - s[1],
+                                  origin[2] - s[2]};
+            const double b = (oc[0] * direction[0] + oc[1] * direction[1] +
+                              oc[2] * direction[2]);
+            const double c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] -
+                             double(s[3]) * s[3];
+            const double discriminant = b * b - a * c;
+            if (discriminant < 0)
+                continue;
+            const double root = std::sqrt(discriminant);
+            double hitT = (-b - root) / a;
+            /* The origin is inside the sphere */
+            if (hitT < 0)
+                hitT = (-b + root) / a;
+            if (hitT >= 0 && hitT < t)
+            {
+                t = hitT;
+                sphere = _indices[i];
+                hit = true;
+            }
+        }
+    }
+    return hit;
+}
+
+void SphereBVH::_build(const float *spheres, const uint32_t index,
+                       const uint32_t first, const uint32_t count,
+                       const int depth, std::atomic<uint32_t> &nodeCount)
+{
+    const bool parallel = count >= PARALLEL_BINNING &&
+        (size_t(1) << std::min(depth, 31)) < common::threadCount();
+    const uint32_t *indices = &_indices[first];
+
+    Bounds bounds;
+    reduce(count, parallel, bounds,
+           [&](const size_t begin, const size_t end, Bounds &partial)
+           {
+               for (size_t i = begin; i != end; ++i)
+               {
+                   const float *sphere = spheres + size_t(indices[i]) * 4;
+                   partial.spheres.expand(sphere);
+                   partial.centroids.expandPoint(sphere);
+               }
+           },
+           [](Bounds &result, const Bounds &partial)
+           {
+               result.spheres.expand(partial.spheres);
+               result.centroids.expand(partial.centroids);
+           });
+    const Box &centroids = bounds.centroids;
+
+    Node &node = _nodes[index];
+    std::copy(bounds.spheres.min, bounds.spheres.min + 3, node.min);
+    std::copy(bounds.spheres.max, bounds.spheres.max + 3, node.max);
+    node.first = first;
+    node.count = count;
+    node.axis = 0;
+    if (count <= _leafSize)
+        return;
+
+    int axis = 0;
+    for (int i = 1; i != 3; ++i)
+        if (centroids.max[i] - centroids.min[i] >
+            centroids.max[axis] - centroids.min[axis])
+            axis = i;
+    const float extent = centroids.max[axis] - centroids.min[axis];
+
+    uint32_t middle = first + count / 2;
+    if (extent > 0 && depth < MEDIAN_DEPTH)
+    {
+        struct Bins
+        {
+            Bin bins[BINS];
+        };
+        Bins binning;
+        const float scale = BINS / extent;
+        const float offset = centroids.min[axis];
+        auto binOf = [&](const uint32_t sphere)
+        {
+            const int bin =
+                int((spheres[size_t(sphere) * 4 + axis] - offset) * scale);
+            return std::min(BINS - 1, bin);
+        };
+        reduce(count, parallel, binning,
+               [&](const size_t begin, const size_t end, Bins &partial)
+               {
+                   for (size_t i = begin; i != end; ++i)
+                   {
+                       Bin &bin = partial.bins[binOf(indices[i])];
+                       bin.box.expand(spheres + size_t(indices[i]) * 4);
+                       ++bin.count;
+                   }
+               },
+               [](Bins &result, const Bins &partial)
+               {
+                   for (int i = 0; i != BINS; ++i)
+                   {
+                       result.bins[i].box.expand(partial.bins[i].box);
+                       result.bins[i].count += partial.bins[i].count;
+                   }
+               });
+        const Bin *bins = binning.bins;
+
+        /* Sweeping the bins from the right to have the area and count
+           of the right side of each split plane */
+        float rightAreas[BINS - 1];
+        uint32_t rightCounts[BINS - 1];
+        Box right;
+        uint32_t rightCount = 0;
+        for (int i = BINS - 1; i != 0; --i)
+        {
+            right.expand(bins[i].box);
+            rightCount += bins[i].count;
+            rightAreas[i - 1] = right.area();
+            rightCounts[i - 1] = rightCount;
+        }
+
+        Box left;
+        uint32_t leftCount = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        int bestSplit = -1;
+        for (int i = 0; i != BINS - 1; ++i)
+        {
+            left.expand(bins[i].box);
+            leftCount += bins[i].count;
+            if (leftCount == 0 || rightCounts[i] == 0)
+                continue;
+            const float cost =
+                left.area() * leftCount + rightAreas[i] * rightCounts[i];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+
+        /* Splitting only pays off if it's cheaper than intersecting all
+           the spheres of the node, traversal counted as one intersection */
+        const float area = bounds.spheres.area();
+        const float leafCost = area * count;
+        if (count <= MAX_LEAF_SIZE &&
+            (bestSplit == -1 || leafCost <= bestCost + area))
+            return;
+
+        if (bestSplit != -1)
+            middle = std::partition(
+                _indices.begin() + first, _indices.begin() + first + count,
+                [&](const uint32_t sphere)
+                {
+                    return binOf(sphere) <= bestSplit;
+                }) - _indices.begin();
+    }
+    else if (count <= MAX_LEAF_SIZE)
+    {
+        return;
+    }
+    else
+    {
+        /* Forcing a median split */
+        middle = first;
+    }
+
+    /* Splitting at the median if the heuristic failed to separate the
+       spheres (e.g. all the centroids are in the same bin). */
+    if (middle == first || middle == first + count)
+    {
+        middle = first + count / 2;
+        std::nth_element(
+            _indices.begin() + first, _indices.begin() + middle,
+            _indices.begin() + first + count,
+            [&](const uint32_t a, const uint32_t b)
+            {
+                return spheres[size_t(a) * 4 + axis] <
+                       spheres[size_t(b) * 4 + axis];
+            });
+    }
+
+    const uint32_t children = nodeCount.fetch_add(2);
+    node.first = children;
+    node.count = 0;
+    node.axis = axis;
+    if (count >= PARALLEL_SUBTREE &&
+        (size_t(1) << std::min(depth, 31)) <
+            common::threadCount() * SUBTREES_PER_THREAD)
+    {
+        std::future<void> left = std::async(std::launch::async, [&]()
+        {
+            _build(spheres, children, first, middle - first, depth + 1,
+                   nodeCount);
+        });
+        _build(spheres, children + 1, middle, first + count - middle,
+               depth + 1, nodeCount);
+        left.get();
+    }
+    else
+    {
+        _build(spheres, children, first, middle - first, depth + 1,
+               nodeCount);
+        _build(spheres, children + 1, middle, first + count - middle,
+               depth + 1, nodeCount);
+    }
+}
+
+void SphereBVH::_cull(const float *spheres, const double planes[24],
+                      const uint32_t index,
+                      std::vector<uint32_t> &visible) const
+{
+    const Node &node = _nodes[index];
+    bool inside = true;
+    for (int i = 0; i != 6; ++i)
+    {
+        const double *plane = planes + i * 4;
+        /* Distances of the box corners farthest and closest along the
+           plane normal */
+        double farthest = plane[3];
+        double closest = plane[3];
+        for (int j = 0; j != 3; ++j)
+        {
+            const double low = plane[j] * node.min[j];
+            const double high = plane[j] * node.max[j];
+            farthest += std::max(low, high);
+            closest += std::min(low, high);
+        }
+        if (farthest < 0)
+            return;
+        inside &= closest >= 0;
+    }
+    if (inside)
+    {
+        _append(spheres, index, visible);
+        return;
+    }
+
+    if (!node.isLeaf())
+    {
+        _cull(spheres, planes, node.first, visible);
+        _cull(spheres, planes, node.first + 1, visible);
+        return;
+    }
+    for (uint32_t i = node.first; i != node.first + node.count; ++i)
+    {
+        const float *sphere = spheres + size_t(_indices[i]) * 4;
+        if (sphere[3] < 0)
+            continue;
+        bool outside = false;
+        for (int j = 0; j != 6 && !outside; ++j)
+        {
+            const double *plane = planes + j * 4;
+            outside = plane[0] * sphere[0] + plane[1] * sphere[1] +
+                      plane[2] * sphere[2] + plane[3] < -sphere[3];
+        }
+        if (!outside)
+            visible.push_back(_indices[i]);
+    }
+}
+
+void SphereBVH::_append(const float *spheres, const uint32_t index,
+                        std::vector<uint32_t> &visible) const
+{
+    const Node &node = _nodes[index];
+    if (!node.isLeaf())
+    {
+        _append(spheres, node.first, visible);
+        _append(spheres, node.first + 1, visible);
+        return;
+    }
+    /* Spheres made invalid by a refit are still in the leaves */
+    for (uint32_t i = node.first; i != node.first + node.count; ++i)
+        if (spheres[size_t(_indices[i]) * 4 + 3] >= 0)
+            visible.push_back(_indices[i]);
+}
+
+}
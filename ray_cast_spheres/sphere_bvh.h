@@ -0,0 +1,127 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SPHERE_BVH_H
+#define RAY_CAST_SPHERES_SPHERE_BVH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class vtkPolyData;
+
+namespace spheres
+{
+
+/**
+   Packs the points and the "radii" point array of a poly data in
+   (x, y, z, radius) floats, the sphere layout used by SphereBVH.
+   Datasets created by quantizeSpheres() are decoded.
+   Throws std::runtime_error if any of them is missing.
+ */
+std::vector<float> packSpheres(vtkPolyData *data);
+
+/**
+   Bounding volume hierarchy of axis aligned boxes over a set of spheres.
+
+   Spheres are given as packed (x, y, z, radius) floats. The tree is built
+   top-down with the surface area heuristic evaluated over a fixed number
+   of bins per node. Large subtrees are built in parallel and the binning
+   of the nodes near the root is split across threads. Nodes are stored in
+   a flat array, the children of an inner node are consecutive and always
+   stored after their parent.
+
+   The tree doesn't keep a reference to the sphere data, queries take the
+   same array used to build it (or refit it).
+ */
+class SphereBVH
+{
+public:
+    /** Upper bound of the depth of the tree, for traversal stacks */
+    static const int MAX_DEPTH = 64;
+
+    struct Node
+    {
+        float min[3];
+        /* Left child for inner nodes, first slot in indices() for leaves */
+        uint32_t first;
+        float max[3];
+        /* Number of spheres of a leaf, 0 for inner nodes */
+        uint16_t count;
+        /* Split axis of inner nodes */
+        uint16_t axis;
+
+        bool isLeaf() const { return count != 0; }
+    };
+
+    /**
+       @param spheres Packed (x, y, z, radius) values of count spheres.
+              Spheres with negative radius are not inserted in the tree.
+       @param leafSize Target number of spheres per leaf.
+     */
+    SphereBVH(const float *spheres, size_t count, size_t leafSize = 4);
+
+    const std::vector<Node> &nodes() const { return _nodes; }
+    /** Sphere indices referenced by the leaves */
+    const std::vector<uint32_t> &indices() const { return _indices; }
+
+    /**
+       Updates the node bounds after the sphere positions or radii change,
+       keeping the tree topology. Much cheaper than a rebuild, but the tree
+       quality degrades if spheres move far. Spheres whose radius becomes
+       negative stay in the tree and are skipped by the queries.
+     */
+    void refit(const float *spheres);
+
+    /**
+       Appends to visible the spheres that intersect or are inside a
+       frustum. Subtrees fully inside the frustum are accepted without
+       testing their spheres and the query is split across threads by
+       subtrees.
+       @param planes 6 planes (a, b, c, d) with normals pointing inwards,
+              as returned by vtkCamera::GetFrustumPlanes.
+     */
+    void cull(const float *spheres, const double planes[24],
+              std::vector<uint32_t> &visible) const;
+
+    /**
+       Finds the first sphere hit by a ray.
+       @param direction Need not be normalized, t is given in its units.
+       @return false if no sphere is hit.
+     */
+    bool pick(const float *spheres, const double origin[3],
+              const double direction[3], uint32_t &sphere, double &t) const;
+
+private:
+    std::vector<Node> _nodes;
+    std::vector<uint32_t> _indices;
+    size_t _leafSize;
+
+    void _build(const float *spheres, uint32_t node, uint32_t first,
+                uint32_t count, int depth, std::atomic<uint32_t> &nodeCount);
+    void _cull(const float *spheres, const double planes[24], uint32_t node,
+               std::vector<uint32_t> &visible) const;
+    void _append(const float *spheres, uint32_t node,
+                 std::vector<uint32_t> &visible) const;
+};
+
+}
+
+#endif
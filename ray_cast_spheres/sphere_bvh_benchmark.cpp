@@ -0,0 +1,136 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/* Build, refit, frustum culling and picking times of the sphere BVH on
+   sphere grids of 10^3 to 10^7 spheres. */
+
+#include "sphere_bvh.h"
+#include "sphere_grid.h"
+
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCamera.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Number of rays cast for each grid */
+const int PICKS = 10000;
+
+int main(int argc, char *argv[])
+{
+    int maxExponent = 7;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxExponent = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max exponent]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << common::threadCount() << " threads" << std::endl;
+    std::cout << std::setw(12) << "spheres" << std::setw(12) << "build s"
+              << std::setw(12) << "refit s" << std::setw(12) << "cull s"
+              << std::setw(12) << "visible" << std::setw(12) << "pick us"
+              << std::endl;
+    for (int exponent = 3; exponent <= maxExponent; ++exponent)
+    {
+        size_t dimensions[3] = {1, 1, 1};
+        for (int i = 0; i != exponent; ++i)
+            dimensions[i % 3] *= 10;
+        std::vector<float> spheres = spheres::packSpheres(
+            spheres::sphereGrid(dimensions[0], dimensions[1],
+                                dimensions[2]));
+        const size_t count = spheres.size() / 4;
+
+        std::unique_ptr<spheres::SphereBVH> bvh;
+        const double build = common::measure([&]()
+        {
+            bvh.reset(new spheres::SphereBVH(spheres.data(), count));
+        });
+
+        /* Shifting every sphere by a fraction of the grid spacing */
+        for (size_t i = 0; i != count; ++i)
+            spheres[i * 4] += spheres::GRID_SPACING * 0.25;
+        const double refit =
+            common::measure([&]() { bvh->refit(spheres.data()); });
+
+        /* Camera in front of the grid looking at its center from close
+           enough to see about a fourth of it. */
+        const double center[3] = {
+            (dimensions[0] - 1) * spheres::GRID_SPACING * 0.5,
+            (dimensions[1] - 1) * spheres::GRID_SPACING * 0.5,
+            (dimensions[2] - 1) * spheres::GRID_SPACING * 0.5};
+        vtkSmartPointer<vtkCamera> camera = vtkSmartPointer<vtkCamera>::New();
+        camera->SetFocalPoint(center[0], center[1], center[2]);
+        camera->SetPosition(center[0], center[1],
+                            center[2] * 2 + spheres::GRID_SPACING);
+        camera->SetViewAngle(15);
+        camera->SetClippingRange(0.1, center[2] * 4 +
+                                      spheres::GRID_SPACING * 2);
+        double planes[24];
+        camera->GetFrustumPlanes(1, planes);
+        std::vector<uint32_t> visible;
+        const double cull = common::measure([&]()
+        {
+            bvh->cull(spheres.data(), planes, visible);
+        });
+
+        /* Rays from the camera towards points spread over the front face
+           of the grid */
+        const double *origin = camera->GetPosition();
+        size_t hits = 0;
+        const double pick = common::measure([&]()
+        {
+            for (int i = 0; i != PICKS; ++i)
+            {
+                const double u = (i % 100) / 99.0;
+                const double v = (i / 100) / 99.0;
+                const double direction[3] = {
+                    u * center[0] * 2 - origin[0],
+                    v * center[1] * 2 - origin[1],
+                    center[2] * 2 - origin[2]};
+                uint32_t sphere;
+                double t;
+                hits += bvh->pick(spheres.data(), origin, direction,
+                                  sphere, t);
+            }
+        });
+
+        std::cout << std::setw(12) << count << std::setw(12) << build
+                  << std::setw(12) << refit << std::setw(12) << cull
+                  << std::setw(12) << visible.size() << std::setw(12)
+                  << pick / PICKS * 1e6 << std::endl;
+        if (hits == 0)
+            std::cerr << "Warning: no sphere was picked" << std::endl;
+    }
+}
@@ -0,0 +1,284 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_culler.h"
+
+#include "common/cells.h"
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace spheres
+{
+
+namespace
+{
+
+const float INFINITE = std::numeric_limits<float>::max();
+
+/* Slopes x / z of the two planes through the eye containing the y axis
+   and tangent to a sphere centered at (x, z) with radius r < z. */
+inline void tangentSlopes(const double x, const double z, const double r,
+                          double &low, double &high)
+{
+    const double root = r * std::sqrt(x * x + z * z - r * r);
+    const double denominator = z * z - r * r;
+    low = (x * z - root) / denominator;
+    high = (x * z + root) / denominator;
+}
+
+}
+
+SphereCuller::SphereCuller(vtkPolyData *data)
+    : _output(vtkSmartPointer<vtkPolyData>::New())
+    , _cells(vtkSmartPointer<vtkCellArray>::New())
+    , _spheres(packSpheres(data))
+    , _bvh(_spheres.data(), _spheres.size() / 4)
+    , _occlusion(true)
+    , _frustumCount(0)
+    , _updateTime(0)
+{
+    _output->SetPoints(data->GetPoints());
+    _output->GetPointData()->ShallowCopy(data->GetPointData());
+    _output->SetVerts(_cells);
+}
+
+void SphereCuller::update(vtkCamera *camera, const int width,
+                          const int height)
+{
+    _updateTime = common::measure([&]()
+    {
+        _cull(camera, width, height);
+        if (_visible != _written)
+            _writeCells();
+    });
+}
+
+void SphereCuller::cull(vtkCamera *camera, const int width,
+                        const int height)
+{
+    _updateTime = common::measure([&]() { _cull(camera, width, height); });
+}
+
+void SphereCuller::_cull(vtkCamera *camera, const int width,
+                         const int height)
+{
+    double planes[24];
+    camera->GetFrustumPlanes(double(width) / height, planes);
+    _visible.clear();
+    _bvh.cull(_spheres.data(), planes, _visible);
+    _frustumCount = _visible.size();
+
+    if (_occlusion && !camera->GetParallelProjection())
+    {
+        _project(camera, width, height);
+        _buildPyramid(width, height);
+        _cullOccluded();
+    }
+}
+
+void SphereCuller::_project(vtkCamera *camera, const int width,
+                            const int height)
+{
+    vtkMatrix4x4 *view = camera->GetViewTransformMatrix();
+    vtkMatrix4x4 *projection =
+        camera->GetProjectionTransformMatrix(double(width) / height, -1, 1);
+    double m[3][4];
+    for (int i = 0; i != 3; ++i)
+        for (int j = 0; j != 4; ++j)
+            m[i][j] = view->GetElement(i, j);
+    /* Pixels per unit of x / z and y / z and offsets of the window center */
+    const double scale[2] = {projection->GetElement(0, 0) * width * 0.5,
+                             projection->GetElement(1, 1) * height * 0.5};
+    const double offset[2] = {
+        (1 - projection->GetElement(0, 2)) * width * 0.5,
+        (1 - projection->GetElement(1, 2)) * height * 0.5};
+    double range[2];
+    camera->GetClippingRange(range);
+
+    _projections.resize(_visible.size());
+    common::parallelFor(0, _visible.size(), [&](const size_t i)
+    {
+        const float *sphere = &_spheres[size_t(_visible[i]) * 4];
+        const double radius = sphere[3];
+        double center[3];
+        for (int j = 0; j != 3; ++j)
+            center[j] = m[j][0] * sphere[0] + m[j][1] * sphere[1] +
+                        m[j][2] * sphere[2] + m[j][3];
+        /* The camera looks down the negative z axis */
+        const double depth = -center[2];
+
+        Projection &p = _projections[i];
+        p.depth = depth;
+        p.front = depth - radius;
+        p.halfSide = 0;
+        if (p.front <= range[0])
+        {
+            /* Crossing the near plane, the sphere covers the whole screen
+               and can't be occluded. */
+            p.min[0] = p.min[1] = -INFINITE;
+            p.max[0] = p.max[1] = INFINITE;
+            p.front = -INFINITE;
+            return;
+        }
+        for (int j = 0; j != 2; ++j)
+        {
+            double low, high;
+            tangentSlopes(center[j], depth, radius, low, high);
+            p.min[j] = low * scale[j] + offset[j];
+            p.max[j] = high * scale[j] + offset[j];
+            p.center[j] = center[j] / depth * scale[j] + offset[j];
+        }
+        /* The disk through the center parallel to the screen projects to
+           a circle. Spheres beyond the far plane may be clipped at the
+           pixels of the circle and don't occlude. */
+        if (depth < range[1])
+            p.halfSide = radius / depth * scale[1] * M_SQRT1_2;
+    });
+}
+
+void SphereCuller::_buildPyramid(const int width, const int height)
+{
+    _widths.assign(1, (width + OCCLUSION_TILE - 1) / OCCLUSION_TILE);
+    _heights.assign(1, (height + OCCLUSION_TILE - 1) / OCCLUSION_TILE);
+    while (_widths.back() > 1 || _heights.back() > 1)
+    {
+        _widths.push_back((_widths.back() + 1) / 2);
+        _heights.push_back((_heights.back() + 1) / 2);
+    }
+    _pyramid.resize(_widths.size());
+
+    /* Occluders are rasterized serially, most spheres don't cover any
+       tile and are skipped right away. */
+    std::vector<float> &base = _pyramid[0];
+    base.assign(size_t(_widths[0]) * _heights[0], INFINITE);
+    for (size_t i = 0; i != _projections.size(); ++i)
+    {
+        const Projection &p = _projections[i];
+        if (p.halfSide * 2 < OCCLUSION_TILE)
+            continue;
+        /* Tiles completely inside the square */
+        int first[2];
+        int last[2];
+        const int sizes[2] = {_widths[0], _heights[0]};
+        for (int j = 0; j != 2; ++j)
+        {
+            first[j] = std::max(0, int(std::ceil(
+                (p.center[j] - p.halfSide) / OCCLUSION_TILE)));
+            last[j] = std::min(sizes[j], int(std::floor(
+                (p.center[j] + p.halfSide) / OCCLUSION_TILE)));
+        }
+        for (int y = first[1]; y < last[1]; ++y)
+        {
+            float *row = &base[size_t(y) * _widths[0]];
+            for (int x = first[0]; x < last[0]; ++x)
+                row[x] = std::min(row[x], p.depth);
+        }
+    }
+
+    for (size_t level = 1; level != _pyramid.size(); ++level)
+    {
+        const std::vector<float> &fine = _pyramid[level - 1];
+        const int fineWidth = _widths[level - 1];
+        const int fineHeight = _heights[level - 1];
+        std::vector<float> &coarse = _pyramid[level];
+        coarse.resize(size_t(_widths[level]) * _heights[level]);
+        for (int y = 0; y != _heights[level]; ++y)
+        {
+            const int y0 = y * 2;
+            const int y1 = std::min(y0 + 1, fineHeight - 1);
+            for (int x = 0; x != _widths[level]; ++x)
+            {
+                const int x0 = x * 2;
+                const int x1 = std::min(x0 + 1, fineWidth - 1);
+                coarse[size_t(y) * _widths[level] + x] = std::max(
+                    std::max(fine[size_t(y0) * fineWidth + x0],
+                             fine[size_t(y0) * fineWidth + x1]),
+                    std::max(fine[size_t(y1) * fineWidth + x0],
+                             fine[size_t(y1) * fineWidth + x1]));
+            }
+        }
+    }
+}
+
+void SphereCuller::_cullOccluded()
+{
+    std::vector<char> occluded(_visible.size());
+    common::parallelFor(0, _visible.size(), [&](const size_t i)
+    {
+        occluded[i] = _occluded(_projections[i]);
+    });
+    size_t count = 0;
+    for (size_t i = 0; i != _visible.size(); ++i)
+        if (!occluded[i])
+            _visible[count++] = _visible[i];
+    _visible.resize(count);
+}
+
+bool SphereCuller::_occluded(const Projection &projection) const
+{
+    if (projection.front == -INFINITE)
+        return false;
+
+    /* Range of tiles of the finest level overlapped by the sphere */
+    int first[2];
+    int last[2];
+    const int sizes[2] = {_widths[0], _heights[0]};
+    for (int i = 0; i != 2; ++i)
+    {
+        const float low = std::floor(projection.min[i] / OCCLUSION_TILE);
+        const float high = std::floor(projection.max[i] / OCCLUSION_TILE);
+        if (high < 0 || low >= sizes[i])
+            return false;
+        first[i] = std::max(0.f, low);
+        last[i] = std::min(sizes[i] - 1.f, high);
+    }
+
+    size_t level = 0;
+    while (level + 1 != _pyramid.size() &&
+           ((last[0] >> level) - (first[0] >> level) > 1 ||
+            (last[1] >> level) - (first[1] >> level) > 1))
+        ++level;
+
+    const std::vector<float> &depths = _pyramid[level];
+    float farthest = 0;
+    for (int y = first[1] >> level; y <= last[1] >> level; ++y)
+        for (int x = first[0] >> level; x <= last[0] >> level; ++x)
+            farthest = std::max(farthest,
+                                depths[size_t(y) * _widths[level] + x]);
+    return projection.front > farthest;
+}
+
+void SphereCuller::_writeCells()
+{
+    _written = _visible;
+    common::writeVertexCells(_output, _cells, _visible.data(),
+                             _visible.size());
+}
+
+}
@@ -0,0 +1,142 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SPHERE_CULLER_H
+#define RAY_CAST_SPHERES_SPHERE_CULLER_H
+
+#include "sphere_bvh.h"
+
+#include <vtkSmartPointer.h>
+
+#include <cstdint>
+#include <vector>
+
+class vtkCamera;
+class vtkCellArray;
+class vtkPolyData;
+
+namespace spheres
+{
+
+/**
+   Per frame visibility culling of a sphere dataset, to be run before the
+   impostors are emitted by the geometry shader.
+
+   The output poly data shares the points and the point arrays of the
+   input, but its vertex cells only reference the spheres that may be
+   visible from the camera given to the last update(). Culling runs in two
+   stages:
+   - Frustum culling of the spheres with a SphereBVH.
+   - Occlusion culling against a coarse depth pyramid. Every sphere in
+     the frustum rasterizes the square inscribed in the projection of its
+     central disk (which is always covered by the sphere) into a buffer of
+     OCCLUSION_TILE pixel tiles, keeping in each tile the depth of the
+     farthest sphere that covers it completely. The levels of the pyramid
+     keep the maximum of 2x2 tiles of the previous level. A sphere is
+     occluded if its front is behind all the tiles its screen bounds
+     overlap, which is checked with at most 4 texels of the level at which
+     the bounds span 2x2 texels.
+   The test is conservative, spheres that are partially visible are never
+   culled. Occlusion culling only applies to perspective projections.
+
+   The spheres are read when the culler is created, positions and radii
+   are not expected to change afterwards.
+ */
+class SphereCuller
+{
+public:
+    /** Size in pixels of the finest level of the depth pyramid */
+    static const int OCCLUSION_TILE = 4;
+
+    explicit SphereCuller(vtkPolyData *data);
+
+    vtkPolyData *output() { return _output; }
+
+    /** Enables or disables the occlusion stage, enabled by default */
+    void setOcclusionCulling(bool enable) { _occlusion = enable; }
+
+    /**
+       Recomputes the visible spheres for a camera and a viewport of
+       width x height pixels, and updates the vertex cells of the output.
+       The cells are left untouched if the visible spheres haven't
+       changed since the last update.
+     */
+    void update(vtkCamera *camera, int width, int height);
+
+    /** Like update, but only computes visible() and leaves the output
+        untouched. */
+    void cull(vtkCamera *camera, int width, int height);
+
+    /** Indices of the spheres that passed the last update or cull */
+    const std::vector<uint32_t> &visible() const { return _visible; }
+
+    size_t sphereCount() const { return _spheres.size() / 4; }
+    /** Spheres that passed the frustum test in the last update */
+    size_t frustumCount() const { return _frustumCount; }
+    /** Spheres in the output after the last update */
+    size_t visibleCount() const { return _visible.size(); }
+    /** Duration of the last update or cull in seconds */
+    double updateTime() const { return _updateTime; }
+
+private:
+    /* Screen bounds and depths of a sphere in the frustum */
+    struct Projection
+    {
+        /* Bounds of the sphere in pixels */
+        float min[2];
+        float max[2];
+        /* Center and half side in pixels of the inscribed square of the
+           central disk, 0 if the sphere can't be an occluder */
+        float center[2];
+        float halfSide;
+        /* Distance along the view direction of the center and of the
+           front of the sphere */
+        float depth;
+        float front;
+    };
+
+    vtkSmartPointer<vtkPolyData> _output;
+    vtkSmartPointer<vtkCellArray> _cells;
+    std::vector<float> _spheres;
+    SphereBVH _bvh;
+    bool _occlusion;
+
+    std::vector<uint32_t> _visible;
+    /* Spheres referenced by the output cells */
+    std::vector<uint32_t> _written;
+    std::vector<Projection> _projections;
+    /* Levels of the depth pyramid and their sizes */
+    std::vector<std::vector<float>> _pyramid;
+    std::vector<int> _widths;
+    std::vector<int> _heights;
+
+    size_t _frustumCount;
+    double _updateTime;
+
+    void _cull(vtkCamera *camera, int width, int height);
+    void _project(vtkCamera *camera, int width, int height);
+    void _buildPyramid(int width, int height);
+    void _cullOccluded();
+    bool _occluded(const Projection &projection) const;
+    void _writeCells();
+};
+
+}
+
+#endif
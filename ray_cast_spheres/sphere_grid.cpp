@@ -0,0 +1,101 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_grid.h"
+
+#include "common/parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <cmath>
+
+namespace spheres
+{
+
+namespace
+{
+
+/* Relative position in [-0.5, 0.5] of index i along an axis of size n */
+inline float relative(const size_t i, const size_t n)
+{
+    return n > 1 ? float(i) / (n - 1) - 0.5f : 0.f;
+}
+
+}
+
+float gridRadius(const size_t i, const size_t j, const size_t k,
+                 const size_t width, const size_t height, const size_t depth)
+{
+    const float a = relative(i, width);
+    const float b = relative(j, height);
+    const float c = relative(k, depth);
+    return 8 - 5 * 2 * std::sqrt(a * a + b * b + c * c);
+}
+
+vtkSmartPointer<vtkPolyData> sphereGrid(const size_t width,
+                                        const size_t height,
+                                        const size_t depth)
+{
+    const size_t count = width * height * depth;
+
+    vtkSmartPointer<vtkPoints> vertices = vtkSmartPointer<vtkPoints>::New();
+    vertices->SetDataTypeToFloat();
+    vertices->SetNumberOfPoints(count);
+    float *positions = static_cast<float *>(vertices->GetVoidPointer(0));
+
+    vtkSmartPointer<vtkFloatArray> radii =
+        vtkSmartPointer<vtkFloatArray>::New();
+    radii->SetName("radii");
+    radii->SetNumberOfTuples(count);
+    float *radius = radii->GetPointer(0);
+
+    /* Vertex cells are stored as (1, id) pairs in a single connectivity
+       buffer written in place. */
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    vtkIdType *connectivity = cells->WritePointer(count, count * 2);
+
+    /* Each task fills the rows along k of a range of (i, j) pairs */
+    common::parallelFor(0, width * height, [&](const size_t row)
+    {
+        const size_t i = row / height;
+        const size_t j = row % height;
+        for (size_t k = 0; k != depth; ++k)
+        {
+            const size_t index = row * depth + k;
+            positions[index * 3] = i * GRID_SPACING;
+            positions[index * 3 + 1] = j * GRID_SPACING;
+            positions[index * 3 + 2] = k * GRID_SPACING;
+            radius[index] = gridRadius(i, j, k, width, height, depth);
+            connectivity[index * 2] = 1;
+            connectivity[index * 2 + 1] = index;
+        }
+    });
+
+    vtkSmartPointer<vtkPolyData> data = vtkSmartPointer<vtkPolyData>::New();
+    data->SetPoints(vertices);
+    data->SetVerts(cells);
+    data->GetPointData()->AddArray(radii);
+    return data;
+}
+
+}
@@ -0,0 +1,54 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SPHERE_GRID_H
+#define RAY_CAST_SPHERES_SPHERE_GRID_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+
+class vtkPolyData;
+
+namespace spheres
+{
+
+/** Distance between consecutive spheres of a grid */
+const double GRID_SPACING = 10;
+
+/**
+   Creates a width x height x depth grid of spheres as points with a vertex
+   cell per point and a "radii" point array. Radii decrease from the center
+   of the grid to the corners.
+
+   Points, radii and the vertex connectivity are written directly into
+   preallocated arrays in parallel, so million-sphere grids are built in a
+   fraction of a second. Point i * height * depth + j * depth + k is placed
+   at (i, j, k) * GRID_SPACING.
+ */
+vtkSmartPointer<vtkPolyData> sphereGrid(size_t width, size_t height,
+                                        size_t depth);
+
+/** Radius of sphere (i, j, k) of a grid */
+float gridRadius(size_t i, size_t j, size_t k,
+                 size_t width, size_t height, size_t depth);
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/* Compares the construction time of sphere grids point by point, as
+   pointGrid() used to do, with the bulk parallel construction of
+   sphereGrid() for 10^3 to 10^8 spheres. */
+
+#include "sphere_grid.h"
+
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+vtkSmartPointer<vtkPolyData> incrementalGrid(const size_t width,
+                                             const size_t height,
+                                             const size_t depth)
+{
+    vtkSmartPointer<vtkPolyData> data = vtkSmartPointer<vtkPolyData>::New();
+    vtkSmartPointer<vtkPoints> vertices = vtkSmartPointer<vtkPoints>::New();
+    for (size_t i = 0; i < width; ++i)
+        for (size_t j = 0; j < height; ++j)
+            for (size_t k = 0; k < depth; ++k)
+                vertices->InsertPoint(i * height * depth + j * depth + k,
+                                      i * spheres::GRID_SPACING,
+                                      j * spheres::GRID_SPACING,
+                                      k * spheres::GRID_SPACING);
+    data->SetPoints(vertices);
+
+    vtkSmartPointer<vtkCellArray> points = vtkSmartPointer<vtkCellArray>::New();
+    for (vtkIdType i = 0; i < vtkIdType(width * height * depth); ++i)
+        points->InsertNextCell(1, &i);
+    data->SetVerts(points);
+
+    vtkSmartPointer<vtkFloatArray> radii =
+        vtkSmartPointer<vtkFloatArray>::New();
+    radii->SetName("radii");
+    radii->SetNumberOfTuples(width * height * depth);
+    for (size_t i = 0; i < width; ++i)
+        for (size_t j = 0; j < height; ++j)
+            for (size_t k = 0; k < depth; ++k)
+            {
+                float radius =
+                    spheres::gridRadius(i, j, k, width, height, depth);
+                radii->SetTuple(i * height * depth + j * depth + k, &radius);
+            }
+    data->GetPointData()->AddArray(radii);
+    return data;
+}
+
+int main(int argc, char *argv[])
+{
+    /* Largest power of 10 for each construction method. Point by point
+       construction is too slow to be worth measuring beyond 10^7. */
+    int maxExponent = 8;
+    int maxIncrementalExponent = 7;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxExponent = atoi(argv[++i]);
+        else if (arg == "--incremental-max" && i + 1 < argc)
+            maxIncrementalExponent = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max exponent] "
+                      << "[--incremental-max exponent]" << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << common::threadCount() << " threads" << std::endl;
+    std::cout << std::setw(12) << "spheres" << std::setw(16) << "incremental s"
+              << std::setw(12) << "bulk s" << std::setw(12) << "speedup"
+              << std::setw(16) << "bulk Mspheres/s" << std::endl;
+    for (int exponent = 3; exponent <= maxExponent; ++exponent)
+    {
+        /* Splitting the power of 10 as evenly as possible among the axes */
+        size_t dimensions[3] = {1, 1, 1};
+        for (int i = 0; i != exponent; ++i)
+            dimensions[i % 3] *= 10;
+        const size_t count = dimensions[0] * dimensions[1] * dimensions[2];
+
+        double incremental = 0;
+        if (exponent <= maxIncrementalExponent)
+            incremental = common::measure([&]()
+            {
+                incrementalGrid(dimensions[0], dimensions[1], dimensions[2]);
+            });
+        const double bulk = common::measure([&]()
+        {
+            spheres::sphereGrid(dimensions[0], dimensions[1], dimensions[2]);
+        });
+
+        std::cout << std::setw(12) << count << std::setw(16);
+        if (incremental > 0)
+            std::cout << incremental;
+        else
+            std::cout << "-";
+        std::cout << std::setw(12) << bulk << std::setw(12);
+        if (incremental > 0)
+            std::cout << incremental / bulk;
+        else
+            std::cout << "-";
+        std::cout << std::setw(16) << count / bulk * 1e-6 << std::endl;
+    }
+}
@@ -0,0 +1,197 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_lod.h"
+#include "sphere_bvh.h"
+
+#include "common/cells.h"
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace spheres
+{
+
+namespace
+{
+
+const size_t CLASSIFY_CHUNK = 1 << 16;
+
+enum Level
+{
+    HIDDEN,
+    POINT,
+    IMPOSTOR
+};
+
+/* Averages over the projected disk of a sphere of the Lambert term and of
+   the specular term of sphere.frag, with the light at the eye. */
+const float AVERAGE_DIFFUSE = 2.f / 3;
+const float AVERAGE_SPECULAR = 1.f / 18;
+const float SPECULAR[3] = {0.2f, 0.2f, 0.1f};
+
+}
+
+SphereLOD::SphereLOD(vtkPolyData *data)
+    : _impostors(vtkSmartPointer<vtkPolyData>::New())
+    , _points(vtkSmartPointer<vtkPolyData>::New())
+    , _impostorCells(vtkSmartPointer<vtkCellArray>::New())
+    , _pointCells(vtkSmartPointer<vtkCellArray>::New())
+    , _spheres(packSpheres(data))
+    , _threshold(0.5)
+    , _impostorCount(0)
+    , _pointCount(0)
+    , _updateTime(0)
+{
+    _impostors->SetPoints(data->GetPoints());
+    _impostors->GetPointData()->ShallowCopy(data->GetPointData());
+    _impostors->SetVerts(_impostorCells);
+
+    /* The base color of a sphere is its position divided by 50, as in
+       sphere.vert */
+    const size_t count = _spheres.size() / 4;
+    vtkSmartPointer<vtkUnsignedCharArray> colors =
+        vtkSmartPointer<vtkUnsignedCharArray>::New();
+    colors->SetName("colors");
+    colors->SetNumberOfComponents(3);
+    colors->SetNumberOfTuples(count);
+    uint8_t *rgb = colors->GetPointer(0);
+    common::parallelFor(0, count, [&](const size_t i)
+    {
+        for (int j = 0; j != 3; ++j)
+        {
+            const float color = _spheres[i * 4 + j] / 50 * AVERAGE_DIFFUSE +
+                                SPECULAR[j] * AVERAGE_SPECULAR;
+            rgb[i * 3 + j] =
+                uint8_t(std::min(1.f, std::max(0.f, color)) * 255 + 0.5f);
+        }
+    });
+    _points->SetPoints(data->GetPoints());
+    _points->GetPointData()->SetScalars(colors);
+    _points->SetVerts(_pointCells);
+}
+
+void SphereLOD::update(vtkCamera *camera, int, const int height,
+                       const std::vector<uint32_t> *subset)
+{
+    _updateTime = common::measure([&]() { _update(camera, height, subset); });
+}
+
+void SphereLOD::_update(vtkCamera *camera, const int height,
+                        const std::vector<uint32_t> *subset)
+{
+    /* Pixels per unit of radius at unit distance, or at any distance for
+       parallel projections */
+    const bool parallel = camera->GetParallelProjection();
+    const double scale = parallel ?
+        height / (2 * camera->GetParallelScale()) :
+        height / (2 * std::tan(camera->GetViewAngle() * M_PI / 360));
+    vtkMatrix4x4 *view = camera->GetViewTransformMatrix();
+    double row[4];
+    for (int i = 0; i != 4; ++i)
+        row[i] = view->GetElement(2, i);
+    const double threshold = _threshold;
+
+    const size_t count = subset ? subset->size() : _spheres.size() / 4;
+    const size_t chunks = (count + CLASSIFY_CHUNK - 1) / CLASSIFY_CHUNK;
+    _levels.resize(count);
+    /* Per chunk counts, turned into the offsets of each chunk in the
+       cell arrays. */
+    std::vector<size_t> impostors(chunks + 1, 0);
+    std::vector<size_t> points(chunks + 1, 0);
+    common::parallelForChunks(0, count, CLASSIFY_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        const size_t chunk = first / CLASSIFY_CHUNK;
+        for (size_t i = first; i != last; ++i)
+        {
+            const size_t index = subset ? (*subset)[i] : i;
+            const float *sphere = &_spheres[index * 4];
+            Level level = IMPOSTOR;
+            if (sphere[3] < 0)
+                level = HIDDEN;
+            else if (parallel)
+            {
+                if (sphere[3] * scale < threshold)
+                    level = POINT;
+            }
+            else
+            {
+                /* The camera looks down the negative z axis. Spheres
+                   around or behind the eye are left to the shaders. */
+                const double depth =
+                    -(row[0] * sphere[0] + row[1] * sphere[1] +
+                      row[2] * sphere[2] + row[3]);
+                if (depth > sphere[3] &&
+                    sphere[3] * scale < threshold * depth)
+                    level = POINT;
+            }
+            _levels[i] = level;
+            impostors[chunk + 1] += level == IMPOSTOR;
+            points[chunk + 1] += level == POINT;
+        }
+    });
+    for (size_t i = 0; i != chunks; ++i)
+    {
+        impostors[i + 1] += impostors[i];
+        points[i + 1] += points[i];
+    }
+    _impostorCount = impostors[chunks];
+    _pointCount = points[chunks];
+
+    vtkIdType *impostorIds =
+        _impostorCells->WritePointer(_impostorCount, _impostorCount * 2);
+    vtkIdType *pointIds =
+        _pointCells->WritePointer(_pointCount, _pointCount * 2);
+    common::parallelForChunks(0, count, CLASSIFY_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        const size_t chunk = first / CLASSIFY_CHUNK;
+        vtkIdType *impostor = impostorIds + impostors[chunk] * 2;
+        vtkIdType *point = pointIds + points[chunk] * 2;
+        for (size_t i = first; i != last; ++i)
+        {
+            const vtkIdType index = subset ? (*subset)[i] : i;
+            if (_levels[i] == IMPOSTOR)
+            {
+                *impostor++ = 1;
+                *impostor++ = index;
+            }
+            else if (_levels[i] == POINT)
+            {
+                *point++ = 1;
+                *point++ = index;
+            }
+        }
+    });
+
+    common::cellsRewritten(_impostors, _impostorCells);
+    common::cellsRewritten(_points, _pointCells);
+}
+
+}
@@ -0,0 +1,98 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SPHERE_LOD_H
+#define RAY_CAST_SPHERES_SPHERE_LOD_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstdint>
+#include <vector>
+
+class vtkCamera;
+class vtkCellArray;
+class vtkPolyData;
+
+namespace spheres
+{
+
+/**
+   Two level of detail selection for sphere datasets: spheres whose
+   projected radius is below a threshold are drawn as single pixel points,
+   the rest as ray cast impostors.
+
+   The classification runs in parallel every frame and fills the vertex
+   cells of two poly data objects, both sharing the points of the input.
+   impostors() shares the point data of the input and is meant for the
+   sphere shaders. points() has a "colors" point array with the color the
+   fragment shader gives on average to the pixels of a sphere (its diffuse
+   term averaged over the visible disk plus the average highlight), to be
+   drawn without lighting.
+
+   Spheres with negative radius are in neither output.
+ */
+class SphereLOD
+{
+public:
+    explicit SphereLOD(vtkPolyData *data);
+
+    vtkPolyData *impostors() { return _impostors; }
+    vtkPolyData *points() { return _points; }
+
+    /** Projected radius in pixels below which spheres are drawn as
+        points, 0.5 by default. */
+    void setThreshold(double pixels) { _threshold = pixels; }
+
+    /**
+       Classifies the spheres for a camera and a viewport of width x height
+       pixels.
+       @param subset If given, only these spheres are classified (e.g. the
+              output of SphereCuller::cull), the rest are not drawn.
+     */
+    void update(vtkCamera *camera, int width, int height,
+                const std::vector<uint32_t> *subset = 0);
+
+    size_t sphereCount() const { return _spheres.size() / 4; }
+    size_t impostorCount() const { return _impostorCount; }
+    size_t pointCount() const { return _pointCount; }
+    /** Duration of the last update in seconds */
+    double updateTime() const { return _updateTime; }
+
+private:
+    vtkSmartPointer<vtkPolyData> _impostors;
+    vtkSmartPointer<vtkPolyData> _points;
+    vtkSmartPointer<vtkCellArray> _impostorCells;
+    vtkSmartPointer<vtkCellArray> _pointCells;
+    std::vector<float> _spheres;
+    double _threshold;
+
+    /* Sphere level of each classified sphere */
+    std::vector<uint8_t> _levels;
+
+    size_t _impostorCount;
+    size_t _pointCount;
+    double _updateTime;
+
+    void _update(vtkCamera *camera, int height,
+                 const std::vector<uint32_t> *subset);
+};
+
+}
+
+#endif
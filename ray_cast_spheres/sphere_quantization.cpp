@@ -0,0 +1,263 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_quantization.h"
+
+#include "common/parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkFloatArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace spheres
+{
+
+namespace
+{
+
+const char *const POSITION_QUANTIZATION = "positionQuantization";
+const char *const RADIUS_TABLE = "radiusTable";
+const char *const RADIUS_CODES_ARRAY = "radiusCodes";
+/* Position codes are symmetric around the center of the bounding box */
+const double MAX_POSITION_CODE = 32767;
+const size_t CHUNK = 1 << 16;
+
+/* Bounds of the centers and range of the non negative radii */
+struct Range
+{
+    double min[4];
+    double max[4];
+
+    Range()
+    {
+        std::fill(min, min + 4, std::numeric_limits<double>::max());
+        std::fill(max, max + 4, -std::numeric_limits<double>::max());
+    }
+
+    void add(const double *point, const double radius)
+    {
+        for (int i = 0; i != 3; ++i)
+        {
+            min[i] = std::min(min[i], point[i]);
+            max[i] = std::max(max[i], point[i]);
+        }
+        if (radius >= 0)
+        {
+            min[3] = std::min(min[3], radius);
+            max[3] = std::max(max[3], radius);
+        }
+    }
+
+    void merge(const Range &other)
+    {
+        for (int i = 0; i != 4; ++i)
+        {
+            min[i] = std::min(min[i], other.min[i]);
+            max[i] = std::max(max[i], other.max[i]);
+        }
+    }
+};
+
+}
+
+vtkSmartPointer<vtkPolyData> quantizeSpheres(vtkPolyData *data)
+{
+    vtkPoints *points = data->GetPoints();
+    vtkDataArray *radii = data->GetPointData()->GetArray("radii");
+    if (!points || !radii)
+        throw std::runtime_error("Sphere data needs points and radii");
+    const size_t count = points->GetNumberOfPoints();
+
+    /* Each chunk computes its own range, merged afterwards */
+    std::vector<Range> ranges((count + CHUNK - 1) / CHUNK);
+    common::parallelForChunks(0, count, CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        Range &range = ranges[first / CHUNK];
+        for (size_t i = first; i != last; ++i)
+        {
+            double point[3];
+            points->GetPoint(i, point);
+            range.add(point, radii->GetComponent(i, 0));
+        }
+    });
+    Range range;
+    for (size_t i = 0; i != ranges.size(); ++i)
+        range.merge(ranges[i]);
+    /* No sphere with non negative radius */
+    if (range.min[3] > range.max[3])
+        range.min[3] = range.max[3] = 0;
+
+    SphereQuantization quantization;
+    for (int i = 0; i != 3; ++i)
+    {
+        const double half = count ? (range.max[i] - range.min[i]) / 2 : 0;
+        quantization.offset[i] = count ? range.min[i] + half : 0;
+        quantization.scale[i] = half > 0 ? half / MAX_POSITION_CODE : 1;
+    }
+    const double step = (range.max[3] - range.min[3]) / (RADIUS_CODES - 2);
+    quantization.radii[0] = -1;
+    for (size_t i = 1; i != RADIUS_CODES; ++i)
+        quantization.radii[i] = range.min[3] + (i - 1) * step;
+
+    vtkSmartPointer<vtkPoints> positions = vtkSmartPointer<vtkPoints>::New();
+    positions->SetDataType(VTK_SHORT);
+    positions->SetNumberOfPoints(count);
+    int16_t *position = static_cast<int16_t *>(positions->GetVoidPointer(0));
+    vtkSmartPointer<vtkUnsignedCharArray> radiusCodes =
+        vtkSmartPointer<vtkUnsignedCharArray>::New();
+    radiusCodes->SetName(RADIUS_CODES_ARRAY);
+    radiusCodes->SetNumberOfTuples(count);
+    uint8_t *radiusCode = radiusCodes->GetPointer(0);
+
+    common::parallelFor(0, count, [&](const size_t i)
+    {
+        double point[3];
+        points->GetPoint(i, point);
+        for (int j = 0; j != 3; ++j)
+        {
+            const double code = std::floor(
+                (point[j] - quantization.offset[j]) / quantization.scale[j] +
+                0.5);
+            position[i * 3 + j] = int16_t(std::min(
+                MAX_POSITION_CODE, std::max(-MAX_POSITION_CODE, code)));
+        }
+        const double radius = radii->GetComponent(i, 0);
+        if (radius < 0)
+            radiusCode[i] = 0;
+        else
+            radiusCode[i] = step > 0 ? uint8_t(std::min(
+                double(RADIUS_CODES - 1),
+                std::floor((radius - range.min[3]) / step + 0.5) + 1)) : 1;
+    });
+
+    vtkSmartPointer<vtkDoubleArray> positionQuantization =
+        vtkSmartPointer<vtkDoubleArray>::New();
+    positionQuantization->SetName(POSITION_QUANTIZATION);
+    positionQuantization->SetNumberOfTuples(6);
+    std::copy(quantization.scale, quantization.scale + 3,
+              positionQuantization->GetPointer(0));
+    std::copy(quantization.offset, quantization.offset + 3,
+              positionQuantization->GetPointer(3));
+    vtkSmartPointer<vtkFloatArray> radiusTable =
+        vtkSmartPointer<vtkFloatArray>::New();
+    radiusTable->SetName(RADIUS_TABLE);
+    radiusTable->SetNumberOfTuples(RADIUS_CODES);
+    std::copy(quantization.radii, quantization.radii + RADIUS_CODES,
+              radiusTable->GetPointer(0));
+
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    output->SetPoints(positions);
+    output->SetVerts(data->GetVerts());
+    output->GetPointData()->AddArray(radiusCodes);
+    output->GetFieldData()->AddArray(positionQuantization);
+    output->GetFieldData()->AddArray(radiusTable);
+    return output;
+}
+
+bool isQuantized(vtkPolyData *data)
+{
+    vtkPoints *points = data->GetPoints();
+    return points && points->GetDataType() == VTK_SHORT &&
+           data->GetPointData()->GetArray(RADIUS_CODES_ARRAY) &&
+           data->GetFieldData()->GetArray(POSITION_QUANTIZATION) &&
+           data->GetFieldData()->GetArray(RADIUS_TABLE);
+}
+
+SphereQuantization sphereQuantization(vtkPolyData *data)
+{
+    if (!isQuantized(data))
+        throw std::runtime_error("Sphere data is not quantized");
+    vtkDataArray *position =
+        data->GetFieldData()->GetArray(POSITION_QUANTIZATION);
+    vtkDataArray *radii = data->GetFieldData()->GetArray(RADIUS_TABLE);
+    if (position->GetNumberOfTuples() != 6 ||
+        radii->GetNumberOfTuples() != vtkIdType(RADIUS_CODES))
+        throw std::runtime_error("Invalid sphere quantization");
+
+    SphereQuantization quantization;
+    for (int i = 0; i != 3; ++i)
+    {
+        quantization.scale[i] = position->GetComponent(i, 0);
+        quantization.offset[i] = position->GetComponent(i + 3, 0);
+    }
+    for (size_t i = 0; i != RADIUS_CODES; ++i)
+        quantization.radii[i] = radii->GetComponent(i, 0);
+    return quantization;
+}
+
+std::vector<float> dequantizeSpheres(vtkPolyData *data)
+{
+    const SphereQuantization quantization = sphereQuantization(data);
+    vtkPoints *points = data->GetPoints();
+    const size_t count = points->GetNumberOfPoints();
+    const int16_t *position =
+        static_cast<const int16_t *>(points->GetVoidPointer(0));
+    const uint8_t *radiusCode = static_cast<const uint8_t *>(
+        data->GetPointData()->GetArray(RADIUS_CODES_ARRAY)->GetVoidPointer(0));
+
+    std::vector<float> spheres(count * 4);
+    common::parallelFor(0, count, [&](const size_t i)
+    {
+        for (int j = 0; j != 3; ++j)
+            spheres[i * 4 + j] = position[i * 3 + j] * quantization.scale[j] +
+                                 quantization.offset[j];
+        spheres[i * 4 + 3] = quantization.radii[radiusCode[i]];
+    });
+    return spheres;
+}
+
+vtkSmartPointer<vtkMatrix4x4> dequantizationMatrix(
+    const SphereQuantization &quantization)
+{
+    vtkSmartPointer<vtkMatrix4x4> matrix =
+        vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int i = 0; i != 3; ++i)
+    {
+        matrix->SetElement(i, i, quantization.scale[i]);
+        matrix->SetElement(i, 3, quantization.offset[i]);
+    }
+    return matrix;
+}
+
+size_t sphereBytes(vtkPolyData *data)
+{
+    size_t bytes = 0;
+    if (vtkPoints *points = data->GetPoints())
+        bytes += points->GetData()->GetDataTypeSize() * 3;
+    vtkDataArray *radii = data->GetPointData()->GetArray(
+        isQuantized(data) ? RADIUS_CODES_ARRAY : "radii");
+    if (radii)
+        bytes += radii->GetDataTypeSize() * radii->GetNumberOfComponents();
+    return bytes;
+}
+
+}
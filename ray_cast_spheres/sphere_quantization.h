@@ -0,0 +1,91 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SPHERE_QUANTIZATION_H
+#define RAY_CAST_SPHERES_SPHERE_QUANTIZATION_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <vector>
+
+class vtkMatrix4x4;
+class vtkPolyData;
+
+namespace spheres
+{
+
+/** Number of entries of the radius table */
+const size_t RADIUS_CODES = 256;
+
+/**
+   Decoding parameters of a quantized sphere dataset.
+ */
+struct SphereQuantization
+{
+    /* Position = code * scale + offset, per axis */
+    double scale[3];
+    double offset[3];
+    /* Radius of each code. Code 0 is -1, for the spheres with negative
+       radius, which are not drawn. */
+    float radii[RADIUS_CODES];
+};
+
+/**
+   Creates a compact copy of a sphere dataset (points and "radii" point
+   array, as created by sphereGrid()).
+
+   Positions are quantized to 16 bit integers per axis relative to the
+   bounding box of the spheres and stored as VTK_SHORT points. Radii are
+   replaced by a "radiusCodes" unsigned char point array indexing a table
+   of 255 radii evenly spaced between the smallest and the largest one.
+   The decoding parameters are stored as field data, see
+   sphereQuantization(). The vertex cells are shared with the input.
+
+   Positions are drawn with the dequantizationMatrix() as the model
+   matrix, so the bounds of the actor are the original ones.
+   packSpheres() decodes quantized datasets.
+ */
+vtkSmartPointer<vtkPolyData> quantizeSpheres(vtkPolyData *data);
+
+/** Whether a dataset was created by quantizeSpheres() */
+bool isQuantized(vtkPolyData *data);
+
+/**
+   Reads the decoding parameters of a quantized dataset.
+   Throws std::runtime_error if the dataset is not quantized.
+ */
+SphereQuantization sphereQuantization(vtkPolyData *data);
+
+/** Decodes a quantized dataset to packed (x, y, z, radius) floats */
+std::vector<float> dequantizeSpheres(vtkPolyData *data);
+
+/** Transformation from position codes to positions */
+vtkSmartPointer<vtkMatrix4x4> dequantizationMatrix(
+    const SphereQuantization &quantization);
+
+/**
+   Bytes per sphere used by the positions and radii of a sphere dataset,
+   quantized or not. Vertex cells are not included.
+ */
+size_t sphereBytes(vtkPolyData *data);
+
+}
+
+#endif
@@ -0,0 +1,337 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_ray_caster.h"
+
+#include "common/parallel.h"
+
+#include <vtkCamera.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace spheres
+{
+
+namespace
+{
+
+/* 4-wide vectors, one lane per ray of a 2x2 pixel packet. The compiler
+   maps them to SSE or NEON registers. */
+typedef float Float4 __attribute__((vector_size(16)));
+typedef int Int4 __attribute__((vector_size(16)));
+
+inline Float4 splat(const float x)
+{
+    const Float4 v = {x, x, x, x};
+    return v;
+}
+
+inline Float4 min4(const Float4 a, const Float4 b) { return a < b ? a : b; }
+inline Float4 max4(const Float4 a, const Float4 b) { return a > b ? a : b; }
+
+inline bool any(const Int4 mask)
+{
+    return (mask[0] | mask[1] | mask[2] | mask[3]) != 0;
+}
+
+struct Packet
+{
+    Float4 direction[3];
+    Float4 inverse[3];
+    /* Distance to the closest hit so far */
+    Float4 t;
+    Int4 sphere;
+    Int4 active;
+};
+
+inline Int4 intersectBox(const SphereBVH::Node &node, const float *origin,
+                         const Packet &packet)
+{
+    Float4 near = splat(0);
+    Float4 far = packet.t;
+    for (int i = 0; i != 3; ++i)
+    {
+        const Float4 t0 = (splat(node.min[i] - origin[i])) * packet.inverse[i];
+        const Float4 t1 = (splat(node.max[i] - origin[i])) * packet.inverse[i];
+        near = max4(near, min4(t0, t1));
+        far = min4(far, max4(t0, t1));
+    }
+    return (near <= far) & packet.active;
+}
+
+/* Same test as sphereLineTest in sphere.frag, for the 4 rays at once */
+inline void intersectSphere(const float *sphere, const int index,
+                            const float *origin, Packet &packet)
+{
+    const float c[3] = {sphere[0] - origin[0], sphere[1] - origin[1],
+                        sphere[2] - origin[2]};
+    const float c2 = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+    const float r2 = sphere[3] * sphere[3];
+    const Float4 s = packet.direction[0] * c[0] +
+                     packet.direction[1] * c[1] +
+                     packet.direction[2] * c[2];
+    if (c2 > r2 && !any(s >= 0))
+        return;
+    const Float4 m2 = splat(c2) - s * s;
+    Int4 hit = (m2 <= r2) & packet.active;
+    if (c2 > r2)
+        hit &= s >= 0;
+    if (!any(hit))
+        return;
+
+    Float4 q;
+    for (int i = 0; i != 4; ++i)
+        q[i] = std::sqrt(std::max(r2 - m2[i], 0.f));
+    const Float4 t = c2 > r2 ? s - q : s + q;
+    hit &= t < packet.t;
+    packet.t = hit ? t : packet.t;
+    const Int4 indices = {index, index, index, index};
+    packet.sphere = hit ? indices : packet.sphere;
+}
+
+void traverse(const SphereBVH &bvh, const float *spheres,
+              const float *origin, Packet &packet)
+{
+    const SphereBVH::Node *nodes = &bvh.nodes()[0];
+    const uint32_t *indices = &bvh.indices()[0];
+    uint32_t stack[SphereBVH::MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+    while (top != 0)
+    {
+        const SphereBVH::Node &node = nodes[stack[--top]];
+        if (!any(intersectBox(node, origin, packet)))
+            continue;
+        if (node.isLeaf())
+        {
+            for (uint32_t i = node.first; i != node.first + node.count; ++i)
+                intersectSphere(spheres + size_t(indices[i]) * 4, indices[i],
+                                origin, packet);
+            continue;
+        }
+        /* Visiting first the child on the side the packet comes from */
+        const bool reverse = packet.direction[node.axis][0] < 0;
+        stack[top++] = node.first + (reverse ? 0 : 1);
+        stack[top++] = node.first + (reverse ? 1 : 0);
+    }
+}
+
+/* sphereLineTest from sphere.frag */
+float sphereLineTest(const float *c, const float r, const float *d)
+{
+    const float s = c[0] * d[0] + c[1] * d[1] + c[2] * d[2];
+    const float c2 = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+    const float r2 = r * r;
+    if (s < 0 && c2 > r2)
+        return -1;
+    const float m2 = c2 - s * s;
+    if (m2 > r2)
+        return -1;
+    const float q = std::sqrt(r2 - m2);
+    return c2 > r2 ? s - q : s + q;
+}
+
+inline uint8_t toByte(const float x)
+{
+    return uint8_t(std::min(1.f, std::max(0.f, x)) * 255 + 0.5f);
+}
+
+}
+
+SphereRayCaster::SphereRayCaster(vtkPolyData *data)
+{
+    _spheres = packSpheres(data);
+    const size_t count = _spheres.size() / 4;
+    _bvh.reset(new SphereBVH(_spheres.data(), count));
+
+    std::fill(_background, _background + 3, 0);
+    _size[0] = _size[1] = 0;
+}
+
+void SphereRayCaster::setBackground(const double red, const double green,
+                                    const double blue)
+{
+    _background[0] = red;
+    _background[1] = green;
+    _background[2] = blue;
+}
+
+void SphereRayCaster::render(vtkCamera *camera, const int width,
+                             const int height)
+{
+    _size[0] = width;
+    _size[1] = height;
+    _color.resize(size_t(width) * height * 4);
+    _depth.resize(size_t(width) * height);
+
+    const vtkMatrix4x4 *view = camera->GetViewTransformMatrix();
+    const vtkMatrix4x4 *projection =
+        camera->GetProjectionTransformMatrix(double(width) / height, -1, 1);
+    double position[3];
+    camera->GetPosition(position);
+    const float origin[3] = {float(position[0]), float(position[1]),
+                             float(position[2])};
+
+    float modelView[3][4];
+    for (int i = 0; i != 3; ++i)
+        for (int j = 0; j != 4; ++j)
+            modelView[i][j] = view->Element[i][j];
+    const double (&p)[4][4] = projection->Element;
+    /* Terms of the projection used by the fragment shader for the depth */
+    const float depthA = p[2][2];
+    const float depthB = p[2][3];
+
+    const int packetColumns = (width + 1) / 2;
+    const int packetRows = (height + 1) / 2;
+    const bool empty = _bvh->indices().empty();
+
+    common::parallelFor(0, packetRows, [&](const size_t row)
+    {
+        for (int column = 0; column != packetColumns; ++column)
+        {
+            Packet packet;
+            /* Eye space directions, also used for shading */
+            float eye[4][3];
+            for (int lane = 0; lane != 4; ++lane)
+            {
+                const int x = column * 2 + (lane & 1);
+                const int y = int(row) * 2 + (lane >> 1);
+                packet.active[lane] = x < width && y < height ? -1 : 0;
+                const double ndc[2] = {2 * (x + 0.5) / width - 1,
+                                       2 * (y + 0.5) / height - 1};
+                float *d = eye[lane];
+                d[0] = (ndc[0] + p[0][2]) / p[0][0];
+                d[1] = (ndc[1] + p[1][2]) / p[1][1];
+                d[2] = -1;
+                const float length =
+                    std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                for (int i = 0; i != 3; ++i)
+                    d[i] /= length;
+                /* World direction, the inverse of the view rotation is
+                   its transpose */
+                for (int i = 0; i != 3; ++i)
+                {
+                    float w = modelView[0][i] * d[0] +
+                              modelView[1][i] * d[1] +
+                              modelView[2][i] * d[2];
+                    if (w == 0)
+                        w = std::numeric_limits<float>::min();
+                    packet.direction[i][lane] = w;
+                    packet.inverse[i][lane] = 1 / w;
+                }
+                packet.t[lane] = std::numeric_limits<float>::max();
+                packet.sphere[lane] = -1;
+            }
+
+            if (!empty)
+                traverse(*_bvh, _spheres.data(), origin, packet);
+
+            for (int lane = 0; lane != 4; ++lane)
+            {
+                if (!packet.active[lane])
+                    continue;
+                const int x = column * 2 + (lane & 1);
+                const int y = int(row) * 2 + (lane >> 1);
+                const size_t pixel = size_t(y) * width + x;
+                uint8_t *color = &_color[pixel * 4];
+
+                float t = -1;
+                float center[3];
+                const float *sphere = 0;
+                if (packet.sphere[lane] != -1)
+                {
+                    sphere = &_spheres[size_t(packet.sphere[lane]) * 4];
+                    for (int i = 0; i != 3; ++i)
+                        center[i] = modelView[i][0] * sphere[0] +
+                                    modelView[i][1] * sphere[1] +
+                                    modelView[i][2] * sphere[2] +
+                                    modelView[i][3];
+                    t = sphereLineTest(center, sphere[3], eye[lane]);
+                }
+                if (t == -1)
+                {
+                    for (int i = 0; i != 3; ++i)
+                        color[i] = toByte(_background[i]);
+                    color[3] = 0;
+                    _depth[pixel] = 1;
+                    continue;
+                }
+
+                /* Shading as in propFuncFS and phong */
+                const float *d = eye[lane];
+                float normal[3];
+                for (int i = 0; i != 3; ++i)
+                    normal[i] = d[i] * t - center[i];
+                const float length = std::sqrt(normal[0] * normal[0] +
+                                               normal[1] * normal[1] +
+                                               normal[2] * normal[2]);
+                for (int i = 0; i != 3; ++i)
+                    normal[i] /= length;
+                _depth[pixel] = 0.5f * (1 - depthA - depthB / (d[2] * t));
+
+                /* Light at (0, 0, 1) in eye space, two-sided */
+                const float lambert = std::fabs(normal[2]);
+                /* r = reflect(-light, normal) */
+                const float r[3] = {2 * normal[2] * normal[0],
+                                    2 * normal[2] * normal[1],
+                                    2 * normal[2] * normal[2] - 1};
+                const float highlight = std::pow(
+                    std::max(-(r[0] * d[0] + r[1] * d[1] + r[2] * d[2]), 0.f),
+                    8.f);
+                const float specular[3] = {0.2f, 0.2f, 0.1f};
+                for (int i = 0; i != 3; ++i)
+                    color[i] = toByte(sphere[i] / 50.f * lambert +
+                                      specular[i] * highlight);
+                /* Opaque spheres, alpha * (2 - alpha) = 1 */
+                color[3] = 255;
+            }
+        }
+    });
+}
+
+vtkSmartPointer<vtkImageData> SphereRayCaster::colorImage() const
+{
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(_size[0], _size[1], 1);
+    image->AllocateScalars(VTK_UNSIGNED_CHAR, 4);
+    if (!_color.empty())
+        memcpy(image->GetScalarPointer(), _color.data(), _color.size());
+    return image;
+}
+
+vtkSmartPointer<vtkImageData> SphereRayCaster::depthImage() const
+{
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(_size[0], _size[1], 1);
+    image->AllocateScalars(VTK_FLOAT, 1);
+    if (!_depth.empty())
+        memcpy(image->GetScalarPointer(), _depth.data(),
+               _depth.size() * sizeof(float));
+    return image;
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SPHERE_RAY_CASTER_H
+#define RAY_CAST_SPHERES_SPHERE_RAY_CASTER_H
+
+#include "sphere_bvh.h"
+
+#include <vtkSmartPointer.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class vtkCamera;
+class vtkImageData;
+class vtkPolyData;
+
+namespace spheres
+{
+
+/**
+   Multithreaded CPU ray caster for sphere datasets which reproduces the
+   output of the sphere impostor shaders (sphere.vert, sphere.geom and
+   sphere.frag).
+
+   Spheres are taken from the points and the "radii" point array of a poly
+   data, spheres with negative radius are not rendered, like in the
+   geometry shader. The color of a sphere is its position divided by 50,
+   shaded with the same Phong model as the fragment shader and a white
+   headlight, and the depth buffer holds the same window coordinates that
+   the fragment shader writes to gl_FragDepth.
+
+   Rays are traced in packets of 2x2 pixels through a SphereBVH. Each
+   packet is traversed as a whole, using 4-wide vector operations for the
+   box and sphere tests, and the image is split across threads by rows of
+   packets. Only perspective projections are supported, as in the shaders.
+ */
+class SphereRayCaster
+{
+public:
+    explicit SphereRayCaster(vtkPolyData *data);
+
+    void setBackground(double red, double green, double blue);
+
+    /** Renders the spheres seen from a camera into width x height pixels */
+    void render(vtkCamera *camera, int width, int height);
+
+    /** RGBA unsigned char image of the last frame, first row at the
+        bottom as read back from OpenGL. */
+    vtkSmartPointer<vtkImageData> colorImage() const;
+    /** Float depth image of the last frame, 1 where nothing was hit */
+    vtkSmartPointer<vtkImageData> depthImage() const;
+
+    const SphereBVH &bvh() const { return *_bvh; }
+    size_t sphereCount() const { return _spheres.size() / 4; }
+
+private:
+    /* Packed (x, y, z, radius) */
+    std::vector<float> _spheres;
+    std::unique_ptr<SphereBVH> _bvh;
+    float _background[3];
+
+    int _size[2];
+    std::vector<uint8_t> _color;
+    std::vector<float> _depth;
+};
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+/* Back to front sorting time of sphere grids of 10^3 to 10^7 spheres for
+   a camera orbiting around them, with the parallel radix sort of
+   SphereSorter and with std::sort, to check how many spheres can be
+   drawn translucent at interactive rates. Both times cover the same work
+   on the spheres with non negative radius: computing the distances,
+   sorting and writing the vertex cells. */
+
+#include "sphere_bvh.h"
+#include "sphere_grid.h"
+#include "sphere_sorter.h"
+
+#include "common/cells.h"
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Camera positions sorted for each grid */
+const int FRAMES = 10;
+
+int main(int argc, char *argv[])
+{
+    int maxExponent = 7;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            maxExponent = atoi(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--max exponent]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << common::threadCount() << " threads" << std::endl;
+    std::cout << std::setw(12) << "spheres" << std::setw(12) << "radix ms"
+              << std::setw(12) << "std ms" << std::setw(12) << "Mspheres/s"
+              << std::setw(12) << "max fps" << std::endl;
+    for (int exponent = 3; exponent <= maxExponent; ++exponent)
+    {
+        size_t dimensions[3] = {1, 1, 1};
+        for (int i = 0; i != exponent; ++i)
+            dimensions[i % 3] *= 10;
+        vtkSmartPointer<vtkPolyData> data = spheres::sphereGrid(
+            dimensions[0], dimensions[1], dimensions[2]);
+        spheres::SphereSorter sorter(data);
+        const size_t count = sorter.sphereCount();
+
+        const double center[3] = {
+            (dimensions[0] - 1) * spheres::GRID_SPACING * 0.5,
+            (dimensions[1] - 1) * spheres::GRID_SPACING * 0.5,
+            (dimensions[2] - 1) * spheres::GRID_SPACING * 0.5};
+        vtkSmartPointer<vtkCamera> camera = vtkSmartPointer<vtkCamera>::New();
+        camera->SetFocalPoint(center[0], center[1], center[2]);
+        camera->SetPosition(center[0], center[1],
+                            center[2] * 3 + spheres::GRID_SPACING);
+
+        /* The spheres sorted by SphereSorter, for std::sort */
+        const std::vector<float> packed = spheres::packSpheres(data);
+        std::vector<uint32_t> indices;
+        for (size_t i = 0; i != packed.size() / 4; ++i)
+            if (packed[i * 4 + 3] >= 0)
+                indices.push_back(i);
+        std::vector<std::pair<float, uint32_t>> pairs(count);
+        vtkSmartPointer<vtkPolyData> output =
+            vtkSmartPointer<vtkPolyData>::New();
+        vtkSmartPointer<vtkCellArray> cells =
+            vtkSmartPointer<vtkCellArray>::New();
+        output->SetPoints(data->GetPoints());
+        output->SetVerts(cells);
+
+        double radix = 0;
+        double standard = 0;
+        for (int frame = 0; frame != FRAMES; ++frame)
+        {
+            camera->Azimuth(360.0 / FRAMES);
+            sorter.update(camera);
+            radix += sorter.sortTime();
+
+            const double *eye = camera->GetPosition();
+            standard += common::measure([&]()
+            {
+                common::parallelFor(0, count, [&](const size_t i)
+                {
+                    const float *sphere = &packed[size_t(indices[i]) * 4];
+                    const float d[3] = {float(sphere[0] - eye[0]),
+                                        float(sphere[1] - eye[1]),
+                                        float(sphere[2] - eye[2])};
+                    pairs[i] = std::make_pair(
+                        -(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]),
+                        indices[i]);
+                });
+                std::sort(pairs.begin(), pairs.end());
+                vtkIdType *connectivity =
+                    cells->WritePointer(count, count * 2);
+                common::parallelFor(0, count, [&](const size_t i)
+                {
+                    connectivity[i * 2] = 1;
+                    connectivity[i * 2 + 1] = pairs[i].second;
+                });
+                common::cellsRewritten(output, cells);
+            });
+        }
+        radix /= FRAMES;
+        standard /= FRAMES;
+
+        std::cout << std::setw(12) << count << std::setw(12) << radix * 1e3
+                  << std::setw(12) << standard * 1e3 << std::setw(12)
+                  << count / radix * 1e-6 << std::setw(12) << 1 / radix
+                  << std::endl;
+    }
+}
@@ -0,0 +1,196 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_sorter.h"
+#include "sphere_bvh.h"
+
+#include "common/cells.h"
+#include "common/parallel.h"
+#include "common/timing.h"
+
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace spheres
+{
+
+namespace
+{
+
+const int RADIX_BITS = 8;
+const size_t RADIX = 1 << RADIX_BITS;
+const size_t SORT_CHUNK = 1 << 16;
+
+/* Maps floats to unsigned integers with the same order */
+inline uint32_t sortableBits(const float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits & 0x80000000 ? ~bits : bits | 0x80000000;
+}
+
+}
+
+void radixSort(uint32_t *keys, uint32_t *values, uint32_t *keyBuffer,
+               uint32_t *valueBuffer, const size_t count)
+{
+    const size_t chunks = (count + SORT_CHUNK - 1) / SORT_CHUNK;
+    /* Digit counts of each chunk, turned into scatter offsets */
+    std::vector<size_t> offsets(chunks * RADIX);
+    uint32_t *inKeys = keys;
+    uint32_t *inValues = values;
+    uint32_t *outKeys = keyBuffer;
+    uint32_t *outValues = valueBuffer;
+
+    for (int shift = 0; shift != 32; shift += RADIX_BITS)
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        common::parallelForChunks(0, count, SORT_CHUNK,
+                                  [&](const size_t first, const size_t last)
+        {
+            size_t *histogram = &offsets[first / SORT_CHUNK * RADIX];
+            for (size_t i = first; i != last; ++i)
+                ++histogram[(inKeys[i] >> shift) & (RADIX - 1)];
+        });
+
+        bool sorted = false;
+        size_t offset = 0;
+        for (size_t digit = 0; digit != RADIX && !sorted; ++digit)
+        {
+            const size_t start = offset;
+            for (size_t chunk = 0; chunk != chunks; ++chunk)
+            {
+                size_t &entry = offsets[chunk * RADIX + digit];
+                const size_t digitCount = entry;
+                entry = offset;
+                offset += digitCount;
+            }
+            sorted = offset - start == count;
+        }
+        if (sorted)
+            continue;
+
+        common::parallelForChunks(0, count, SORT_CHUNK,
+                                  [&](const size_t first, const size_t last)
+        {
+            size_t position[RADIX];
+            std::copy(&offsets[first / SORT_CHUNK * RADIX],
+                      &offsets[first / SORT_CHUNK * RADIX] + RADIX, position);
+            for (size_t i = first; i != last; ++i)
+            {
+                const size_t target =
+                    position[(inKeys[i] >> shift) & (RADIX - 1)]++;
+                outKeys[target] = inKeys[i];
+                outValues[target] = inValues[i];
+            }
+        });
+        std::swap(inKeys, outKeys);
+        std::swap(inValues, outValues);
+    }
+
+    if (inKeys == keys)
+        return;
+    common::parallelForChunks(0, count, SORT_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        std::copy(inKeys + first, inKeys + last, keys + first);
+        std::copy(inValues + first, inValues + last, values + first);
+    });
+}
+
+SphereSorter::SphereSorter(vtkPolyData *data)
+    : _output(vtkSmartPointer<vtkPolyData>::New())
+    , _cells(vtkSmartPointer<vtkCellArray>::New())
+    , _spheres(packSpheres(data))
+    , _parallel(false)
+    , _sortTime(0)
+{
+    for (size_t i = 0; i != _spheres.size() / 4; ++i)
+        if (_spheres[i * 4 + 3] >= 0)
+            _indices.push_back(i);
+    const size_t count = _indices.size();
+    _keys.resize(count);
+    _order.resize(count);
+    _keyBuffer.resize(count);
+    _orderBuffer.resize(count);
+    /* Never matches a view, the first update always sorts */
+    std::fill(_view, _view + 16, std::numeric_limits<double>::quiet_NaN());
+
+    _output->SetPoints(data->GetPoints());
+    _output->GetPointData()->ShallowCopy(data->GetPointData());
+    _output->SetVerts(_cells);
+}
+
+bool SphereSorter::update(vtkCamera *camera)
+{
+    vtkMatrix4x4 *view = camera->GetViewTransformMatrix();
+    const bool parallel = camera->GetParallelProjection() != 0;
+    if (parallel == _parallel &&
+        std::equal(_view, _view + 16, &view->Element[0][0]))
+        return false;
+
+    std::copy(&view->Element[0][0], &view->Element[0][0] + 16, _view);
+    _parallel = parallel;
+    _sortTime = common::measure([&]() { _sort(camera); });
+    return true;
+}
+
+void SphereSorter::_sort(vtkCamera *camera)
+{
+    /* The third row of the view matrix gives the eye space z, which is
+       negative in front of the camera */
+    double row[4];
+    for (int i = 0; i != 4; ++i)
+        row[i] = _view[8 + i];
+    double eye[3];
+    camera->GetPosition(eye);
+
+    /* Decreasing distance is increasing complemented key */
+    const size_t count = _indices.size();
+    common::parallelFor(0, count, [&](const size_t i)
+    {
+        const float *sphere = &_spheres[size_t(_indices[i]) * 4];
+        float distance;
+        if (_parallel)
+            distance = -(row[0] * sphere[0] + row[1] * sphere[1] +
+                         row[2] * sphere[2] + row[3]);
+        else
+        {
+            const float d[3] = {float(sphere[0] - eye[0]),
+                                float(sphere[1] - eye[1]),
+                                float(sphere[2] - eye[2])};
+            distance = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        }
+        _keys[i] = ~sortableBits(distance);
+        _order[i] = _indices[i];
+    });
+    radixSort(_keys.data(), _order.data(), _keyBuffer.data(),
+              _orderBuffer.data(), count);
+
+    common::writeVertexCells(_output, _cells, _order.data(), count);
+}
+
+}
@@ -0,0 +1,104 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SPHERE_SORTER_H
+#define RAY_CAST_SPHERES_SPHERE_SORTER_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class vtkCamera;
+class vtkCellArray;
+class vtkPolyData;
+
+namespace spheres
+{
+
+/**
+   Stable parallel LSD radix sort of count values by their 32 bit keys, in
+   ascending order.
+
+   Each pass sorts by 8 bits. The input is split in chunks that count
+   their digits in parallel, the offsets of every digit and chunk are the
+   prefix sums of the counts, and each chunk then scatters its elements
+   in order. Passes in which all keys have the same digit are skipped.
+   The buffers must hold count elements, the result is left in keys and
+   values.
+ */
+void radixSort(uint32_t *keys, uint32_t *values, uint32_t *keyBuffer,
+               uint32_t *valueBuffer, size_t count);
+
+/**
+   Back to front ordering of a sphere dataset for translucent rendering.
+
+   The output poly data shares the points and the point arrays of the
+   input and its vertex cells reference the spheres sorted by decreasing
+   distance to the camera of the last update() (along the direction of
+   projection for parallel projections), so the impostors are blended
+   in order. Spheres with negative radius are not in the output.
+
+   The spheres are read when the sorter is created, positions and radii
+   are not expected to change afterwards.
+ */
+class SphereSorter
+{
+public:
+    explicit SphereSorter(vtkPolyData *data);
+
+    vtkPolyData *output() { return _output; }
+
+    /**
+       Sorts the spheres for a camera and updates the vertex cells of the
+       output. Nothing is done if the view hasn't changed since the last
+       sort.
+       @return true if the spheres were sorted.
+     */
+    bool update(vtkCamera *camera);
+
+    /** Spheres in the output */
+    size_t sphereCount() const { return _indices.size(); }
+    /** Duration of the last sort in seconds, cells included */
+    double sortTime() const { return _sortTime; }
+
+private:
+    vtkSmartPointer<vtkPolyData> _output;
+    vtkSmartPointer<vtkCellArray> _cells;
+    std::vector<float> _spheres;
+    /* Spheres with non negative radius */
+    std::vector<uint32_t> _indices;
+
+    std::vector<uint32_t> _keys;
+    std::vector<uint32_t> _order;
+    std::vector<uint32_t> _keyBuffer;
+    std::vector<uint32_t> _orderBuffer;
+
+    /* View of the last sort */
+    double _view[16];
+    bool _parallel;
+    double _sortTime;
+
+    void _sort(vtkCamera *camera);
+};
+
+}
+
+#endif
@@ -0,0 +1,273 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "sphere_trajectory.h"
+
+#include "common/binary_io.h"
+#include "common/parallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace spheres
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'V', 'T', 'K', 'D', 'T', 'R', 'A', 'J'};
+const uint32_t VERSION = 1;
+const size_t HEADER_SIZE =
+    sizeof(MAGIC) + sizeof(uint32_t) + sizeof(uint64_t) * 2;
+/* Floats per sphere and frame: position and radius */
+const size_t SPHERE_FLOATS = 4;
+const size_t COPY_CHUNK = 1 << 18;
+
+void copy(const float *in, float *out, const size_t count)
+{
+    common::parallelForChunks(0, count, COPY_CHUNK,
+                              [&](const size_t first, const size_t last)
+    {
+        memcpy(out + first, in + first, (last - first) * sizeof(float));
+    });
+}
+
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string &filename,
+                                   const size_t sphereCount,
+                                   const size_t frameCount)
+    : _file(filename.c_str(), std::ios::binary)
+    , _filename(filename)
+    , _sphereCount(sphereCount)
+{
+    if (!_file)
+        throw std::runtime_error("Could not open file " + filename);
+    _file.write(MAGIC, sizeof(MAGIC));
+    common::writeValue(_file, VERSION);
+    common::writeValue(_file, uint64_t(sphereCount));
+    common::writeValue(_file, uint64_t(frameCount));
+}
+
+void TrajectoryWriter::writeFrame(const float *positions, const float *radii)
+{
+    _file.write(reinterpret_cast<const char *>(positions),
+                _sphereCount * 3 * sizeof(float));
+    _file.write(reinterpret_cast<const char *>(radii),
+                _sphereCount * sizeof(float));
+    if (_file.fail())
+        throw std::runtime_error("Error writing file " + _filename);
+}
+
+TrajectoryStream::TrajectoryStream(const std::string &filename,
+                                   const size_t slots)
+    : _fd(open(filename.c_str(), O_RDONLY))
+    , _filename(filename)
+    , _sphereCount(0)
+    , _frameCount(0)
+    , _currentFrame(0)
+    , _output(vtkSmartPointer<vtkPolyData>::New())
+    , _front(0)
+    , _first(0)
+    , _ready(0)
+    , _stop(false)
+{
+    if (_fd == -1)
+        throw std::runtime_error("Could not open file " + filename);
+
+    try
+    {
+        char header[HEADER_SIZE];
+        common::preadAll(_fd, header, HEADER_SIZE, 0, filename);
+        if (memcmp(header, MAGIC, sizeof(MAGIC)) != 0)
+            throw std::runtime_error(filename + " is not a trajectory");
+        const char *in = header + sizeof(MAGIC);
+        uint32_t version;
+        in = common::readValue(in, version);
+        if (version != VERSION)
+            throw std::runtime_error("Unsupported trajectory version");
+        uint64_t count;
+        in = common::readValue(in, count);
+        _sphereCount = count;
+        common::readValue(in, count);
+        _frameCount = count;
+
+        struct stat info;
+        if (fstat(_fd, &info) != 0 ||
+            uint64_t(info.st_size) != HEADER_SIZE + uint64_t(_frameCount) *
+                _sphereCount * SPHERE_FLOATS * sizeof(float))
+            throw std::runtime_error(filename + " is truncated");
+        if (_frameCount == 0)
+            throw std::runtime_error(filename + " has no frames");
+    }
+    catch (...)
+    {
+        close(_fd);
+        throw;
+    }
+
+    for (int i = 0; i != 2; ++i)
+    {
+        _points[i] = vtkSmartPointer<vtkPoints>::New();
+        _points[i]->SetDataTypeToFloat();
+        _points[i]->SetNumberOfPoints(_sphereCount);
+        _radii[i] = vtkSmartPointer<vtkFloatArray>::New();
+        _radii[i]->SetName("radii");
+        _radii[i]->SetNumberOfTuples(_sphereCount);
+    }
+    _slots.resize(std::max(slots, size_t(1)));
+    for (size_t i = 0; i != _slots.size(); ++i)
+        _slots[i].data.resize(_sphereCount * SPHERE_FLOATS);
+
+    /* The first frame is loaded synchronously */
+    try
+    {
+        _read(0, &_slots[0].data[0]);
+    }
+    catch (...)
+    {
+        close(_fd);
+        throw;
+    }
+    _slots[0].frame = 0;
+    _copy(_slots[0], 0);
+
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    vtkIdType *connectivity =
+        cells->WritePointer(_sphereCount, _sphereCount * 2);
+    common::parallelFor(0, _sphereCount, [&](const size_t i)
+    {
+        connectivity[i * 2] = 1;
+        connectivity[i * 2 + 1] = i;
+    });
+    _output->SetPoints(_points[0]);
+    _output->SetVerts(cells);
+    _output->GetPointData()->AddArray(_radii[0]);
+
+    /* A single frame is never reloaded */
+    if (_frameCount > 1)
+        _loader = std::thread(&TrajectoryStream::_load, this);
+}
+
+TrajectoryStream::~TrajectoryStream()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    if (_loader.joinable())
+        _loader.join();
+    close(_fd);
+}
+
+bool TrajectoryStream::update()
+{
+    const Slot *slot;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_ready == 0)
+            return false;
+        slot = &_slots[_first];
+    }
+
+    /* The slot is not touched by the loader until it's released */
+    const int back = 1 - _front;
+    _copy(*slot, back);
+    _currentFrame = slot->frame;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _first = (_first + 1) % _slots.size();
+        --_ready;
+    }
+    _condition.notify_all();
+
+    _front = back;
+    _output->SetPoints(_points[_front]);
+    /* Replaces the array with the same name */
+    _output->GetPointData()->AddArray(_radii[_front]);
+    _output->Modified();
+    return true;
+}
+
+void TrajectoryStream::_read(const size_t frame, float *data) const
+{
+    const size_t bytes = _sphereCount * SPHERE_FLOATS * sizeof(float);
+    common::preadAll(_fd, data, bytes,
+                     HEADER_SIZE + uint64_t(frame) * bytes, _filename);
+}
+
+void TrajectoryStream::_copy(const Slot &slot, const int buffer)
+{
+    const float *data = slot.data.data();
+    copy(data, static_cast<float *>(_points[buffer]->GetVoidPointer(0)),
+         _sphereCount * 3);
+    copy(data + _sphereCount * 3, _radii[buffer]->GetPointer(0),
+         _sphereCount);
+    _points[buffer]->Modified();
+    _radii[buffer]->Modified();
+}
+
+void TrajectoryStream::_load()
+{
+    /* The first frame was loaded by the constructor */
+    size_t frame = 1;
+    while (true)
+    {
+        Slot *slot;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (!_stop && _ready == _slots.size())
+                _condition.wait(lock);
+            if (_stop)
+                return;
+            slot = &_slots[(_first + _ready) % _slots.size()];
+        }
+        try
+        {
+            _read(frame, &slot->data[0]);
+        }
+        catch (const std::runtime_error &e)
+        {
+            /* Playback stops at the last frame loaded */
+            std::cerr << e.what() << std::endl;
+            return;
+        }
+        slot->frame = frame;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_ready;
+        }
+        frame = (frame + 1) % _frameCount;
+    }
+}
+
+}
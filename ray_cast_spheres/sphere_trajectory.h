@@ -0,0 +1,137 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef RAY_CAST_SPHERES_SPHERE_TRAJECTORY_H
+#define RAY_CAST_SPHERES_SPHERE_TRAJECTORY_H
+
+#include <vtkSmartPointer.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class vtkFloatArray;
+class vtkPoints;
+class vtkPolyData;
+
+namespace spheres
+{
+
+/**
+   Writes sphere trajectory files.
+
+   A trajectory file has a small header with the number of spheres and
+   frames followed by the frames, all of the same size. Each frame stores
+   the positions of the spheres (3 floats each) followed by their radii.
+ */
+class TrajectoryWriter
+{
+public:
+    /** Throws std::runtime_error if the file can't be created */
+    TrajectoryWriter(const std::string &filename, size_t sphereCount,
+                     size_t frameCount);
+
+    /** Throws std::runtime_error on write errors */
+    void writeFrame(const float *positions, const float *radii);
+
+private:
+    std::ofstream _file;
+    std::string _filename;
+    size_t _sphereCount;
+};
+
+/**
+   Plays a trajectory file back frame by frame.
+
+   A loader thread reads the frames in order, looping at the end of the
+   trajectory, into a ring buffer of a few frames. update() takes the next
+   frame from the ring buffer if it's ready, copies it into the back buffer
+   of a pair of vtkPoints and radii arrays and swaps them in the output,
+   so the render thread never waits for the disk. The output has a vertex
+   cell per sphere and a "radii" point array, as sphereGrid().
+ */
+class TrajectoryStream
+{
+public:
+    /**
+       Opens a trajectory and loads its first frame.
+       @param slots Number of frames of the ring buffer.
+       Throws std::runtime_error if the file can't be read or is not a
+       trajectory.
+     */
+    explicit TrajectoryStream(const std::string &filename, size_t slots = 4);
+    ~TrajectoryStream();
+
+    size_t sphereCount() const { return _sphereCount; }
+    size_t frameCount() const { return _frameCount; }
+    /** Index of the frame in the output */
+    size_t currentFrame() const { return _currentFrame; }
+
+    vtkPolyData *output() { return _output; }
+
+    /**
+       Swaps the next frame into the output if the loader has it ready.
+       Never blocks on the loader.
+       @return true if the output changed.
+     */
+    bool update();
+
+private:
+    struct Slot
+    {
+        /* Positions followed by radii, as in the file */
+        std::vector<float> data;
+        size_t frame;
+    };
+
+    int _fd;
+    std::string _filename;
+    size_t _sphereCount;
+    size_t _frameCount;
+    size_t _currentFrame;
+
+    vtkSmartPointer<vtkPolyData> _output;
+    vtkSmartPointer<vtkPoints> _points[2];
+    vtkSmartPointer<vtkFloatArray> _radii[2];
+    int _front;
+
+    std::vector<Slot> _slots;
+    /* First filled slot and number of filled slots of the ring buffer */
+    size_t _first;
+    size_t _ready;
+    bool _stop;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _loader;
+
+    void _read(size_t frame, float *data) const;
+    void _copy(const Slot &slot, int buffer);
+    void _load();
+
+    TrajectoryStream(const TrajectoryStream &);
+    void operator=(const TrajectoryStream &);
+};
+
+}
+
+#endif
@@ -0,0 +1,436 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "async_volume_loader.h"
+#include "bricked_volume_source.h"
+
+#include "common/parallel.h"
+
+#include <vtkCamera.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPointData.h>
+#include <vtkTrivialProducer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace volume
+{
+
+namespace
+{
+
+/* Maximum number of decompressed bricks waiting to be copied */
+const size_t MAX_READY_BRICKS = 64;
+
+template<typename T>
+void fill(T *out, const size_t count, const double value)
+{
+    std::fill(out, out + count, T(value));
+}
+
+void fillRow(char *row, const int scalarType, const size_t count,
+             const double value)
+{
+    switch (scalarType)
+    {
+        vtkTemplateMacro(fill(reinterpret_cast<VTK_TT *>(row), count, value));
+    }
+}
+
+template<typename T>
+void upsample(const T *coarse, const int *indices, const size_t count,
+              T *out)
+{
+    for (size_t i = 0; i != count; ++i)
+        out[i] = coarse[indices[i]];
+}
+
+void upsampleRow(const char *coarse, const int scalarType, const int *indices,
+                 const size_t count, char *row)
+{
+    switch (scalarType)
+    {
+        vtkTemplateMacro(upsample(reinterpret_cast<const VTK_TT *>(coarse),
+                                  indices, count,
+                                  reinterpret_cast<VTK_TT *>(row)));
+    }
+}
+
+/* Nearest voxel of a coarse image for each voxel of a volume along an
+   axis */
+std::vector<int> nearestVoxels(const BrickedVolume &volume, const int axis,
+                               vtkImageData *coarse)
+{
+    const int count = volume.dimensions()[axis];
+    const int coarseCount = coarse->GetDimensions()[axis];
+    std::vector<int> voxels(count);
+    for (int i = 0; i != count; ++i)
+    {
+        const double x = volume.origin()[axis] + i * volume.spacing()[axis];
+        const double voxel = (x - coarse->GetOrigin()[axis]) /
+                             coarse->GetSpacing()[axis];
+        voxels[i] = std::min(coarseCount - 1,
+                             std::max(0, int(std::floor(voxel + 0.5))));
+    }
+    return voxels;
+}
+
+}
+
+AsyncVolumeLoader::AsyncVolumeLoader(
+    const std::shared_ptr<VolumePyramid> &pyramid,
+    vtkPiecewiseFunction *opacity, const int previewSize)
+    : _pyramid(pyramid)
+    , _volume(pyramid->levelPointer(0))
+    , _producer(vtkSmartPointer<vtkTrivialProducer>::New())
+    , _empty(_volume->brickCount(), 0)
+    , _loaded(0)
+    , _stop(false)
+    , _failed(false)
+{
+    /* Never matches a camera, the first setCamera always sorts */
+    std::fill(_view, _view + 16, std::numeric_limits<double>::quiet_NaN());
+
+    for (size_t i = 0; i != _volume->brickCount(); ++i)
+    {
+        const BrickedVolume::Brick &brick = _volume->brick(i);
+        _empty[i] = opacity &&
+            maximumOpacity(opacity, brick.range[0], brick.range[1]) == 0;
+        if (_empty[i])
+            ++_loaded;
+        else
+            _pending.push_back(i);
+    }
+    _uploaded = _loaded;
+
+    _makePreview(opacity, previewSize);
+    _producer->SetOutput(_preview);
+}
+
+AsyncVolumeLoader::~AsyncVolumeLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void AsyncVolumeLoader::start(vtkCamera *camera, const double aspect)
+{
+    if (_thread.joinable())
+        return;
+    _sort(camera, aspect);
+    _thread = std::thread(&AsyncVolumeLoader::_load, this);
+}
+
+void AsyncVolumeLoader::setCamera(vtkCamera *camera, const double aspect)
+{
+    vtkMatrix4x4 *view =
+        camera->GetCompositeProjectionTransformMatrix(aspect, -1, 1);
+    if (std::equal(_view, _view + 16, &view->Element[0][0]))
+        return;
+    _sort(camera, aspect);
+}
+
+bool AsyncVolumeLoader::update()
+{
+    std::deque<LoadedBrick> ready;
+    vtkSmartPointer<vtkImageData> initialized;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ready.swap(_ready);
+        initialized = _initialized;
+        _initialized = 0;
+    }
+    _condition.notify_all();
+
+    bool changed = false;
+    if (initialized)
+    {
+        /* The full image is a new data object, it's uploaded once
+           anyway. */
+        _full = initialized;
+        _preview = 0;
+        _producer->SetOutput(_full);
+        _uploaded = _loaded;
+        changed = true;
+    }
+
+    for (size_t i = 0; i != ready.size(); ++i)
+        _copy(ready[i].first, &(*ready[i].second)[0]);
+    _loaded += ready.size();
+
+    const size_t step =
+        std::max(size_t(1), _volume->brickCount() / UPLOAD_STEPS);
+    if (_full && _loaded != _uploaded &&
+        (_loaded - _uploaded >= step || finished()))
+    {
+        _full->Modified();
+        _uploaded = _loaded;
+        changed = true;
+    }
+    return changed;
+}
+
+std::string AsyncVolumeLoader::error() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _error;
+}
+
+double AsyncVolumeLoader::progress() const
+{
+    return double(_loaded) / _volume->brickCount();
+}
+
+void AsyncVolumeLoader::_makePreview(vtkPiecewiseFunction *opacity,
+                                     const int previewSize)
+{
+    const int level = _pyramid->levelForBudget(previewSize);
+    const int *dims = _pyramid->level(level).dimensions();
+    if (std::max(dims[0], std::max(dims[1], dims[2])) <= previewSize)
+    {
+        vtkSmartPointer<BrickedVolumeSource> source =
+            vtkSmartPointer<BrickedVolumeSource>::New();
+        source->SetPyramid(_pyramid);
+        source->SetBrickLevels(
+            std::vector<int>(_volume->brickCount(), level));
+        if (opacity)
+            source->SetOpacityFunction(opacity);
+        source->Update();
+        _preview = source->GetOutput();
+        return;
+    }
+
+    /* No level is small enough, one voxel per brick with its minimum.
+       The image spans the same bounds as the volume. */
+    const int *counts = _volume->brickCounts();
+    int previewDims[3];
+    double spacing[3];
+    for (int i = 0; i != 3; ++i)
+    {
+        previewDims[i] = std::max(2, counts[i]);
+        spacing[i] = _volume->spacing()[i] *
+                     std::max(1, _volume->dimensions()[i] - 1) /
+                     (previewDims[i] - 1);
+    }
+    _preview = vtkSmartPointer<vtkImageData>::New();
+    _preview->SetDimensions(previewDims);
+    _preview->SetSpacing(spacing);
+    _preview->SetOrigin(_volume->origin());
+    _preview->AllocateScalars(_volume->scalarType(), 1);
+    _preview->GetPointData()->GetScalars()->SetName("scalars");
+    char *out = static_cast<char *>(_preview->GetScalarPointer());
+    for (int z = 0; z != previewDims[2]; ++z)
+        for (int y = 0; y != previewDims[1]; ++y)
+            for (int x = 0; x != previewDims[0]; ++x)
+            {
+                const size_t brick =
+                    (size_t(std::min(z, counts[2] - 1)) * counts[1] +
+                     std::min(y, counts[1] - 1)) * counts[0] +
+                    std::min(x, counts[0] - 1);
+                fillRow(out, _volume->scalarType(), 1,
+                        _volume->brick(brick).range[0]);
+                out += _volume->scalarSize();
+            }
+}
+
+vtkSmartPointer<vtkImageData> AsyncVolumeLoader::_initializeFull() const
+{
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(const_cast<int *>(_volume->dimensions()));
+    image->SetSpacing(_volume->spacing());
+    image->SetOrigin(_volume->origin());
+    image->AllocateScalars(_volume->scalarType(), 1);
+    image->GetPointData()->GetScalars()->SetName("scalars");
+
+    /* Until its brick arrives, each region shows the preview. Empty
+       bricks are never loaded and show their minimum, which is
+       transparent, the preview may not be there. */
+    std::vector<int> voxels[3];
+    for (int i = 0; i != 3; ++i)
+        voxels[i] = nearestVoxels(*_volume, i, _preview);
+    const int *previewDims = _preview->GetDimensions();
+    const char *preview =
+        static_cast<const char *>(_preview->GetScalarPointer());
+
+    const int *dims = _volume->dimensions();
+    const int scalarType = _volume->scalarType();
+    const size_t scalarSize = _volume->scalarSize();
+    char *out = static_cast<char *>(image->GetScalarPointer());
+    common::parallelFor(0, _volume->brickCount(), [&](const size_t i)
+    {
+        if (_stop)
+            return;
+        int extent[6];
+        _volume->brickExtent(i, extent);
+        const size_t rowLength = extent[1] - extent[0] + 1;
+        for (int z = extent[4]; z <= extent[5]; ++z)
+            for (int y = extent[2]; y <= extent[3]; ++y)
+            {
+                char *row = out + ((size_t(z) * dims[1] + y) * dims[0] +
+                                   extent[0]) * scalarSize;
+                if (_empty[i])
+                {
+                    fillRow(row, scalarType, rowLength,
+                            _volume->brick(i).range[0]);
+                    continue;
+                }
+                const size_t offset =
+                    (size_t(voxels[2][z]) * previewDims[1] + voxels[1][y]) *
+                    previewDims[0];
+                upsampleRow(preview + offset * scalarSize, scalarType,
+                            &voxels[0][extent[0]], rowLength, row);
+            }
+    });
+    return image;
+}
+
+void AsyncVolumeLoader::_load()
+{
+    try
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            /* Everything is transparent, the preview is as good */
+            if (_pending.empty())
+                return;
+        }
+        /* The full resolution image is allocated here, the first frame
+           doesn't wait for it */
+        vtkSmartPointer<vtkImageData> image = _initializeFull();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _initialized = image;
+        }
+
+        while (true)
+        {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (!_stop && !_pending.empty() &&
+                       _ready.size() >= MAX_READY_BRICKS)
+                {
+                    _condition.wait(lock);
+                }
+                if (_stop || _pending.empty())
+                    return;
+                /* The highest priority brick is at the back */
+                index = _pending.back();
+                _pending.pop_back();
+            }
+
+            std::shared_ptr<std::vector<char>> data(
+                new std::vector<char>(_volume->brickBytes(index)));
+            _volume->decompress(index, &(*data)[0]);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ready.push_back(std::make_pair(index, data));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _error = e.what();
+        _failed = true;
+    }
+}
+
+void AsyncVolumeLoader::_sort(vtkCamera *camera, const double aspect)
+{
+    vtkMatrix4x4 *view =
+        camera->GetCompositeProjectionTransformMatrix(aspect, -1, 1);
+    std::copy(&view->Element[0][0], &view->Element[0][0] + 16, _view);
+
+    double planes[24];
+    camera->GetFrustumPlanes(aspect, planes);
+    double eye[3];
+    camera->GetPosition(eye);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::pair<double, size_t>> keys;
+    keys.reserve(_pending.size());
+    for (size_t i = 0; i != _pending.size(); ++i)
+    {
+        int extent[6];
+        _volume->brickExtent(_pending[i], extent);
+        double center[3];
+        double radius = 0;
+        for (int j = 0; j != 3; ++j)
+        {
+            const double low =
+                _volume->origin()[j] + extent[j * 2] * _volume->spacing()[j];
+            const double high =
+                _volume->origin()[j] + extent[j * 2 + 1] * _volume->spacing()[j];
+            center[j] = (low + high) * 0.5;
+            radius += (high - low) * (high - low) * 0.25;
+        }
+        radius = std::sqrt(radius);
+
+        bool visible = true;
+        for (int j = 0; j != 6 && visible; ++j)
+        {
+            const double *plane = planes + j * 4;
+            visible = (plane[0] * center[0] + plane[1] * center[1] +
+                       plane[2] * center[2] + plane[3]) >= -radius;
+        }
+        const double dx = center[0] - eye[0];
+        const double dy = center[1] - eye[1];
+        const double dz = center[2] - eye[2];
+        double key = std::sqrt(dx * dx + dy * dy + dz * dz);
+        /* Bricks outside the frustum go after all the visible ones */
+        if (!visible)
+            key += 1e30;
+        keys.push_back(std::make_pair(key, _pending[i]));
+    }
+    /* Descending order, the next brick to load is taken from the back */
+    std::sort(keys.rbegin(), keys.rend());
+    for (size_t i = 0; i != keys.size(); ++i)
+        _pending[i] = keys[i].second;
+}
+
+void AsyncVolumeLoader::_copy(const size_t index, const char *data)
+{
+    int extent[6];
+    _volume->brickExtent(index, extent);
+    const int *dims = _volume->dimensions();
+    const size_t scalarSize = _volume->scalarSize();
+    const size_t rowBytes = (extent[1] - extent[0] + 1) * scalarSize;
+    char *out = static_cast<char *>(_full->GetScalarPointer());
+    for (int z = extent[4]; z <= extent[5]; ++z)
+        for (int y = extent[2]; y <= extent[3]; ++y)
+        {
+            const size_t offset =
+                (size_t(z) * dims[1] + y) * dims[0] + extent[0];
+            memcpy(out + offset * scalarSize, data, rowBytes);
+            data += rowBytes;
+        }
+}
+
+}
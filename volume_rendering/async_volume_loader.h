@@ -0,0 +1,149 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VOLUME_RENDERING_ASYNC_VOLUME_LOADER_H
+#define VOLUME_RENDERING_ASYNC_VOLUME_LOADER_H
+
+#include "volume_pyramid.h"
+
+#include <vtkSmartPointer.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class vtkCamera;
+class vtkImageData;
+class vtkPiecewiseFunction;
+class vtkTrivialProducer;
+
+namespace volume
+{
+
+/**
+   Loads the full resolution level of a bricked volume in a background
+   thread.
+
+   The producer starts with a preview image whose size doesn't depend on
+   the volume size: the finest pyramid level within previewSize voxels
+   per side, or one voxel per brick with the brick minimum if the pyramid
+   has no coarse level small enough. The full resolution image is
+   allocated by the I/O thread, which initializes it upsampling the
+   preview, and replaces the preview once ready.
+
+   Then the I/O thread reads and decompresses bricks in order of
+   visibility, bricks inside the view frustum first and nearest to the
+   camera first. The thread only produces decompressed bricks, they are
+   copied into the image by update(), which must be called from the thread
+   that renders the image, so the mapper never reads an image being
+   written. The image is only marked as modified every 1/UPLOAD_STEPS of
+   the bricks, since each modification uploads the whole image again.
+ */
+class AsyncVolumeLoader
+{
+public:
+    static const int UPLOAD_STEPS = 10;
+
+    /**
+       @param opacity If given, bricks which are fully transparent under
+              this function are not loaded. The function is only evaluated
+              in the constructor.
+     */
+    AsyncVolumeLoader(const std::shared_ptr<VolumePyramid> &pyramid,
+                      vtkPiecewiseFunction *opacity = 0,
+                      int previewSize = 128);
+
+    /** Stops the I/O thread discarding the bricks not loaded yet */
+    ~AsyncVolumeLoader();
+
+    /** Source of the preview and then the full resolution image */
+    vtkTrivialProducer *producer() { return _producer; }
+    /** The image currently given by the producer */
+    vtkImageData *image() { return _full ? _full : _preview; }
+
+    /** Starts the I/O thread, bricks are prioritized for this camera. */
+    void start(vtkCamera *camera, double aspect);
+
+    /**
+       Changes the loading order of the remaining bricks for a new camera.
+       Does nothing if the camera hasn't changed since the last call.
+     */
+    void setCamera(vtkCamera *camera, double aspect);
+
+    /**
+       Switches to the full resolution image when it's ready and copies the
+       bricks loaded since the last call into it. Returns true if the
+       producer output changed and needs to be rendered again.
+     */
+    bool update();
+
+    size_t loadedBrickCount() const { return _loaded; }
+    size_t brickCount() const { return _volume->brickCount(); }
+    /** True once all the bricks are in the image or loading failed */
+    bool finished() const
+        { return _failed || _loaded == _volume->brickCount(); }
+    /** True if the I/O thread stopped on an error, see error() */
+    bool failed() const { return _failed; }
+    std::string error() const;
+    /** Fraction of the bricks already copied in the image */
+    double progress() const;
+
+private:
+    typedef std::pair<size_t, std::shared_ptr<std::vector<char>>> LoadedBrick;
+
+    std::shared_ptr<VolumePyramid> _pyramid;
+    std::shared_ptr<BrickedVolume> _volume;
+    vtkSmartPointer<vtkTrivialProducer> _producer;
+    vtkSmartPointer<vtkImageData> _preview;
+    vtkSmartPointer<vtkImageData> _full;
+    std::vector<char> _empty;
+    size_t _loaded;
+    /* Value of _loaded when the image was last marked as modified */
+    size_t _uploaded;
+    /* Composite projection matrix of the last sort */
+    double _view[16];
+
+    std::thread _thread;
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    std::atomic<bool> _stop;
+    std::atomic<bool> _failed;
+    /* Protected by _mutex */
+    std::string _error;
+    /* Full resolution image initialized by the I/O thread and not yet
+       taken by update(), protected by _mutex */
+    vtkSmartPointer<vtkImageData> _initialized;
+    /* Remaining bricks sorted by priority, protected by _mutex */
+    std::vector<size_t> _pending;
+    std::deque<LoadedBrick> _ready;
+
+    void _makePreview(vtkPiecewiseFunction *opacity, int previewSize);
+    vtkSmartPointer<vtkImageData> _initializeFull() const;
+    void _load();
+    void _sort(vtkCamera *camera, double aspect);
+    void _copy(size_t index, const char *data);
+};
+
+}
+
+#endif
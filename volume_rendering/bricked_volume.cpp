@@ -0,0 +1,386 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "bricked_volume.h"
+
+#include "common/binary_io.h"
+#include "common/parallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSetGet.h>
+#include <vtk_zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace volume
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'V', 'T', 'K', 'D', 'B', 'V', 'O', 'L'};
+const uint32_t VERSION = 1;
+
+std::atomic<uint64_t> nextVolumeId(0);
+
+template<typename T>
+void computeRange(const T *data, size_t count, double range[2])
+{
+    T min = data[0];
+    T max = data[0];
+    for (size_t i = 1; i < count; ++i)
+    {
+        min = std::min(min, data[i]);
+        max = std::max(max, data[i]);
+    }
+    range[0] = min;
+    range[1] = max;
+}
+
+/* Size of the fixed part of the header as written by BrickedVolume::write */
+const size_t HEADER_SIZE =
+    sizeof(MAGIC) + sizeof(uint32_t) + sizeof(int32_t) * 6 +
+    sizeof(double) * 8 + sizeof(uint64_t);
+const size_t BRICK_ENTRY_SIZE = sizeof(uint64_t) * 2 + sizeof(double) * 2;
+
+}
+
+void BrickedVolume::write(vtkImageData *image, const std::string &filename,
+                          const int brickSize, const int compressionLevel)
+{
+    vtkDataArray *scalars = image->GetPointData()->GetScalars();
+    if (!scalars || scalars->GetNumberOfComponents() != 1)
+        throw std::runtime_error(
+            "Bricked volumes require single component point scalars");
+    if (brickSize <= 0)
+        throw std::runtime_error("Invalid brick size");
+
+    const int scalarType = scalars->GetDataType();
+    const int scalarSize = scalars->GetDataTypeSize();
+    int dimensions[3];
+    image->GetDimensions(dimensions);
+    int counts[3];
+    for (int i = 0; i != 3; ++i)
+        counts[i] = (dimensions[i] + brickSize - 1) / brickSize;
+    const size_t brickCount = size_t(counts[0]) * counts[1] * counts[2];
+    const char *source = static_cast<const char *>(scalars->GetVoidPointer(0));
+
+    std::vector<Brick> bricks(brickCount);
+    std::vector<std::vector<Bytef>> payloads(brickCount);
+
+    common::parallelFor(0, brickCount, [&](const size_t index)
+    {
+        const int bx = index % counts[0];
+        const int by = (index / counts[0]) % counts[1];
+        const int bz = index / (size_t(counts[0]) * counts[1]);
+        const int x0 = bx * brickSize;
+        const int y0 = by * brickSize;
+        const int z0 = bz * brickSize;
+        const int nx = std::min(brickSize, dimensions[0] - x0);
+        const int ny = std::min(brickSize, dimensions[1] - y0);
+        const int nz = std::min(brickSize, dimensions[2] - z0);
+
+        /* Gathering the brick voxels in a contiguous buffer */
+        const size_t rowBytes = size_t(nx) * scalarSize;
+        std::vector<char> voxels(rowBytes * ny * nz);
+        char *out = &voxels[0];
+        for (int z = z0; z != z0 + nz; ++z)
+            for (int y = y0; y != y0 + ny; ++y)
+            {
+                const size_t offset =
+                    (size_t(z) * dimensions[1] + y) * dimensions[0] + x0;
+                memcpy(out, source + offset * scalarSize, rowBytes);
+                out += rowBytes;
+            }
+
+        const size_t voxelCount = size_t(nx) * ny * nz;
+        switch (scalarType)
+        {
+            vtkTemplateMacro(
+                computeRange(reinterpret_cast<VTK_TT *>(&voxels[0]),
+                             voxelCount, bricks[index].range));
+        default:
+            throw std::runtime_error("Unsupported scalar type");
+        }
+
+        std::vector<Bytef> &payload = payloads[index];
+        uLongf size = compressBound(voxels.size());
+        payload.resize(size);
+        if (compress2(&payload[0], &size,
+                      reinterpret_cast<const Bytef *>(&voxels[0]),
+                      voxels.size(), compressionLevel) != Z_OK)
+        {
+            throw std::runtime_error("Error compressing brick");
+        }
+        payload.resize(size);
+        bricks[index].compressedSize = size;
+    });
+
+    uint64_t offset = HEADER_SIZE + BRICK_ENTRY_SIZE * brickCount;
+    double range[2] = {std::numeric_limits<double>::max(),
+                       -std::numeric_limits<double>::max()};
+    for (size_t i = 0; i != brickCount; ++i)
+    {
+        bricks[i].offset = offset;
+        offset += bricks[i].compressedSize;
+        range[0] = std::min(range[0], bricks[i].range[0]);
+        range[1] = std::max(range[1], bricks[i].range[1]);
+    }
+
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Could not open file " + filename);
+    file.write(MAGIC, sizeof(MAGIC));
+    common::writeValue(file, VERSION);
+    common::writeValue(file, int32_t(scalarType));
+    common::writeValue(file, int32_t(scalarSize));
+    for (int i = 0; i != 3; ++i)
+        common::writeValue(file, int32_t(dimensions[i]));
+    common::writeValue(file, int32_t(brickSize));
+    for (int i = 0; i != 3; ++i)
+        common::writeValue(file, image->GetSpacing()[i]);
+    for (int i = 0; i != 3; ++i)
+        common::writeValue(file, image->GetOrigin()[i]);
+    common::writeValue(file, range[0]);
+    common::writeValue(file, range[1]);
+    common::writeValue(file, uint64_t(brickCount));
+    for (size_t i = 0; i != brickCount; ++i)
+    {
+        common::writeValue(file, bricks[i].offset);
+        common::writeValue(file, bricks[i].compressedSize);
+        common::writeValue(file, bricks[i].range[0]);
+        common::writeValue(file, bricks[i].range[1]);
+    }
+    for (size_t i = 0; i != brickCount; ++i)
+        file.write(reinterpret_cast<const char *>(&payloads[i][0]),
+                   payloads[i].size());
+
+    if (file.fail())
+        throw std::runtime_error("Error writing file " + filename);
+}
+
+BrickedVolume::BrickedVolume(const std::string &filename)
+    : _id(nextVolumeId++)
+    , _fd(open(filename.c_str(), O_RDONLY))
+    , _filename(filename)
+{
+    if (_fd == -1)
+        throw std::runtime_error("Could not open file " + filename);
+
+    try
+    {
+        std::vector<char> header(HEADER_SIZE);
+        common::preadAll(_fd, &header[0], HEADER_SIZE, 0, filename);
+        if (memcmp(&header[0], MAGIC, sizeof(MAGIC)) != 0)
+            throw std::runtime_error(filename + " is not a bricked volume");
+
+        const char *in = &header[0] + sizeof(MAGIC);
+        uint32_t version;
+        in = common::readValue(in, version);
+        if (version != VERSION)
+            throw std::runtime_error("Unsupported bricked volume version");
+
+        int32_t value;
+        in = common::readValue(in, value);
+        _scalarType = value;
+        in = common::readValue(in, value);
+        _scalarSize = value;
+        for (int i = 0; i != 3; ++i)
+        {
+            in = common::readValue(in, value);
+            _dimensions[i] = value;
+        }
+        in = common::readValue(in, value);
+        _brickSize = value;
+        for (int i = 0; i != 3; ++i)
+            in = common::readValue(in, _spacing[i]);
+        for (int i = 0; i != 3; ++i)
+            in = common::readValue(in, _origin[i]);
+        in = common::readValue(in, _range[0]);
+        in = common::readValue(in, _range[1]);
+        uint64_t brickCount;
+        in = common::readValue(in, brickCount);
+
+        for (int i = 0; i != 3; ++i)
+            _brickCounts[i] = (_dimensions[i] + _brickSize - 1) / _brickSize;
+        if (brickCount !=
+            uint64_t(_brickCounts[0]) * _brickCounts[1] * _brickCounts[2])
+        {
+            throw std::runtime_error("Corrupt brick table in " + filename);
+        }
+
+        std::vector<char> table(BRICK_ENTRY_SIZE * brickCount);
+        common::preadAll(_fd, &table[0], table.size(), HEADER_SIZE, filename);
+        _bricks.resize(brickCount);
+        in = &table[0];
+        for (size_t i = 0; i != brickCount; ++i)
+        {
+            in = common::readValue(in, _bricks[i].offset);
+            in = common::readValue(in, _bricks[i].compressedSize);
+            in = common::readValue(in, _bricks[i].range[0]);
+            in = common::readValue(in, _bricks[i].range[1]);
+        }
+    }
+    catch (...)
+    {
+        close(_fd);
+        throw;
+    }
+}
+
+BrickedVolume::~BrickedVolume()
+{
+    close(_fd);
+}
+
+void BrickedVolume::brickExtent(const size_t index, int extent[6]) const
+{
+    const int brick[3] = {
+        int(index % _brickCounts[0]),
+        int((index / _brickCounts[0]) % _brickCounts[1]),
+        int(index / (size_t(_brickCounts[0]) * _brickCounts[1]))};
+    for (int i = 0; i != 3; ++i)
+    {
+        extent[i * 2] = brick[i] * _brickSize;
+        extent[i * 2 + 1] =
+            std::min((brick[i] + 1) * _brickSize, _dimensions[i]) - 1;
+    }
+}
+
+size_t BrickedVolume::brickBytes(const size_t index) const
+{
+    int extent[6];
+    brickExtent(index, extent);
+    return (size_t(extent[1] - extent[0] + 1) * (extent[3] - extent[2] + 1) *
+            (extent[5] - extent[4] + 1) * _scalarSize);
+}
+
+void BrickedVolume::decompress(const size_t index, void *out) const
+{
+    const Brick &brick = _bricks[index];
+    std::vector<Bytef> payload(brick.compressedSize);
+    common::preadAll(_fd, &payload[0], payload.size(), brick.offset,
+                     _filename);
+
+    uLongf size = brickBytes(index);
+    if (uncompress(static_cast<Bytef *>(out), &size,
+                   &payload[0], payload.size()) != Z_OK ||
+        size != brickBytes(index))
+    {
+        throw std::runtime_error("Corrupt brick in " + _filename);
+    }
+}
+
+size_t BrickedVolume::compressedBytes() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i != _bricks.size(); ++i)
+        total += _bricks[i].compressedSize;
+    return total;
+}
+
+BrickCache::BrickCache(const size_t capacity)
+    : _capacity(capacity)
+    , _size(0)
+    , _hits(0)
+    , _misses(0)
+{
+}
+
+BrickCache::BrickData BrickCache::get(const BrickedVolume &volume,
+                                      const size_t index)
+{
+    const Key key(volume.id(), index);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::map<Key, LRUList::iterator>::iterator entry = _entries.find(key);
+        if (entry != _entries.end())
+        {
+            ++_hits;
+            /* Moving the entry to the front of the LRU list */
+            _lru.splice(_lru.begin(), _lru, entry->second);
+            return entry->second->second;
+        }
+        ++_misses;
+    }
+
+    std::shared_ptr<std::vector<char>> data(
+        new std::vector<char>(volume.brickBytes(index)));
+    volume.decompress(index, &(*data)[0]);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    /* Another thread may have decompressed the same brick meanwhile */
+    std::map<Key, LRUList::iterator>::iterator entry = _entries.find(key);
+    if (entry != _entries.end())
+        return entry->second->second;
+    _insert(key, data);
+    return data;
+}
+
+void BrickCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _lru.clear();
+    _entries.clear();
+    _size = 0;
+}
+
+size_t BrickCache::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _size;
+}
+
+size_t BrickCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hits;
+}
+
+size_t BrickCache::misses() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _misses;
+}
+
+void BrickCache::_insert(const Key &key, const BrickData &data)
+{
+    _lru.push_front(std::make_pair(key, data));
+    _entries[key] = _lru.begin();
+    _size += data->size();
+
+    /* Evicting least recently used bricks, keeping at least the new one */
+    while (_size > _capacity && _lru.size() > 1)
+    {
+        _size -= _lru.back().second->size();
+        _entries.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+}
+
+}
@@ -0,0 +1,176 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VOLUME_RENDERING_BRICKED_VOLUME_H
+#define VOLUME_RENDERING_BRICKED_VOLUME_H
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class vtkImageData;
+
+namespace volume
+{
+
+/**
+   A single component scalar volume split in cubic bricks which are
+   compressed independently and stored in a single file.
+
+   The file has a small header with the volume geometry followed by a brick
+   table and the compressed payloads. Only the header and the table are
+   kept in memory, brick payloads are read and decompressed on demand.
+   The brick table also stores the value range of each brick, this way
+   bricks which are fully transparent under a transfer function can be
+   skipped without reading them.
+ */
+class BrickedVolume
+{
+public:
+    struct Brick
+    {
+        uint64_t offset;
+        uint64_t compressedSize;
+        double range[2];
+    };
+
+    /**
+       Splits a volume in bricks, compresses them in parallel and writes the
+       result to a file.
+       @param image The input volume. Only the active point scalars are
+              stored, they must have a single component.
+       @param brickSize Edge length in voxels of the bricks.
+       @param compressionLevel zlib compression level, 1 trades compression
+              ratio for speed.
+     */
+    static void write(vtkImageData *image, const std::string &filename,
+                      int brickSize = 64, int compressionLevel = 1);
+
+    /**
+       Opens a bricked volume file reading only its header and brick table.
+       Throws std::runtime_error if the file can't be opened or is not a
+       bricked volume.
+     */
+    explicit BrickedVolume(const std::string &filename);
+
+    ~BrickedVolume();
+
+    /** VTK scalar type of the voxels (e.g. VTK_UNSIGNED_CHAR) */
+    int scalarType() const { return _scalarType; }
+    int scalarSize() const { return _scalarSize; }
+    const int *dimensions() const { return _dimensions; }
+    const double *spacing() const { return _spacing; }
+    const double *origin() const { return _origin; }
+    /** Value range of the whole volume */
+    const double *range() const { return _range; }
+
+    int brickSize() const { return _brickSize; }
+    /** Number of bricks along each axis */
+    const int *brickCounts() const { return _brickCounts; }
+    size_t brickCount() const { return _bricks.size(); }
+    const Brick &brick(size_t index) const { return _bricks[index]; }
+
+    /** Voxel extent covered by a brick, in VTK extent notation */
+    void brickExtent(size_t index, int extent[6]) const;
+    /** Size in bytes of the decompressed brick */
+    size_t brickBytes(size_t index) const;
+
+    /**
+       Reads and decompresses a brick into out, which must be at least
+       brickBytes(index) large. Voxels are stored x fastest.
+       Thread safe.
+     */
+    void decompress(size_t index, void *out) const;
+
+    size_t compressedBytes() const;
+
+    /** Serial number unique to this instance in the process, never
+        reused by another volume */
+    uint64_t id() const { return _id; }
+
+private:
+    uint64_t _id;
+    int _fd;
+    std::string _filename;
+    int _scalarType;
+    int _scalarSize;
+    int _dimensions[3];
+    double _spacing[3];
+    double _origin[3];
+    double _range[2];
+    int _brickSize;
+    int _brickCounts[3];
+    std::vector<Brick> _bricks;
+
+    BrickedVolume(const BrickedVolume &);
+    BrickedVolume &operator=(const BrickedVolume &);
+};
+
+/**
+   LRU cache of decompressed bricks shared by all the consumers of one or
+   more bricked volumes.
+
+   The capacity is given in bytes. Bricks being used by a consumer are
+   reference counted, so eviction never invalidates data in use.
+ */
+class BrickCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<char>> BrickData;
+
+    explicit BrickCache(size_t capacity);
+
+    /**
+       Returns the decompressed data of a brick, decompressing it if it is
+       not in the cache. Thread safe, decompression happens outside the
+       cache lock.
+     */
+    BrickData get(const BrickedVolume &volume, size_t index);
+
+    void clear();
+
+    size_t capacity() const { return _capacity; }
+    size_t size() const;
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    /* The volume id and the brick index. Addresses of destroyed volumes
+       can be reused, ids are not. */
+    typedef std::pair<uint64_t, size_t> Key;
+    typedef std::list<std::pair<Key, BrickData>> LRUList;
+
+    size_t _capacity;
+    size_t _size;
+    size_t _hits;
+    size_t _misses;
+    LRUList _lru;
+    std::map<Key, LRUList::iterator> _entries;
+    mutable std::mutex _mutex;
+
+    void _insert(const Key &key, const BrickData &data);
+};
+
+}
+
+#endif
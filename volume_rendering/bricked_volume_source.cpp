@@ -0,0 +1,363 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "bricked_volume_source.h"
+
+#include "common/parallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPointData.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace volume
+{
+
+namespace
+{
+
+template<typename T>
+void fill(T *out, const size_t count, const double value)
+{
+    std::fill(out, out + count, T(value));
+}
+
+/* Nearest neighbour upsampling of a row of a coarse brick. Voxel x of the
+   output row takes the voxel (x >> shift) - inStart of the input row. */
+template<typename T>
+void upsample(T *out, const size_t count, const T *in,
+              const int start, const int shift, const int inStart)
+{
+    for (size_t x = 0; x != count; ++x)
+        out[x] = in[((start + int(x)) >> shift) - inStart];
+}
+
+void upsample(const size_t scalarSize, char *out, const size_t count,
+              const char *in, const int start, const int shift,
+              const int inStart)
+{
+    switch (scalarSize)
+    {
+    case 1:
+        upsample(reinterpret_cast<uint8_t *>(out), count,
+                 reinterpret_cast<const uint8_t *>(in), start, shift, inStart);
+        break;
+    case 2:
+        upsample(reinterpret_cast<uint16_t *>(out), count,
+                 reinterpret_cast<const uint16_t *>(in), start, shift, inStart);
+        break;
+    case 4:
+        upsample(reinterpret_cast<uint32_t *>(out), count,
+                 reinterpret_cast<const uint32_t *>(in), start, shift, inStart);
+        break;
+    default:
+        upsample(reinterpret_cast<uint64_t *>(out), count,
+                 reinterpret_cast<const uint64_t *>(in), start, shift, inStart);
+    }
+}
+
+}
+
+vtkStandardNewMacro(BrickedVolumeSource);
+
+BrickedVolumeSource::BrickedVolumeSource()
+    : _opacity(0)
+    , _skipped(0)
+    , _loaded(0)
+{
+    SetNumberOfInputPorts(0);
+}
+
+BrickedVolumeSource::~BrickedVolumeSource()
+{
+    if (_opacity)
+        _opacity->UnRegister(this);
+}
+
+void BrickedVolumeSource::SetVolume(
+    const std::shared_ptr<BrickedVolume> &volume)
+{
+    SetPyramid(std::make_shared<VolumePyramid>(volume));
+}
+
+void BrickedVolumeSource::SetPyramid(
+    const std::shared_ptr<VolumePyramid> &pyramid)
+{
+    _pyramid = pyramid;
+    _levels.clear();
+    Modified();
+}
+
+void BrickedVolumeSource::SetBrickLevels(const std::vector<int> &levels)
+{
+    if (levels == _levels)
+        return;
+    _levels = levels;
+    Modified();
+}
+
+int BrickedVolumeSource::GetOutputLevel() const
+{
+    if (_levels.empty())
+        return 0;
+    return *std::min_element(_levels.begin(), _levels.end());
+}
+
+void BrickedVolumeSource::SetCache(const std::shared_ptr<BrickCache> &cache)
+{
+    _cache = cache;
+    Modified();
+}
+
+void BrickedVolumeSource::SetOpacityFunction(vtkPiecewiseFunction *function)
+{
+    if (_opacity == function)
+        return;
+    if (_opacity)
+        _opacity->UnRegister(this);
+    _opacity = function;
+    if (_opacity)
+        _opacity->Register(this);
+    Modified();
+}
+
+unsigned long BrickedVolumeSource::GetMTime()
+{
+    unsigned long time = Superclass::GetMTime();
+    if (_opacity)
+        time = std::max(time, _opacity->GetMTime());
+    return time;
+}
+
+int BrickedVolumeSource::RequestInformation(vtkInformation *,
+                                            vtkInformationVector **,
+                                            vtkInformationVector *outputVector)
+{
+    if (!_pyramid)
+    {
+        vtkErrorMacro("No bricked volume set");
+        return 0;
+    }
+    if (!_levels.empty() && _levels.size() != GetVolume()->brickCount())
+    {
+        vtkErrorMacro("Brick levels don't match the volume");
+        return 0;
+    }
+
+    const BrickedVolume &volume = _pyramid->level(GetOutputLevel());
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+    const int *dimensions = volume.dimensions();
+    int extent[6] = {0, dimensions[0] - 1,
+                     0, dimensions[1] - 1,
+                     0, dimensions[2] - 1};
+    outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), extent, 6);
+    outInfo->Set(vtkDataObject::SPACING(), volume.spacing(), 3);
+    outInfo->Set(vtkDataObject::ORIGIN(), volume.origin(), 3);
+    vtkDataObject::SetPointDataActiveScalarInfo(
+        outInfo, volume.scalarType(), 1);
+    return 1;
+}
+
+int BrickedVolumeSource::RequestData(vtkInformation *,
+                                     vtkInformationVector **,
+                                     vtkInformationVector *outputVector)
+{
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+    vtkImageData *output =
+        vtkImageData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+
+    const int outputLevel = GetOutputLevel();
+    const BrickedVolume &volume = _pyramid->level(outputLevel);
+    int extent[6];
+    outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), extent);
+    output->SetExtent(extent);
+    output->SetSpacing(volume.spacing());
+    output->SetOrigin(volume.origin());
+    output->AllocateScalars(volume.scalarType(), 1);
+    output->GetPointData()->GetScalars()->SetName("scalars");
+
+    if (!_cache)
+        _cache.reset(new BrickCache(size_t(512) << 20));
+
+    /* Finding the bricks of the output level that overlap the update extent
+       and the level from which each one is going to be filled. That level
+       is the finest one among the level 0 bricks it covers. */
+    const BrickedVolume &finest = _pyramid->level(0);
+    const int *finestCounts = finest.brickCounts();
+    std::vector<std::pair<size_t, int>> bricks;
+    for (size_t i = 0; i != volume.brickCount(); ++i)
+    {
+        int brick[6];
+        volume.brickExtent(i, brick);
+        if (brick[0] > extent[1] || brick[1] < extent[0] ||
+            brick[2] > extent[3] || brick[3] < extent[2] ||
+            brick[4] > extent[5] || brick[5] < extent[4])
+        {
+            continue;
+        }
+
+        int level = outputLevel;
+        if (!_levels.empty())
+        {
+            level = _pyramid->levelCount() - 1;
+            const int *counts = volume.brickCounts();
+            const int b[3] = {int(i % counts[0]),
+                              int((i / counts[0]) % counts[1]),
+                              int(i / (size_t(counts[0]) * counts[1]))};
+            const int span = 1 << outputLevel;
+            for (int z = b[2] * span;
+                 z < std::min((b[2] + 1) * span, finestCounts[2]); ++z)
+                for (int y = b[1] * span;
+                     y < std::min((b[1] + 1) * span, finestCounts[1]); ++y)
+                    for (int x = b[0] * span;
+                         x < std::min((b[0] + 1) * span, finestCounts[0]);
+                         ++x)
+                    {
+                        const size_t index =
+                            (size_t(z) * finestCounts[1] + y) *
+                            finestCounts[0] + x;
+                        level = std::min(level, _levels[index]);
+                    }
+        }
+        bricks.push_back(std::make_pair(i, level));
+    }
+
+    /* Source brick, in its own level, of each output brick */
+    std::vector<size_t> sources(bricks.size());
+    for (size_t i = 0; i != bricks.size(); ++i)
+    {
+        const int *counts = volume.brickCounts();
+        const size_t index = bricks[i].first;
+        const int shift = bricks[i].second - outputLevel;
+        const int *sourceCounts =
+            _pyramid->level(bricks[i].second).brickCounts();
+        const int b[3] = {int(index % counts[0]) >> shift,
+                          int((index / counts[0]) % counts[1]) >> shift,
+                          int(index / (size_t(counts[0]) * counts[1])) >> shift};
+        sources[i] = (size_t(b[2]) * sourceCounts[1] + b[1]) *
+                     sourceCounts[0] + b[0];
+    }
+
+    /* The opacity test is done upfront because the transfer function
+       is not meant to be evaluated from several threads. */
+    std::vector<char> skipped(bricks.size(), 0);
+    if (_opacity)
+    {
+        for (size_t i = 0; i != bricks.size(); ++i)
+        {
+            const BrickedVolume::Brick &info =
+                _pyramid->level(bricks[i].second).brick(sources[i]);
+            skipped[i] =
+                maximumOpacity(_opacity, info.range[0], info.range[1]) == 0;
+        }
+    }
+
+    const int scalarType = volume.scalarType();
+    const size_t scalarSize = volume.scalarSize();
+    char *out = static_cast<char *>(output->GetScalarPointer());
+    const size_t outRow = size_t(extent[1] - extent[0] + 1);
+    const size_t outSlice = outRow * (extent[3] - extent[2] + 1);
+
+    common::parallelFor(0, bricks.size(), [&](const size_t i)
+    {
+        const BrickedVolume &source = _pyramid->level(bricks[i].second);
+        const int shift = bricks[i].second - outputLevel;
+        int brick[6];
+        volume.brickExtent(bricks[i].first, brick);
+        int clip[6];
+        for (int j = 0; j != 3; ++j)
+        {
+            clip[j * 2] = std::max(brick[j * 2], extent[j * 2]);
+            clip[j * 2 + 1] = std::min(brick[j * 2 + 1], extent[j * 2 + 1]);
+        }
+        const size_t rowLength = clip[1] - clip[0] + 1;
+
+        if (skipped[i])
+        {
+            const double value = source.brick(sources[i]).range[0];
+            for (int z = clip[4]; z <= clip[5]; ++z)
+                for (int y = clip[2]; y <= clip[3]; ++y)
+                {
+                    char *row = out + ((z - extent[4]) * outSlice +
+                                       (y - extent[2]) * outRow +
+                                       (clip[0] - extent[0])) * scalarSize;
+                    switch (scalarType)
+                    {
+                        vtkTemplateMacro(
+                            fill(reinterpret_cast<VTK_TT *>(row), rowLength,
+                                 value));
+                    }
+                }
+            return;
+        }
+
+        const BrickCache::BrickData data = _cache->get(source, sources[i]);
+        int in[6];
+        source.brickExtent(sources[i], in);
+        const size_t inRow = size_t(in[1] - in[0] + 1);
+        const size_t inSlice = inRow * (in[3] - in[2] + 1);
+        for (int z = clip[4]; z <= clip[5]; ++z)
+            for (int y = clip[2]; y <= clip[3]; ++y)
+            {
+                const char *inRowData =
+                    &(*data)[0] + (((z >> shift) - in[4]) * inSlice +
+                                   ((y >> shift) - in[2]) * inRow) *
+                                  scalarSize;
+                char *outRowData = out + ((z - extent[4]) * outSlice +
+                                          (y - extent[2]) * outRow +
+                                          (clip[0] - extent[0])) * scalarSize;
+                if (shift == 0)
+                    memcpy(outRowData,
+                           inRowData + (clip[0] - in[0]) * scalarSize,
+                           rowLength * scalarSize);
+                else
+                    upsample(scalarSize, outRowData, rowLength, inRowData,
+                             clip[0], shift, in[0]);
+            }
+    });
+
+    _skipped = std::count(skipped.begin(), skipped.end(), 1);
+    _loaded = bricks.size() - _skipped;
+    return 1;
+}
+
+double maximumOpacity(vtkPiecewiseFunction *function,
+                      const double min, const double max)
+{
+    /* Between two nodes the function is monotonic, so its maximum in the
+       range is at the range ends or at one of the nodes inside it. */
+    double opacity = std::max(function->GetValue(min), function->GetValue(max));
+    for (int i = 0; i < function->GetSize(); ++i)
+    {
+        double node[4];
+        function->GetNodeValue(i, node);
+        if (node[0] > min && node[0] < max)
+            opacity = std::max(opacity, node[1]);
+    }
+    return opacity;
+}
+
+}
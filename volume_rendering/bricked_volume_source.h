@@ -0,0 +1,127 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VOLUME_RENDERING_BRICKED_VOLUME_SOURCE_H
+#define VOLUME_RENDERING_BRICKED_VOLUME_SOURCE_H
+
+#include "volume_pyramid.h"
+
+#include <vtkImageAlgorithm.h>
+
+class vtkPiecewiseFunction;
+
+namespace volume
+{
+
+/**
+   Image source that feeds a volume mapper from a BrickedVolume or a
+   VolumePyramid.
+
+   The requested update extent is assembled from the bricks it overlaps,
+   which are taken from a BrickCache. If an opacity transfer function is
+   given, bricks whose value range maps to zero opacity are not read nor
+   decompressed, their region is filled with the brick minimum instead,
+   which is transparent as well.
+
+   With a pyramid, each level 0 brick can be assigned a different level.
+   The output grid has the resolution of the finest level in use and the
+   regions assigned to coarser levels are upsampled (nearest neighbour)
+   from the coarse bricks, so they cost less I/O and decompression.
+
+   The output is a regular vtkImageData with the whole update extent
+   decompressed, and the VTK 6 volume mappers always request the whole
+   extent. Only the compressed bricks stay out of memory, the output grid
+   has to fit in RAM. A volume larger than that can only be rendered from
+   a coarser pyramid level (see VolumePyramid::levelForBudget).
+ */
+class BrickedVolumeSource : public vtkImageAlgorithm
+{
+public:
+    static BrickedVolumeSource *New();
+    vtkTypeMacro(BrickedVolumeSource, vtkImageAlgorithm);
+
+    void SetVolume(const std::shared_ptr<BrickedVolume> &volume);
+    const std::shared_ptr<BrickedVolume> &GetVolume() const
+        { return _pyramid->levelPointer(0); }
+
+    void SetPyramid(const std::shared_ptr<VolumePyramid> &pyramid);
+    const std::shared_ptr<VolumePyramid> &GetPyramid() const
+        { return _pyramid; }
+
+    /**
+       Sets the pyramid level for each brick of level 0 (see selectLevels).
+       An empty vector, the default, selects level 0 everywhere.
+       The source is only modified if the levels change.
+     */
+    void SetBrickLevels(const std::vector<int> &levels);
+    const std::vector<int> &GetBrickLevels() const { return _levels; }
+
+    /** Pyramid level of the output grid */
+    int GetOutputLevel() const;
+
+    /** If not set, a private cache of 512 MB is used */
+    void SetCache(const std::shared_ptr<BrickCache> &cache);
+    const std::shared_ptr<BrickCache> &GetCache() const { return _cache; }
+
+    /**
+       Transfer function used to skip empty bricks. Changes in the function
+       make the source re-execute.
+     */
+    void SetOpacityFunction(vtkPiecewiseFunction *function);
+    vtkPiecewiseFunction *GetOpacityFunction() { return _opacity; }
+
+    /** Bricks skipped by the opacity test in the last execution */
+    size_t GetSkippedBrickCount() const { return _skipped; }
+    /** Bricks copied from the cache in the last execution */
+    size_t GetLoadedBrickCount() const { return _loaded; }
+
+    virtual unsigned long GetMTime();
+
+protected:
+    BrickedVolumeSource();
+    ~BrickedVolumeSource();
+
+    virtual int RequestInformation(vtkInformation *request,
+                                   vtkInformationVector **inputVector,
+                                   vtkInformationVector *outputVector);
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    std::shared_ptr<VolumePyramid> _pyramid;
+    std::shared_ptr<BrickCache> _cache;
+    std::vector<int> _levels;
+    vtkPiecewiseFunction *_opacity;
+    size_t _skipped;
+    size_t _loaded;
+
+    BrickedVolumeSource(const BrickedVolumeSource &);
+    void operator=(const BrickedVolumeSource &);
+};
+
+/**
+   Maximum opacity that a piecewise transfer function assigns to any value
+   in [min, max].
+ */
+double maximumOpacity(vtkPiecewiseFunction *function, double min, double max);
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "mapped_structured_points_reader.h"
+#include "quantized_gradients.h"
+#include "volume_pyramid.h"
+
+#include <vtkAlgorithm.h>
+#include <vtkDataSetReader.h>
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Converts a VTK structured points file into a bricked volume and the
+   coarser levels of its multiresolution pyramid. With --gradients, the
+   quantized gradient volume used for shading is also stored, bricked in
+   the same way, next to the output. */
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    bool gradients = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--gradients")
+            gradients = true;
+        else
+            args.push_back(argv[i]);
+    }
+    if (args.size() < 2)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--gradients] input.vtk output.bvol"
+                  << " [brick_size [level]]" << std::endl;
+        return 1;
+    }
+    const std::string input = args[0];
+    const std::string output = args[1];
+    const int brickSize = args.size() > 2 ? atoi(args[2].c_str()) : 64;
+    const int level = args.size() > 3 ? atoi(args[3].c_str()) : 1;
+
+    /* Mapping the input when possible, this way volumes larger than the
+       physical memory can be converted. */
+    vtkSmartPointer<vtkAlgorithm> reader;
+    if (volume::MappedStructuredPointsReader::CanReadFile(input))
+    {
+        vtkSmartPointer<volume::MappedStructuredPointsReader> mappedReader =
+            vtkSmartPointer<volume::MappedStructuredPointsReader>::New();
+        mappedReader->SetFileName(input);
+        reader = mappedReader;
+    }
+    else
+    {
+        vtkSmartPointer<vtkDataSetReader> dataSetReader =
+            vtkSmartPointer<vtkDataSetReader>::New();
+        dataSetReader->SetFileName(input.c_str());
+        reader = dataSetReader;
+    }
+    reader->Update();
+    vtkImageData *image =
+        vtkImageData::SafeDownCast(reader->GetOutputDataObject(0));
+    if (!image)
+    {
+        std::cerr << input << " is not a structured points file"
+                  << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        const std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        volume::VolumePyramid::write(image, output, brickSize, level);
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        volume::VolumePyramid pyramid(output);
+        for (size_t i = 0; i != pyramid.levelCount(); ++i)
+        {
+            const volume::BrickedVolume &bricked = pyramid.level(i);
+            const int *dims = bricked.dimensions();
+            const size_t raw =
+                size_t(dims[0]) * dims[1] * dims[2] * bricked.scalarSize();
+            std::cout << "Level " << i << ": " << dims[0] << "x" << dims[1]
+                      << "x" << dims[2] << ", " << bricked.brickCount()
+                      << " bricks, " << raw << " bytes compressed to "
+                      << bricked.compressedBytes() << std::endl;
+        }
+        std::cout << "Written in " << seconds << " s" << std::endl;
+
+        if (gradients)
+        {
+            const std::chrono::steady_clock::time_point gradientStart =
+                std::chrono::steady_clock::now();
+            vtkSmartPointer<vtkImageData> packed =
+                volume::computeGradients(image);
+            const double computeSeconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - gradientStart).count();
+            const std::string filename = volume::gradientFilename(output);
+            volume::BrickedVolume::write(packed, filename, brickSize);
+            const volume::BrickedVolume bricked(filename);
+            std::cout << "Gradients computed in " << computeSeconds
+                      << " s, " << bricked.compressedBytes()
+                      << " bytes compressed" << std::endl;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
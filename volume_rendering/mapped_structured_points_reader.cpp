@@ -0,0 +1,398 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "mapped_structured_points_reader.h"
+
+#include "common/mapped_file.h"
+#include "common/parallel.h"
+
+#include <vtkConfigure.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace volume
+{
+
+namespace
+{
+
+/* Values swapped per parallel chunk */
+const size_t SWAP_CHUNK = 1 << 20;
+
+class Tokenizer
+{
+public:
+    Tokenizer(const char *data, size_t size)
+        : _position(data)
+        , _end(data + size)
+    {}
+
+    std::string next()
+    {
+        while (_position != _end && isspace(*_position))
+            ++_position;
+        const char *start = _position;
+        while (_position != _end && !isspace(*_position))
+            ++_position;
+        return std::string(start, _position);
+    }
+
+    std::string nextLower()
+    {
+        std::string token = next();
+        std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+        return token;
+    }
+
+    /* Returns the rest of the current line and moves to the next one */
+    std::string line()
+    {
+        const char *start = _position;
+        while (_position != _end && *_position != '\n')
+            ++_position;
+        std::string rest(start, _position);
+        if (_position != _end)
+            ++_position;
+        return rest;
+    }
+
+    size_t offset(const char *data) const { return _position - data; }
+
+private:
+    const char *_position;
+    const char *_end;
+};
+
+int parseType(const std::string &type, int &size)
+{
+    if (type == "unsigned_char") { size = 1; return VTK_UNSIGNED_CHAR; }
+    if (type == "char") { size = 1; return VTK_CHAR; }
+    if (type == "unsigned_short") { size = 2; return VTK_UNSIGNED_SHORT; }
+    if (type == "short") { size = 2; return VTK_SHORT; }
+    if (type == "unsigned_int") { size = 4; return VTK_UNSIGNED_INT; }
+    if (type == "int") { size = 4; return VTK_INT; }
+    if (type == "float") { size = 4; return VTK_FLOAT; }
+    if (type == "double") { size = 8; return VTK_DOUBLE; }
+    size = 0;
+    return VTK_VOID;
+}
+
+inline void swapValue(uint16_t &value) { value = __builtin_bswap16(value); }
+inline void swapValue(uint32_t &value) { value = __builtin_bswap32(value); }
+inline void swapValue(uint64_t &value) { value = __builtin_bswap64(value); }
+
+/* Converts big-endian values from in to native values in out, which may be
+   the same buffer. The loop is simple enough for the compiler to vectorize
+   it with byte shuffles. */
+template<typename T>
+void swapRange(const char *in, char *out, const size_t count)
+{
+    common::parallelForChunks(0, count, SWAP_CHUNK,
+                              [in, out](size_t first, size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            T value;
+            memcpy(&value, in + i * sizeof(T), sizeof(T));
+            swapValue(value);
+            memcpy(out + i * sizeof(T), &value, sizeof(T));
+        }
+    });
+}
+
+void swapRange(const char *in, char *out, const size_t count,
+               const int size)
+{
+    switch (size)
+    {
+    case 2: swapRange<uint16_t>(in, out, count); break;
+    case 4: swapRange<uint32_t>(in, out, count); break;
+    case 8: swapRange<uint64_t>(in, out, count); break;
+    default:
+        if (in != out)
+            memcpy(out, in, count * size);
+    }
+}
+
+}
+
+vtkStandardNewMacro(MappedStructuredPointsReader);
+
+MappedStructuredPointsReader::MappedStructuredPointsReader()
+{
+    SetNumberOfInputPorts(0);
+}
+
+MappedStructuredPointsReader::~MappedStructuredPointsReader()
+{
+}
+
+void MappedStructuredPointsReader::SetFileName(const std::string &filename)
+{
+    if (filename == _filename)
+        return;
+    _filename = filename;
+    Modified();
+}
+
+bool MappedStructuredPointsReader::CanReadFile(const std::string &filename)
+{
+    try
+    {
+        vtkSmartPointer<common::MappedFile> file =
+            vtkSmartPointer<common::MappedFile>::New();
+        file->Open(filename);
+        Header header;
+        std::string error;
+        return _parseHeader(file->GetData(), file->GetSize(), header, error);
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+}
+
+int MappedStructuredPointsReader::RequestInformation(
+    vtkInformation *, vtkInformationVector **,
+    vtkInformationVector *outputVector)
+{
+    try
+    {
+        vtkSmartPointer<common::MappedFile> file =
+            vtkSmartPointer<common::MappedFile>::New();
+        file->Open(_filename);
+        std::string error;
+        if (!_parseHeader(file->GetData(), file->GetSize(), _header, error))
+        {
+            vtkErrorMacro(<< _filename << ": " << error);
+            return 0;
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        vtkErrorMacro(<< e.what());
+        return 0;
+    }
+
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+    int extent[6] = {0, _header.dimensions[0] - 1,
+                     0, _header.dimensions[1] - 1,
+                     0, _header.dimensions[2] - 1};
+    outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), extent, 6);
+    outInfo->Set(vtkDataObject::SPACING(), _header.spacing, 3);
+    outInfo->Set(vtkDataObject::ORIGIN(), _header.origin, 3);
+    vtkDataObject::SetPointDataActiveScalarInfo(
+        outInfo, _header.scalarType, _header.components);
+    return 1;
+}
+
+int MappedStructuredPointsReader::RequestData(
+    vtkInformation *, vtkInformationVector **,
+    vtkInformationVector *outputVector)
+{
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+    vtkImageData *output =
+        vtkImageData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+
+    vtkSmartPointer<vtkDataArray> scalars;
+    scalars.TakeReference(vtkDataArray::CreateDataArray(_header.scalarType));
+    scalars->SetNumberOfComponents(_header.components);
+    scalars->SetName(_header.name.c_str());
+    const int size = scalars->GetDataTypeSize();
+    const vtkIdType values = vtkIdType(_header.dimensions[0]) *
+        _header.dimensions[1] * _header.dimensions[2] * _header.components;
+
+#ifdef VTK_WORDS_BIGENDIAN
+    const bool swap = false;
+#else
+    const bool swap = size > 1;
+#endif
+    /* A misaligned payload can't be used in place by multi-byte types */
+    const bool aligned = _header.offset % size == 0;
+
+    try
+    {
+        vtkSmartPointer<common::MappedFile> file =
+            vtkSmartPointer<common::MappedFile>::New();
+        file->Open(_filename, swap && aligned);
+        if (_header.offset + size_t(values) * size > file->GetSize())
+        {
+            vtkErrorMacro(<< _filename << ": truncated scalar data");
+            return 0;
+        }
+
+        if (aligned)
+        {
+            if (swap)
+            {
+                char *data = file->GetWritableData() + _header.offset;
+                swapRange(data, data, values, size);
+            }
+            /* The array keeps the mapping alive */
+            file->Attach(scalars, _header.offset, values);
+        }
+        else
+        {
+            scalars->SetNumberOfTuples(values / _header.components);
+            swapRange(file->GetData() + _header.offset,
+                      static_cast<char *>(scalars->GetVoidPointer(0)),
+                      values, swap ? size : 1);
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        vtkErrorMacro(<< e.what());
+        return 0;
+    }
+
+    output->SetDimensions(_header.dimensions);
+    output->SetSpacing(_header.spacing);
+    output->SetOrigin(_header.origin);
+    output->GetPointData()->SetScalars(scalars);
+    return 1;
+}
+
+bool MappedStructuredPointsReader::_parseHeader(const char *data,
+                                                const size_t size,
+                                                Header &header,
+                                                std::string &error)
+{
+    Tokenizer tokens(data, size);
+    if (tokens.line().compare(0, 14, "# vtk DataFile") != 0)
+    {
+        error = "Not a legacy VTK file";
+        return false;
+    }
+    /* Title */
+    tokens.line();
+    if (tokens.nextLower() != "binary")
+    {
+        error = "Only binary files are mapped";
+        return false;
+    }
+    if (tokens.nextLower() != "dataset" ||
+        tokens.nextLower() != "structured_points")
+    {
+        error = "Not a structured points dataset";
+        return false;
+    }
+
+    for (int i = 0; i != 3; ++i)
+    {
+        header.dimensions[i] = 1;
+        header.spacing[i] = 1;
+        header.origin[i] = 0;
+    }
+    header.scalarType = VTK_VOID;
+    header.components = 1;
+    header.offset = 0;
+    int typeSize = 0;
+
+    for (std::string keyword = tokens.nextLower(); !keyword.empty();
+         keyword = tokens.nextLower())
+    {
+        if (keyword == "dimensions")
+        {
+            for (int i = 0; i != 3; ++i)
+                header.dimensions[i] = atoi(tokens.next().c_str());
+        }
+        else if (keyword == "spacing" || keyword == "aspect_ratio")
+        {
+            for (int i = 0; i != 3; ++i)
+                header.spacing[i] = atof(tokens.next().c_str());
+        }
+        else if (keyword == "origin")
+        {
+            for (int i = 0; i != 3; ++i)
+                header.origin[i] = atof(tokens.next().c_str());
+        }
+        else if (keyword == "point_data")
+        {
+            tokens.next();
+        }
+        else if (keyword == "scalars")
+        {
+            header.name = tokens.next();
+            header.scalarType = parseType(tokens.nextLower(), typeSize);
+            if (header.scalarType == VTK_VOID)
+            {
+                error = "Unsupported scalar type";
+                return false;
+            }
+            /* The number of components is optional */
+            const std::string rest = tokens.line();
+            if (atoi(rest.c_str()) > 0)
+                header.components = atoi(rest.c_str());
+        }
+        else if (keyword == "lookup_table")
+        {
+            /* The binary payload starts in the line after the table name */
+            tokens.line();
+            header.offset = tokens.offset(data);
+            break;
+        }
+        else
+        {
+            error = "Unsupported keyword " + keyword;
+            return false;
+        }
+    }
+
+    if (header.scalarType == VTK_VOID || header.offset == 0)
+    {
+        error = "No point scalars found";
+        return false;
+    }
+    /* The payload size is accumulated checking each factor against the
+       file size, so huge dimensions can't overflow it */
+    size_t payload = size_t(header.components) * typeSize;
+    for (int i = 0; i != 3; ++i)
+    {
+        if (header.dimensions[i] <= 0)
+        {
+            error = "Invalid dimensions";
+            return false;
+        }
+        if (payload > size / size_t(header.dimensions[i]))
+        {
+            error = "Truncated file";
+            return false;
+        }
+        payload *= header.dimensions[i];
+    }
+    if (header.offset + payload > size)
+    {
+        error = "Truncated file";
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,94 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VOLUME_RENDERING_MAPPED_STRUCTURED_POINTS_READER_H
+#define VOLUME_RENDERING_MAPPED_STRUCTURED_POINTS_READER_H
+
+#include <vtkImageAlgorithm.h>
+
+#include <string>
+
+namespace volume
+{
+
+/**
+   Reader for legacy VTK files with BINARY STRUCTURED_POINTS datasets that
+   maps the file in memory instead of reading it.
+
+   Legacy binary files are big-endian. Single byte types (and every type
+   on big-endian hosts) need no conversion: the point scalars array points
+   directly into the mapping, so loading is independent of the volume size
+   and pages are brought from disk as the consumers touch them. Multi-byte
+   types on little-endian hosts are byte swapped in a single parallel pass
+   over a private copy-on-write mapping (or an aligned copy if the payload
+   is misaligned). That pass reads and copies every page, so their load
+   time is proportional to the volume size, although it still avoids the
+   parsing and extra copies of vtkDataSetReader.
+
+   Only the first scalars array of the point data is read.
+ */
+class MappedStructuredPointsReader : public vtkImageAlgorithm
+{
+public:
+    static MappedStructuredPointsReader *New();
+    vtkTypeMacro(MappedStructuredPointsReader, vtkImageAlgorithm);
+
+    void SetFileName(const std::string &filename);
+    const std::string &GetFileName() const { return _filename; }
+
+    /** Returns true if the file is a binary structured points file with
+        point scalars supported by this reader. */
+    static bool CanReadFile(const std::string &filename);
+
+protected:
+    MappedStructuredPointsReader();
+    ~MappedStructuredPointsReader();
+
+    virtual int RequestInformation(vtkInformation *request,
+                                   vtkInformationVector **inputVector,
+                                   vtkInformationVector *outputVector);
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    struct Header
+    {
+        int dimensions[3];
+        double spacing[3];
+        double origin[3];
+        int scalarType;
+        int components;
+        std::string name;
+        size_t offset;
+    };
+
+    std::string _filename;
+    Header _header;
+
+    static bool _parseHeader(const char *data, size_t size, Header &header,
+                             std::string &error);
+
+    MappedStructuredPointsReader(const MappedStructuredPointsReader &);
+    void operator=(const MappedStructuredPointsReader &);
+};
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "quantized_gradients.h"
+
+#include "common/parallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace volume
+{
+
+namespace
+{
+
+inline float signNotZero(const float x)
+{
+    return x >= 0 ? 1.f : -1.f;
+}
+
+inline uint8_t quantize(const float x)
+{
+    /* [-1, 1] -> [0, 255] */
+    return uint8_t(std::min(255.f, std::max(0.f, (x * 0.5f + 0.5f) * 255.f +
+                                                 0.5f)));
+}
+
+/* Computes the gradients of the slices [first, last) storing the encoded
+   normals in out and the magnitudes in magnitudes. Returns the largest
+   magnitude found. */
+template<typename T>
+float computeSlices(const T *in, const int *dims, const double *spacing,
+                    const size_t first, const size_t last, uint32_t *out,
+                    float *magnitudes)
+{
+    const size_t nx = dims[0];
+    const size_t ny = dims[1];
+    const size_t nz = dims[2];
+    const size_t slice = nx * ny;
+    std::vector<float> gx(nx), gy(nx), gz(nx);
+    float maximum = 0;
+
+    for (size_t z = first; z != last; ++z)
+    {
+        const size_t z0 = z == 0 ? z : z - 1;
+        const size_t z1 = z + 1 == nz ? z : z + 1;
+        const float scaleZ = z1 == z0 ? 0.f : 1.f / ((z1 - z0) * spacing[2]);
+        for (size_t y = 0; y != ny; ++y)
+        {
+            const size_t y0 = y == 0 ? y : y - 1;
+            const size_t y1 = y + 1 == ny ? y : y + 1;
+            const float scaleY =
+                y1 == y0 ? 0.f : 1.f / ((y1 - y0) * spacing[1]);
+
+            const T *row = in + z * slice + y * nx;
+            const T *rowY0 = in + z * slice + y0 * nx;
+            const T *rowY1 = in + z * slice + y1 * nx;
+            const T *rowZ0 = in + z0 * slice + y * nx;
+            const T *rowZ1 = in + z1 * slice + y * nx;
+
+            /* Plain loops over contiguous rows, vectorized by the
+               compiler. */
+            for (size_t x = 0; x != nx; ++x)
+            {
+                gy[x] = (float(rowY1[x]) - float(rowY0[x])) * scaleY;
+                gz[x] = (float(rowZ1[x]) - float(rowZ0[x])) * scaleZ;
+            }
+            const float scaleX = 1.f / (2 * spacing[0]);
+            for (size_t x = 1; x + 1 < nx; ++x)
+                gx[x] = (float(row[x + 1]) - float(row[x - 1])) * scaleX;
+            if (nx > 1)
+            {
+                gx[0] = (float(row[1]) - float(row[0])) / spacing[0];
+                gx[nx - 1] =
+                    (float(row[nx - 1]) - float(row[nx - 2])) / spacing[0];
+            }
+            else
+                gx[0] = 0;
+
+            uint32_t *outRow = out + z * slice + y * nx;
+            float *magnitudeRow = magnitudes + z * slice + y * nx;
+            for (size_t x = 0; x != nx; ++x)
+            {
+                const float magnitude =
+                    std::sqrt(gx[x] * gx[x] + gy[x] * gy[x] + gz[x] * gz[x]);
+                magnitudeRow[x] = magnitude;
+                maximum = std::max(maximum, magnitude);
+                float normal[3] = {0, 0, 1};
+                if (magnitude > 0)
+                {
+                    normal[0] = gx[x] / magnitude;
+                    normal[1] = gy[x] / magnitude;
+                    normal[2] = gz[x] / magnitude;
+                }
+                outRow[x] = encodeNormal(normal);
+            }
+        }
+    }
+    return maximum;
+}
+
+template<typename T>
+float computeNormals(const T *in, const int *dims, const double *spacing,
+                     uint32_t *out, float *magnitudes)
+{
+    std::vector<float> maxima(dims[2], 0);
+    common::parallelFor(0, dims[2], [&](const size_t z)
+    {
+        maxima[z] = computeSlices(in, dims, spacing, z, z + 1, out,
+                                  magnitudes);
+    });
+    return *std::max_element(maxima.begin(), maxima.end());
+}
+
+}
+
+uint16_t encodeNormal(const float normal[3])
+{
+    const float norm =
+        std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+    float x = normal[0] / norm;
+    float y = normal[1] / norm;
+    if (normal[2] < 0)
+    {
+        /* Folding the lower hemisphere over the diagonals */
+        const float foldedX = (1 - std::fabs(y)) * signNotZero(x);
+        y = (1 - std::fabs(x)) * signNotZero(y);
+        x = foldedX;
+    }
+    return uint16_t(quantize(x)) | uint16_t(quantize(y) << 8);
+}
+
+void decodeNormal(const uint16_t code, float normal[3])
+{
+    float x = (code & 0xFF) / 255.f * 2 - 1;
+    float y = (code >> 8) / 255.f * 2 - 1;
+    const float z = 1 - std::fabs(x) - std::fabs(y);
+    if (z < 0)
+    {
+        const float unfoldedX = (1 - std::fabs(y)) * signNotZero(x);
+        y = (1 - std::fabs(x)) * signNotZero(y);
+        x = unfoldedX;
+    }
+    const float length = std::sqrt(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+vtkSmartPointer<vtkImageData> computeGradients(vtkImageData *image)
+{
+    vtkDataArray *scalars = image->GetPointData()->GetScalars();
+    if (!scalars || scalars->GetNumberOfComponents() != 1)
+        throw std::runtime_error(
+            "Gradients require single component point scalars");
+
+    const int *dims = image->GetDimensions();
+    const size_t count = size_t(dims[0]) * dims[1] * dims[2];
+
+    vtkSmartPointer<vtkImageData> gradients =
+        vtkSmartPointer<vtkImageData>::New();
+    gradients->SetExtent(image->GetExtent());
+    gradients->SetSpacing(image->GetSpacing());
+    gradients->SetOrigin(image->GetOrigin());
+    gradients->AllocateScalars(VTK_UNSIGNED_INT, 1);
+    gradients->GetPointData()->GetScalars()->SetName("gradients");
+    uint32_t *out =
+        static_cast<uint32_t *>(gradients->GetScalarPointer());
+
+    std::vector<float> magnitudes(count);
+    float maximum = 0;
+    switch (scalars->GetDataType())
+    {
+        vtkTemplateMacro(
+            maximum = computeNormals(
+                static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)),
+                dims, image->GetSpacing(), out, &magnitudes[0]));
+    default:
+        throw std::runtime_error("Unsupported scalar type");
+    }
+
+    /* Second pass quantizing the magnitudes relative to the maximum */
+    const float scale = maximum > 0 ? 255.f / maximum : 0.f;
+    common::parallelForChunks(0, count, 1 << 20,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const uint32_t magnitude = uint32_t(magnitudes[i] * scale + 0.5f);
+            out[i] |= magnitude << GRADIENT_MAGNITUDE_SHIFT;
+        }
+    });
+    return gradients;
+}
+
+std::string gradientFilename(const std::string &filename)
+{
+    const size_t dot = filename.rfind('.');
+    const size_t slash = filename.rfind('/');
+    const std::string stem =
+        dot == std::string::npos ||
+        (slash != std::string::npos && dot < slash) ?
+        filename : filename.substr(0, dot);
+    return stem + ".grad.bvol";
+}
+
+vtkStandardNewMacro(QuantizedGradientFilter);
+
+QuantizedGradientFilter::QuantizedGradientFilter()
+{
+}
+
+QuantizedGradientFilter::~QuantizedGradientFilter()
+{
+}
+
+int QuantizedGradientFilter::RequestInformation(
+    vtkInformation *, vtkInformationVector **,
+    vtkInformationVector *outputVector)
+{
+    vtkDataObject::SetPointDataActiveScalarInfo(
+        outputVector->GetInformationObject(0), VTK_UNSIGNED_INT, 1);
+    return 1;
+}
+
+int QuantizedGradientFilter::RequestData(
+    vtkInformation *, vtkInformationVector **inputVector,
+    vtkInformationVector *outputVector)
+{
+    vtkImageData *input = vtkImageData::GetData(inputVector[0]);
+    vtkImageData *output = vtkImageData::GetData(outputVector);
+    try
+    {
+        output->ShallowCopy(computeGradients(input));
+    }
+    catch (const std::runtime_error &e)
+    {
+        vtkErrorMacro(<< e.what());
+        return 0;
+    }
+    return 1;
+}
+
+}
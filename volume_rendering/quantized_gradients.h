@@ -0,0 +1,97 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VOLUME_RENDERING_QUANTIZED_GRADIENTS_H
+#define VOLUME_RENDERING_QUANTIZED_GRADIENTS_H
+
+#include <vtkImageAlgorithm.h>
+#include <vtkSmartPointer.h>
+
+#include <cstdint>
+#include <string>
+
+class vtkImageData;
+
+namespace volume
+{
+
+/**
+   Gradients are packed in 32-bit voxels: the low 16 bits hold the
+   normalized gradient direction in octahedral encoding (8 bits per axis)
+   and the next 8 bits the gradient magnitude, relative to the largest
+   magnitude in the volume.
+ */
+const uint32_t GRADIENT_NORMAL_MASK = 0xFFFF;
+const int GRADIENT_MAGNITUDE_SHIFT = 16;
+
+/** Octahedral encoding of a unit vector in 16 bits */
+uint16_t encodeNormal(const float normal[3]);
+void decodeNormal(uint16_t code, float normal[3]);
+
+inline uint16_t gradientNormal(const uint32_t gradient)
+{
+    return gradient & GRADIENT_NORMAL_MASK;
+}
+
+inline uint8_t gradientMagnitude(const uint32_t gradient)
+{
+    return gradient >> GRADIENT_MAGNITUDE_SHIFT;
+}
+
+/**
+   Computes the quantized gradient volume of the active scalars of an
+   image using central differences (one-sided at the borders).
+
+   Slices are processed in parallel and the inner loop works on whole rows
+   so it can be vectorized by the compiler. The output has the same
+   geometry as the input and a single VTK_UNSIGNED_INT component.
+ */
+vtkSmartPointer<vtkImageData> computeGradients(vtkImageData *image);
+
+/** Name of the gradient volume stored next to a bricked volume file */
+std::string gradientFilename(const std::string &filename);
+
+/**
+   Filter wrapper of computeGradients.
+ */
+class QuantizedGradientFilter : public vtkImageAlgorithm
+{
+public:
+    static QuantizedGradientFilter *New();
+    vtkTypeMacro(QuantizedGradientFilter, vtkImageAlgorithm);
+
+protected:
+    QuantizedGradientFilter();
+    ~QuantizedGradientFilter();
+
+    virtual int RequestInformation(vtkInformation *request,
+                                   vtkInformationVector **inputVector,
+                                   vtkInformationVector *outputVector);
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    QuantizedGradientFilter(const QuantizedGradientFilter &);
+    void operator=(const QuantizedGradientFilter &);
+};
+
+}
+
+#endif
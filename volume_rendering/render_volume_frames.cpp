@@ -0,0 +1,294 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* Headless batch rendering of a volume turntable to PNG files.
+
+   Frames are rendered with the software ray caster, which splits the rows
+   of each frame across threads, into an offscreen window. While a frame is
+   being rendered the previous ones are encoded and written by a pool of
+   writer threads, so compression and I/O overlap with rendering. No X
+   server is needed when VTK is built with offscreen (OSMesa or EGL)
+   support. */
+
+#include "bricked_volume_source.h"
+#include "mapped_structured_points_reader.h"
+
+#include "common/parallel.h"
+#include "common/paths.h"
+#include "common/timing.h"
+
+#include <vtkAlgorithm.h>
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkDataSetReader.h>
+#include <vtkFixedPointVolumeRayCastMapper.h>
+#include <vtkImageData.h>
+#include <vtkPNGWriter.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+#include <vtkWindowToImageFilter.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Maximum number of rendered frames waiting to be written */
+const size_t MAX_QUEUED_FRAMES = 16;
+
+/* Writes images to PNG files from a pool of threads. write() takes over
+   the caller's reference to the image, which is released by the writer
+   thread, so each image is only touched by one thread at a time. */
+class FrameWriter
+{
+public:
+    explicit FrameWriter(const unsigned int threads)
+        : _done(false)
+    {
+        for (unsigned int i = 0; i != threads; ++i)
+            _threads.push_back(std::thread(&FrameWriter::_write, this));
+    }
+
+    ~FrameWriter()
+    {
+        finish();
+    }
+
+    void write(vtkImageData *image, const std::string &filename)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_queue.size() >= MAX_QUEUED_FRAMES)
+            _condition.wait(lock);
+        _queue.push_back(Frame(image, filename));
+        _condition.notify_all();
+    }
+
+    /* Waits until all queued frames have been written */
+    void finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done = true;
+        }
+        _condition.notify_all();
+        for (size_t i = 0; i != _threads.size(); ++i)
+            _threads[i].join();
+        _threads.clear();
+    }
+
+private:
+    typedef std::pair<vtkImageData *, std::string> Frame;
+
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<Frame> _queue;
+    bool _done;
+
+    void _write()
+    {
+        while (true)
+        {
+            Frame frame;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (!_done && _queue.empty())
+                    _condition.wait(lock);
+                if (_queue.empty())
+                    return;
+                frame = _queue.front();
+                _queue.pop_front();
+                _condition.notify_all();
+            }
+            vtkSmartPointer<vtkPNGWriter> writer =
+                vtkSmartPointer<vtkPNGWriter>::New();
+            writer->SetInputData(frame.first);
+            writer->SetFileName(frame.second.c_str());
+            writer->Write();
+            writer = 0;
+            frame.first->Delete();
+        }
+    }
+};
+
+void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [--frames N] [--size W H] "
+              << "[--threads N] [--output prefix] [volume]" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filename = common::dataPath() + "ironProt.vtk";
+    std::string prefix = "frame_";
+    int frames = 360;
+    int size[2] = {800, 800};
+    int threads = common::threadCount();
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (arg == "--size" && i + 2 < argc)
+        {
+            size[0] = atoi(argv[++i]);
+            size[1] = atoi(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            prefix = argv[++i];
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            usage(argv[0]);
+            return -1;
+        }
+        else
+            filename = arg;
+    }
+    if (frames < 1 || size[0] < 1 || size[1] < 1 || threads < 1)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    double range[2] = {0, 255};
+    vtkSmartPointer<vtkPiecewiseFunction> opacityTransferFunction =
+        vtkSmartPointer<vtkPiecewiseFunction>::New();
+    vtkSmartPointer<vtkAlgorithm> reader;
+    if (common::endsWith(filename, ".bvol"))
+    {
+        std::shared_ptr<volume::BrickedVolume> data(
+            new volume::BrickedVolume(filename));
+        if (data->scalarType() != VTK_UNSIGNED_CHAR)
+        {
+            range[0] = data->range()[0];
+            range[1] = data->range()[1];
+        }
+        vtkSmartPointer<volume::BrickedVolumeSource> bricked =
+            vtkSmartPointer<volume::BrickedVolumeSource>::New();
+        bricked->SetVolume(data);
+        /* Fully transparent bricks are not decompressed */
+        bricked->SetOpacityFunction(opacityTransferFunction);
+        reader = bricked;
+    }
+    else if (volume::MappedStructuredPointsReader::CanReadFile(filename))
+    {
+        vtkSmartPointer<volume::MappedStructuredPointsReader> mappedReader =
+            vtkSmartPointer<volume::MappedStructuredPointsReader>::New();
+        mappedReader->SetFileName(filename);
+        reader = mappedReader;
+    }
+    else
+    {
+        vtkSmartPointer<vtkDataSetReader> dataSetReader =
+            vtkSmartPointer<vtkDataSetReader>::New();
+        dataSetReader->SetFileName(filename.c_str());
+        reader = dataSetReader;
+    }
+
+    /* Same transfer functions as the interactive demo */
+    opacityTransferFunction->AddPoint(range[0], 0.0);
+    opacityTransferFunction->AddPoint(range[1], 0.2);
+    vtkSmartPointer<vtkColorTransferFunction> colorTransferFunction =
+        vtkSmartPointer<vtkColorTransferFunction>::New();
+    colorTransferFunction->AddRGBPoint(range[0], 1, 0, 0);
+    colorTransferFunction->AddRGBPoint(range[1], 0, 0, 1);
+
+    /* The texture mapper needs a GPU, the ray caster renders in the CPU
+       splitting each frame across the given number of threads. */
+    vtkSmartPointer<vtkFixedPointVolumeRayCastMapper> mapper =
+        vtkSmartPointer<vtkFixedPointVolumeRayCastMapper>::New();
+    mapper->SetInputConnection(reader->GetOutputPort());
+    mapper->SetNumberOfThreads(threads);
+    /* Frame rate adaptation would make image quality depend on timing */
+    mapper->SetAutoAdjustSampleDistances(0);
+
+    vtkSmartPointer<vtkVolumeProperty> volumeProperty =
+        vtkSmartPointer<vtkVolumeProperty>::New();
+    volumeProperty->SetColor(colorTransferFunction);
+    volumeProperty->SetScalarOpacity(opacityTransferFunction);
+    volumeProperty->SetInterpolationTypeToLinear();
+
+    vtkSmartPointer<vtkVolume> volume = vtkSmartPointer<vtkVolume>::New();
+    volume->SetMapper(mapper);
+    volume->SetProperty(volumeProperty);
+
+    vtkSmartPointer<vtkRenderer> renderer =
+        vtkSmartPointer<vtkRenderer>::New();
+    renderer->SetBackground(1, 1, 1);
+    renderer->AddVolume(volume);
+
+    vtkSmartPointer<vtkRenderWindow> window =
+        vtkSmartPointer<vtkRenderWindow>::New();
+    window->SetOffScreenRendering(1);
+    window->AddRenderer(renderer);
+    window->SetSize(size[0], size[1]);
+
+    vtkSmartPointer<vtkWindowToImageFilter> capture =
+        vtkSmartPointer<vtkWindowToImageFilter>::New();
+    capture->SetInput(window);
+    capture->SetInputBufferTypeToRGB();
+    capture->ReadFrontBufferOff();
+    capture->ShouldRerenderOff();
+
+    /* Loading the data before starting the clock */
+    reader->Update();
+    renderer->ResetCamera();
+    vtkCamera *camera = renderer->GetActiveCamera();
+
+    double renderSeconds = 0;
+    const double seconds = common::measure([&]()
+    {
+        FrameWriter writer(threads);
+        for (int i = 0; i != frames; ++i)
+        {
+            renderSeconds += common::measure([&]()
+            {
+                window->Render();
+                capture->Modified();
+                capture->Update();
+            });
+
+            /* The filter reuses its output, the writer gets a copy */
+            vtkImageData *image = vtkImageData::New();
+            image->DeepCopy(capture->GetOutput());
+            char name[16];
+            snprintf(name, sizeof(name), "%05d.png", i);
+            writer.write(image, prefix + name);
+
+            camera->Azimuth(360.0 / frames);
+        }
+        writer.finish();
+    });
+
+    std::cout << frames << " frames of " << size[0] << "x" << size[1]
+              << " with " << threads << " threads in " << seconds << " s: "
+              << frames / seconds << " fps (" << frames / renderSeconds
+              << " fps rendering only)" << std::endl;
+}
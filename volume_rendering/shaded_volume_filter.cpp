@@ -0,0 +1,261 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "shaded_volume_filter.h"
+#include "quantized_gradients.h"
+
+#include "common/parallel.h"
+
+#include <vtkColorTransferFunction.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPointData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace volume
+{
+
+namespace
+{
+
+/* Number of entries of the transfer function lookup tables */
+const int TABLE_SIZE = 4096;
+const size_t NORMAL_CODES = 1 << 16;
+
+struct Tables
+{
+    double offset;
+    double scale;
+    std::vector<double> color;
+    std::vector<double> opacity;
+    std::vector<float> diffuse;
+    std::vector<float> specular;
+    float ambient;
+    float diffuseCoefficient;
+};
+
+template<typename T>
+void shade(const T *in, const uint32_t *gradients, uint8_t *out,
+           const size_t count, const Tables &tables)
+{
+    common::parallelForChunks(0, count, 1 << 16,
+                              [&](const size_t first, const size_t last)
+    {
+        for (size_t i = first; i != last; ++i)
+        {
+            const int index = std::min(TABLE_SIZE - 1, std::max(0,
+                int((double(in[i]) - tables.offset) * tables.scale)));
+            const double *rgb = &tables.color[index * 3];
+            const uint32_t gradient = gradients[i];
+            float light = tables.ambient + tables.diffuseCoefficient;
+            float highlight = 0;
+            if (gradientMagnitude(gradient) != 0)
+            {
+                const uint16_t normal = gradientNormal(gradient);
+                light = tables.ambient + tables.diffuse[normal];
+                highlight = tables.specular[normal];
+            }
+            uint8_t *voxel = out + i * 4;
+            for (int j = 0; j != 3; ++j)
+                voxel[j] = uint8_t(std::min(
+                    255.f, (float(rgb[j]) * light + highlight) * 255.f));
+            voxel[3] = uint8_t(tables.opacity[index] * 255 + 0.5);
+        }
+    });
+}
+
+}
+
+vtkStandardNewMacro(ShadedVolumeFilter);
+
+ShadedVolumeFilter::ShadedVolumeFilter()
+    : _color(0)
+    , _opacity(0)
+    , _ambient(0.2)
+    , _diffuse(0.8)
+    , _specular(0.3)
+    , _specularPower(20)
+{
+    SetNumberOfInputPorts(2);
+    _light[0] = 0;
+    _light[1] = 0;
+    _light[2] = -1;
+}
+
+ShadedVolumeFilter::~ShadedVolumeFilter()
+{
+    if (_color)
+        _color->UnRegister(this);
+    if (_opacity)
+        _opacity->UnRegister(this);
+}
+
+void ShadedVolumeFilter::SetColorFunction(vtkColorTransferFunction *function)
+{
+    if (_color == function)
+        return;
+    if (_color)
+        _color->UnRegister(this);
+    _color = function;
+    if (_color)
+        _color->Register(this);
+    Modified();
+}
+
+void ShadedVolumeFilter::SetOpacityFunction(vtkPiecewiseFunction *function)
+{
+    if (_opacity == function)
+        return;
+    if (_opacity)
+        _opacity->UnRegister(this);
+    _opacity = function;
+    if (_opacity)
+        _opacity->Register(this);
+    Modified();
+}
+
+void ShadedVolumeFilter::SetLightDirection(const double direction[3])
+{
+    const double length = std::sqrt(direction[0] * direction[0] +
+                                    direction[1] * direction[1] +
+                                    direction[2] * direction[2]);
+    if (length == 0)
+        return;
+    const double light[3] = {direction[0] / length, direction[1] / length,
+                             direction[2] / length};
+    if (std::equal(light, light + 3, _light))
+        return;
+    std::copy(light, light + 3, _light);
+    Modified();
+}
+
+void ShadedVolumeFilter::SetLighting(const double ambient,
+                                     const double diffuse,
+                                     const double specular,
+                                     const double specularPower)
+{
+    _ambient = ambient;
+    _diffuse = diffuse;
+    _specular = specular;
+    _specularPower = specularPower;
+    Modified();
+}
+
+unsigned long ShadedVolumeFilter::GetMTime()
+{
+    unsigned long time = Superclass::GetMTime();
+    if (_color)
+        time = std::max(time, _color->GetMTime());
+    if (_opacity)
+        time = std::max(time, _opacity->GetMTime());
+    return time;
+}
+
+int ShadedVolumeFilter::RequestInformation(vtkInformation *,
+                                           vtkInformationVector **,
+                                           vtkInformationVector *outputVector)
+{
+    vtkDataObject::SetPointDataActiveScalarInfo(
+        outputVector->GetInformationObject(0), VTK_UNSIGNED_CHAR, 4);
+    return 1;
+}
+
+int ShadedVolumeFilter::RequestData(vtkInformation *,
+                                    vtkInformationVector **inputVector,
+                                    vtkInformationVector *outputVector)
+{
+    vtkImageData *input = vtkImageData::GetData(inputVector[0]);
+    vtkImageData *gradients = vtkImageData::GetData(inputVector[1]);
+    vtkImageData *output = vtkImageData::GetData(outputVector);
+
+    if (!_color || !_opacity)
+    {
+        vtkErrorMacro("Transfer functions not set");
+        return 0;
+    }
+    vtkDataArray *scalars = input->GetPointData()->GetScalars();
+    vtkDataArray *packed = gradients->GetPointData()->GetScalars();
+    if (!scalars || !packed || packed->GetDataType() != VTK_UNSIGNED_INT ||
+        !std::equal(input->GetDimensions(), input->GetDimensions() + 3,
+                    gradients->GetDimensions()))
+    {
+        vtkErrorMacro("Scalars and quantized gradients do not match");
+        return 0;
+    }
+
+    /* The transfer functions are not thread safe, they are sampled in
+       tables upfront. */
+    Tables tables;
+    double range[2];
+    scalars->GetRange(range, 0);
+    tables.offset = range[0];
+    tables.scale = range[1] > range[0] ?
+        (TABLE_SIZE - 1) / (range[1] - range[0]) : 0;
+    tables.color.resize(TABLE_SIZE * 3);
+    tables.opacity.resize(TABLE_SIZE);
+    _color->GetTable(range[0], range[1], TABLE_SIZE, &tables.color[0]);
+    _opacity->GetTable(range[0], range[1], TABLE_SIZE, &tables.opacity[0]);
+    tables.ambient = _ambient;
+    tables.diffuseCoefficient = _diffuse;
+
+    /* Lighting of every normal code. With the light at the viewer the half
+       vector is the light direction, diffuse and specular terms only
+       depend on the angle between the normal and the light. */
+    tables.diffuse.resize(NORMAL_CODES);
+    tables.specular.resize(NORMAL_CODES);
+    common::parallelFor(0, NORMAL_CODES, [&](const size_t code)
+    {
+        float normal[3];
+        decodeNormal(uint16_t(code), normal);
+        const float cosine = std::fabs(normal[0] * _light[0] +
+                                       normal[1] * _light[1] +
+                                       normal[2] * _light[2]);
+        tables.diffuse[code] = _diffuse * cosine;
+        tables.specular[code] = _specular * std::pow(cosine, _specularPower);
+    });
+
+    output->SetExtent(input->GetExtent());
+    output->SetSpacing(input->GetSpacing());
+    output->SetOrigin(input->GetOrigin());
+    output->AllocateScalars(VTK_UNSIGNED_CHAR, 4);
+    output->GetPointData()->GetScalars()->SetName("rgba");
+
+    const size_t count = scalars->GetNumberOfTuples();
+    const uint32_t *in = static_cast<uint32_t *>(packed->GetVoidPointer(0));
+    uint8_t *out = static_cast<uint8_t *>(output->GetScalarPointer());
+    switch (scalars->GetDataType())
+    {
+        vtkTemplateMacro(
+            shade(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)),
+                  in, out, count, tables));
+    default:
+        vtkErrorMacro("Unsupported scalar type");
+        return 0;
+    }
+    return 1;
+}
+
+}
@@ -0,0 +1,90 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VOLUME_RENDERING_SHADED_VOLUME_FILTER_H
+#define VOLUME_RENDERING_SHADED_VOLUME_FILTER_H
+
+#include <vtkImageAlgorithm.h>
+
+class vtkColorTransferFunction;
+class vtkPiecewiseFunction;
+
+namespace volume
+{
+
+/**
+   Bakes the transfer functions and Phong lighting of a volume into an
+   RGBA volume.
+
+   Input port 0 takes the scalars and port 1 their quantized gradients (see
+   computeGradients), both with the same geometry. The lighting of each of
+   the 65536 normal codes is evaluated once per light direction, so shading
+   a voxel costs one fetch of its packed gradient and two table lookups.
+   Voxels with zero gradient magnitude have no defined normal and only get
+   ambient and diffuse light.
+
+   The output has 4 unsigned char components meant to be rendered with
+   IndependentComponentsOff and an identity scalar opacity function.
+ */
+class ShadedVolumeFilter : public vtkImageAlgorithm
+{
+public:
+    static ShadedVolumeFilter *New();
+    vtkTypeMacro(ShadedVolumeFilter, vtkImageAlgorithm);
+
+    void SetColorFunction(vtkColorTransferFunction *function);
+    void SetOpacityFunction(vtkPiecewiseFunction *function);
+
+    /** Direction in which the light travels, lighting is two-sided */
+    void SetLightDirection(const double direction[3]);
+    const double *GetLightDirection() const { return _light; }
+
+    void SetLighting(double ambient, double diffuse, double specular,
+                     double specularPower);
+
+    /** Includes the modification time of the transfer functions */
+    virtual unsigned long GetMTime();
+
+protected:
+    ShadedVolumeFilter();
+    ~ShadedVolumeFilter();
+
+    virtual int RequestInformation(vtkInformation *request,
+                                   vtkInformationVector **inputVector,
+                                   vtkInformationVector *outputVector);
+
+    virtual int RequestData(vtkInformation *request,
+                            vtkInformationVector **inputVector,
+                            vtkInformationVector *outputVector);
+
+private:
+    vtkColorTransferFunction *_color;
+    vtkPiecewiseFunction *_opacity;
+    double _light[3];
+    double _ambient;
+    double _diffuse;
+    double _specular;
+    double _specularPower;
+
+    ShadedVolumeFilter(const ShadedVolumeFilter &);
+    void operator=(const ShadedVolumeFilter &);
+};
+
+}
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "volume_pyramid.h"
+
+#include "common/parallel.h"
+
+#include <vtkCamera.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkRenderer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace volume
+{
+
+namespace
+{
+
+template<typename T>
+T average(const double sum, const int count, const T *)
+{
+    const double value = sum / count;
+    if (std::numeric_limits<T>::is_integer)
+        return T(std::floor(value + 0.5));
+    return T(value);
+}
+
+template<typename T>
+void boxFilter(const T *in, const int *inDims, T *out, const int *outDims)
+{
+    const size_t inRow = inDims[0];
+    const size_t inSlice = inRow * inDims[1];
+    common::parallelFor(0, outDims[2], [&](const size_t z)
+    {
+        T *slice = out + z * size_t(outDims[0]) * outDims[1];
+        const int z0 = z * 2;
+        const int z1 = std::min(z0 + 1, inDims[2] - 1);
+        for (int y = 0; y < outDims[1]; ++y)
+        {
+            const int y0 = y * 2;
+            const int y1 = std::min(y0 + 1, inDims[1] - 1);
+            for (int x = 0; x < outDims[0]; ++x)
+            {
+                const int x0 = x * 2;
+                const int x1 = std::min(x0 + 1, inDims[0] - 1);
+                double sum = 0;
+                const int zs[2] = {z0, z1};
+                const int ys[2] = {y0, y1};
+                for (int k = 0; k != 2; ++k)
+                    for (int j = 0; j != 2; ++j)
+                    {
+                        const T *row = in + zs[k] * inSlice + ys[j] * inRow;
+                        sum += double(row[x0]) + double(row[x1]);
+                    }
+                slice[size_t(y) * outDims[0] + x] = average(sum, 8, in);
+            }
+        }
+    });
+}
+
+bool fileExists(const std::string &filename)
+{
+    return access(filename.c_str(), R_OK) == 0;
+}
+
+}
+
+void VolumePyramid::write(vtkImageData *image, const std::string &filename,
+                          const int brickSize, const int compressionLevel)
+{
+    vtkSmartPointer<vtkImageData> level = image;
+    for (int i = 0; ; ++i)
+    {
+        BrickedVolume::write(level, levelFilename(filename, i),
+                             brickSize, compressionLevel);
+        const int *dims = level->GetDimensions();
+        if (std::max(dims[0], std::max(dims[1], dims[2])) <= brickSize)
+            break;
+        level = downsample(level);
+    }
+}
+
+std::string VolumePyramid::levelFilename(const std::string &filename,
+                                         const int level)
+{
+    if (level == 0)
+        return filename;
+    const size_t dot = filename.rfind(".bvol");
+    std::stringstream name;
+    name << filename.substr(0, dot) << ".lod" << level << ".bvol";
+    return name.str();
+}
+
+VolumePyramid::VolumePyramid(const std::string &filename)
+{
+    _levels.push_back(std::make_shared<BrickedVolume>(filename));
+    for (int i = 1; fileExists(levelFilename(filename, i)); ++i)
+        _levels.push_back(
+            std::make_shared<BrickedVolume>(levelFilename(filename, i)));
+}
+
+VolumePyramid::VolumePyramid(const std::shared_ptr<BrickedVolume> &volume)
+    : _levels(1, volume)
+{
+}
+
+int VolumePyramid::levelForBudget(const int maxDimension) const
+{
+    for (size_t i = 0; i != _levels.size(); ++i)
+    {
+        const int *dims = _levels[i]->dimensions();
+        if (std::max(dims[0], std::max(dims[1], dims[2])) <= maxDimension)
+            return i;
+    }
+    return _levels.size() - 1;
+}
+
+vtkSmartPointer<vtkImageData> downsample(vtkImageData *image)
+{
+    vtkDataArray *scalars = image->GetPointData()->GetScalars();
+    if (!scalars || scalars->GetNumberOfComponents() != 1)
+        throw std::runtime_error(
+            "Downsampling requires single component point scalars");
+
+    int inDims[3];
+    image->GetDimensions(inDims);
+    int outDims[3];
+    double spacing[3];
+    double origin[3];
+    for (int i = 0; i != 3; ++i)
+    {
+        outDims[i] = (inDims[i] + 1) / 2;
+        spacing[i] = image->GetSpacing()[i] * 2;
+        /* The new voxels are centered between the two they average */
+        origin[i] = image->GetOrigin()[i] + image->GetSpacing()[i] * 0.5;
+    }
+
+    vtkSmartPointer<vtkImageData> output =
+        vtkSmartPointer<vtkImageData>::New();
+    output->SetDimensions(outDims);
+    output->SetSpacing(spacing);
+    output->SetOrigin(origin);
+    output->AllocateScalars(scalars->GetDataType(), 1);
+    output->GetPointData()->GetScalars()->SetName(scalars->GetName());
+
+    void *in = scalars->GetVoidPointer(0);
+    void *out = output->GetScalarPointer();
+    switch (scalars->GetDataType())
+    {
+        vtkTemplateMacro(boxFilter(static_cast<const VTK_TT *>(in), inDims,
+                                   static_cast<VTK_TT *>(out), outDims));
+    default:
+        throw std::runtime_error("Unsupported scalar type");
+    }
+    return output;
+}
+
+std::vector<int> selectLevels(const VolumePyramid &pyramid,
+                              vtkRenderer *renderer,
+                              const double pixelTolerance, const int bias)
+{
+    const BrickedVolume &volume = pyramid.level(0);
+    const int coarsest = pyramid.levelCount() - 1;
+    std::vector<int> levels(volume.brickCount(), coarsest);
+
+    vtkCamera *camera = renderer->GetActiveCamera();
+    const double *eye = camera->GetPosition();
+    const int viewportHeight = renderer->GetSize()[1];
+    double planes[24];
+    camera->GetFrustumPlanes(renderer->GetTiledAspectRatio(), planes);
+    const double voxelSize =
+        std::max(volume.spacing()[0],
+                 std::max(volume.spacing()[1], volume.spacing()[2]));
+
+    for (size_t i = 0; i != volume.brickCount(); ++i)
+    {
+        int extent[6];
+        volume.brickExtent(i, extent);
+        double center[3];
+        double radius = 0;
+        for (int j = 0; j != 3; ++j)
+        {
+            const double low =
+                volume.origin()[j] + extent[j * 2] * volume.spacing()[j];
+            const double high =
+                volume.origin()[j] + extent[j * 2 + 1] * volume.spacing()[j];
+            center[j] = (low + high) * 0.5;
+            radius += (high - low) * (high - low) * 0.25;
+        }
+        radius = std::sqrt(radius);
+
+        bool visible = true;
+        for (int j = 0; j != 6 && visible; ++j)
+        {
+            const double *plane = planes + j * 4;
+            visible = (plane[0] * center[0] + plane[1] * center[1] +
+                       plane[2] * center[2] + plane[3]) >= -radius;
+        }
+        if (!visible)
+            continue;
+
+        /* Screen size in pixels of a level 0 voxel at the closest point of
+           the brick bounding sphere */
+        double pixelsPerUnit;
+        if (camera->GetParallelProjection())
+        {
+            pixelsPerUnit = viewportHeight / (2 * camera->GetParallelScale());
+        }
+        else
+        {
+            const double dx = center[0] - eye[0];
+            const double dy = center[1] - eye[1];
+            const double dz = center[2] - eye[2];
+            const double distance =
+                std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - radius,
+                         voxelSize);
+            const double halfAngle =
+                camera->GetViewAngle() * 0.5 * M_PI / 180.0;
+            pixelsPerUnit =
+                viewportHeight / (2 * distance * std::tan(halfAngle));
+        }
+        const double voxelPixels = voxelSize * pixelsPerUnit;
+        int level = 0;
+        if (voxelPixels < pixelTolerance)
+            level = int(std::floor(std::log2(pixelTolerance / voxelPixels)));
+        levels[i] = std::max(0, std::min(coarsest, level + bias));
+    }
+    return levels;
+}
+
+}
@@ -0,0 +1,94 @@
+/*
+ * VTKDemos
+ * Copyright (C) 2013 Juan Hernando jhernando@fi.upm.es
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2.1 as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VOLUME_RENDERING_VOLUME_PYRAMID_H
+#define VOLUME_RENDERING_VOLUME_PYRAMID_H
+
+#include "bricked_volume.h"
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+class vtkRenderer;
+
+namespace volume
+{
+
+/**
+   Mipmap pyramid of a volume where each level is a BrickedVolume.
+
+   Level 0 is the full resolution volume and each level halves the
+   resolution of the previous one. All levels use the same brick size, so
+   a brick of level L covers the same region as 8 bricks of level L - 1.
+   Levels are stored in separate files named after the level 0 file
+   (see levelFilename).
+ */
+class VolumePyramid
+{
+public:
+    /**
+       Writes the volume and its coarser levels, down to the first one that
+       fits in a single brick. Levels are downsampled with a box filter in
+       parallel and their bricks compressed in parallel.
+     */
+    static void write(vtkImageData *image, const std::string &filename,
+                      int brickSize = 64, int compressionLevel = 1);
+
+    /** Returns the file name of a given level, level 0 is filename itself */
+    static std::string levelFilename(const std::string &filename, int level);
+
+    /** Opens a level 0 file and all the coarser levels found next to it */
+    explicit VolumePyramid(const std::string &filename);
+
+    /** A pyramid with a single level */
+    explicit VolumePyramid(const std::shared_ptr<BrickedVolume> &volume);
+
+    size_t levelCount() const { return _levels.size(); }
+    const BrickedVolume &level(size_t index) const { return *_levels[index]; }
+    const std::shared_ptr<BrickedVolume> &levelPointer(size_t index) const
+        { return _levels[index]; }
+
+    /** Finest level whose largest dimension is at most maxDimension */
+    int levelForBudget(int maxDimension) const;
+
+private:
+    std::vector<std::shared_ptr<BrickedVolume>> _levels;
+};
+
+/**
+   Halves the resolution of a single component volume with a 2x2x2 box
+   filter. The work is split in slabs processed in parallel.
+ */
+vtkSmartPointer<vtkImageData> downsample(vtkImageData *image);
+
+/**
+   Chooses a pyramid level for each brick of level 0.
+
+   The level of a brick is the coarsest one whose voxels project to at most
+   pixelTolerance pixels at the distance from the camera to the brick.
+   Bricks outside the view frustum get the coarsest level. bias is added
+   to all levels, which is used to render a coarser approximation first.
+   The volume is assumed to be rendered with an identity transformation.
+ */
+std::vector<int> selectLevels(const VolumePyramid &pyramid,
+                              vtkRenderer *renderer,
+                              double pixelTolerance = 1.0, int bias = 0);
+
+}
+
+#endif
@@ -16,9 +16,19 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include "async_volume_loader.h"
+#include "bricked_volume_source.h"
+#include "mapped_structured_points_reader.h"
+#include "quantized_gradients.h"
+#include "shaded_volume_filter.h"
+
 #include "common/paths.h"
 
 #include <vtkActor.h>
+#include <vtkAlgorithm.h>
+#include <vtkAlgorithmOutput.h>
+#include <vtkCamera.h>
+#include <vtkCommand.h>
 #include <vtkColorTransferFunction.h>
 #include <vtkDataSetReader.h>
 #include <vtkDataSetMapper.h>
@@ -31,33 +41,330 @@
 #include <vtkRenderer.h>
 #include <vtkRenderWindowInteractor.h>
 #include <vtkSmartPointer.h>
+#include <vtkTextActor.h>
+#include <vtkTextProperty.h>
+#include <vtkTrivialProducer.h>
 #include <vtkVolumeTextureMapper3D.h>
 #include <vtkVolume.h>
 #include <vtkVolumeProperty.h>
 
-vtkSmartPointer<vtkActor> doOutline(vtkDataSetReader *reader);
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+vtkSmartPointer<vtkActor> doOutline(vtkAlgorithmOutput *data);
 
-int main()
+/* Chooses the pyramid level of each brick once the camera stops moving.
+   Refinement is progressive, each timer tick selects levels one step finer
+   until the target resolution is reached. */
+class Refinement : public vtkCommand
 {
-    vtkSmartPointer<vtkDataSetReader> reader = vtkDataSetReader::New();
-    reader->SetFileName((common::dataPath() + "ironProt.vtk").c_str());
+public:
+    static Refinement *New(volume::BrickedVolumeSource *source,
+                           vtkRenderer *renderer, int initialBias)
+    {
+        return new Refinement(source, renderer, initialBias);
+    }
 
-    /* No data transformations, connecting the reader directly to the data
-       mapper for 3D texture based volume rendering. */
-    vtkSmartPointer<vtkVolumeTextureMapper3D> mapper =
-        vtkVolumeTextureMapper3D::New();
-    mapper->SetInputConnection(reader->GetOutputPort());
+    virtual void Execute(vtkObject *, unsigned long, void*)
+    {
+        vtkCamera *camera = _renderer->GetActiveCamera();
+        double view[8];
+        camera->GetPosition(view);
+        std::copy(camera->GetFocalPoint(), camera->GetFocalPoint() + 3,
+                  view + 3);
+        view[6] = camera->GetViewAngle();
+        view[7] = camera->GetParallelScale();
+        if (!std::equal(view, view + 8, _view))
+        {
+            /* The camera is moving, waiting for it to settle. */
+            std::copy(view, view + 8, _view);
+            _bias = _pending ? _bias : 1;
+            _pending = true;
+            return;
+        }
+        if (!_pending)
+            return;
+
+        const std::vector<int> levels =
+            volume::selectLevels(*_source->GetPyramid(), _renderer, 1.0,
+                                 _bias);
+        if (levels != _source->GetBrickLevels())
+        {
+            _source->SetBrickLevels(levels);
+            _renderer->GetRenderWindow()->Render();
+        }
+        if (_bias == 0)
+            _pending = false;
+        else
+            --_bias;
+    }
+
+private:
+    volume::BrickedVolumeSource *_source;
+    vtkRenderer *_renderer;
+    int _bias;
+    bool _pending;
+    double _view[8];
+
+    Refinement(volume::BrickedVolumeSource *source, vtkRenderer *renderer,
+               int initialBias)
+        : _source(source)
+        , _renderer(renderer)
+        , _bias(initialBias)
+        , _pending(true)
+    {
+        std::fill(_view, _view + 8, 0);
+    }
+};
+
+/* Copies the bricks loaded by an AsyncVolumeLoader into the rendered image
+   and keeps the loading order up to date with the camera. */
+class Loading : public vtkCommand
+{
+public:
+    static Loading *New(volume::AsyncVolumeLoader *loader,
+                        vtkRenderer *renderer, vtkTextActor *progress)
+    {
+        return new Loading(loader, renderer, progress);
+    }
+
+    virtual void Execute(vtkObject *, unsigned long, void*)
+    {
+        if (_done)
+            return;
+
+        _loader->setCamera(_renderer->GetActiveCamera(),
+                           _renderer->GetTiledAspectRatio());
+        if (!_loader->update() && !_loader->finished())
+            return;
+
+        if (_loader->failed())
+        {
+            std::cerr << "Error loading volume: " << _loader->error()
+                      << std::endl;
+            _progress->SetInput("Loading failed");
+        }
+        else if (_loader->finished())
+        {
+            _progress->SetVisibility(0);
+        }
+        else
+        {
+            std::stringstream text;
+            text << "Loading " << int(_loader->progress() * 100) << "%";
+            _progress->SetInput(text.str().c_str());
+        }
+        _done = _loader->finished();
+        _renderer->GetRenderWindow()->Render();
+    }
+
+private:
+    volume::AsyncVolumeLoader *_loader;
+    vtkRenderer *_renderer;
+    vtkTextActor *_progress;
+    bool _done;
+
+    Loading(volume::AsyncVolumeLoader *loader, vtkRenderer *renderer,
+            vtkTextActor *progress)
+        : _loader(loader)
+        , _renderer(renderer)
+        , _progress(progress)
+        , _done(false)
+    {
+    }
+};
+
+/* Relights a shaded volume from the camera position once the camera stops
+   moving, baking the lighting is too expensive to do it every frame. */
+class Relighting : public vtkCommand
+{
+public:
+    static Relighting *New(volume::ShadedVolumeFilter *shading,
+                           vtkRenderer *renderer)
+    {
+        return new Relighting(shading, renderer);
+    }
+
+    virtual void Execute(vtkObject *, unsigned long, void*)
+    {
+        const double *direction =
+            _renderer->GetActiveCamera()->GetDirectionOfProjection();
+        if (!std::equal(direction, direction + 3, _direction))
+        {
+            std::copy(direction, direction + 3, _direction);
+            return;
+        }
+        if (std::equal(direction, direction + 3,
+                       _shading->GetLightDirection()))
+            return;
+        _shading->SetLightDirection(direction);
+        _renderer->GetRenderWindow()->Render();
+    }
+
+private:
+    volume::ShadedVolumeFilter *_shading;
+    vtkRenderer *_renderer;
+    double _direction[3];
+
+    Relighting(volume::ShadedVolumeFilter *shading, vtkRenderer *renderer)
+        : _shading(shading)
+        , _renderer(renderer)
+    {
+        std::fill(_direction, _direction + 3, 0);
+    }
+};
+
+/* Maximum dimension of the pyramid level used for the first frame */
+const int INITIAL_LEVEL_SIZE = 256;
+
+int main(int argc, char *argv[])
+{
+    std::string filename = common::dataPath() + "ironProt.vtk";
+    size_t cacheMegabytes = 512;
+    bool async = false;
+    bool shade = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--cache" && i + 1 < argc)
+            cacheMegabytes = atoi(argv[++i]);
+        else if (arg == "--async")
+            async = true;
+        else if (arg == "--shade")
+            shade = true;
+        else
+            filename = arg;
+    }
+    /* Shading needs the full resolution scalars to match the gradients,
+       the async loader only has them once loading has finished */
+    if (async && shade)
+    {
+        std::cerr << "--async and --shade can't be used together"
+                  << std::endl;
+        return -1;
+    }
 
     /* Creating the opacity and color transfer functions */
+    double range[2] = {0, 255};
     vtkSmartPointer<vtkPiecewiseFunction> opacityTransferFunction =
         vtkPiecewiseFunction::New();
-    opacityTransferFunction->AddPoint(0, 0.0);
-    opacityTransferFunction->AddPoint(255, 0.2);
-
     vtkSmartPointer<vtkColorTransferFunction> colorTransferFunction =
         vtkColorTransferFunction::New();
-    colorTransferFunction->AddRGBPoint(0, 1, 0, 0);
-    colorTransferFunction->AddRGBPoint(255, 0, 0, 1);
+
+    vtkSmartPointer<vtkAlgorithm> reader;
+    vtkSmartPointer<volume::BrickedVolumeSource> bricked;
+    std::unique_ptr<volume::AsyncVolumeLoader> loader;
+    if (common::endsWith(filename, ".bvol") && async)
+    {
+        /* The full resolution level is loaded in the background while
+           rendering. The first frame shows a coarse level of the pyramid,
+           then the full resolution image fills in brick by brick. */
+        std::shared_ptr<volume::VolumePyramid> pyramid(
+            new volume::VolumePyramid(filename));
+        const volume::BrickedVolume &data = pyramid->level(0);
+        if (data.scalarType() != VTK_UNSIGNED_CHAR)
+        {
+            range[0] = data.range()[0];
+            range[1] = data.range()[1];
+        }
+        /* The transfer function must be complete before the loader
+           evaluates it. */
+        opacityTransferFunction->AddPoint(range[0], 0.0);
+        opacityTransferFunction->AddPoint(range[1], 0.2);
+        loader.reset(new volume::AsyncVolumeLoader(
+            pyramid, opacityTransferFunction, INITIAL_LEVEL_SIZE));
+        reader = loader->producer();
+    }
+    else if (common::endsWith(filename, ".bvol"))
+    {
+        /* Bricked volumes are decompressed on demand through a brick cache.
+           The source receives the opacity function to skip bricks that
+           are fully transparent. */
+        std::shared_ptr<volume::VolumePyramid> pyramid(
+            new volume::VolumePyramid(filename));
+        const volume::BrickedVolume &data = pyramid->level(0);
+        if (data.scalarType() != VTK_UNSIGNED_CHAR)
+        {
+            range[0] = data.range()[0];
+            range[1] = data.range()[1];
+        }
+        bricked = vtkSmartPointer<volume::BrickedVolumeSource>::New();
+        bricked->SetPyramid(pyramid);
+        /* The first frame is rendered from a coarse level of the pyramid
+           regardless of the volume size. Shading needs the full resolution
+           to match the gradient volume. */
+        if (!shade)
+            bricked->SetBrickLevels(
+                std::vector<int>(data.brickCount(),
+                                 pyramid->levelForBudget(INITIAL_LEVEL_SIZE)));
+        bricked->SetCache(std::shared_ptr<volume::BrickCache>(
+            new volume::BrickCache(cacheMegabytes << 20)));
+        bricked->SetOpacityFunction(opacityTransferFunction);
+        reader = bricked;
+    }
+    else if (volume::MappedStructuredPointsReader::CanReadFile(filename))
+    {
+        /* Binary structured points are mapped in memory, not read */
+        vtkSmartPointer<volume::MappedStructuredPointsReader> mappedReader =
+            vtkSmartPointer<volume::MappedStructuredPointsReader>::New();
+        mappedReader->SetFileName(filename);
+        reader = mappedReader;
+    }
+    else
+    {
+        vtkSmartPointer<vtkDataSetReader> dataSetReader =
+            vtkSmartPointer<vtkDataSetReader>::New();
+        dataSetReader->SetFileName(filename.c_str());
+        reader = dataSetReader;
+    }
+
+    if (!loader)
+    {
+        opacityTransferFunction->AddPoint(range[0], 0.0);
+        opacityTransferFunction->AddPoint(range[1], 0.2);
+    }
+    colorTransferFunction->AddRGBPoint(range[0], 1, 0, 0);
+    colorTransferFunction->AddRGBPoint(range[1], 0, 0, 1);
+
+    /* No data transformations, connecting the reader directly to the data
+       mapper for 3D texture based volume rendering. */
+    vtkSmartPointer<vtkVolumeTextureMapper3D> mapper =
+        vtkVolumeTextureMapper3D::New();
+    mapper->SetInputConnection(reader->GetOutputPort());
+
+    /* In shaded mode the transfer functions and the lighting are baked into
+       an RGBA volume from the scalars and their quantized gradients. The
+       gradients are read from the bricked file stored next to the volume if
+       it exists (see make_bricked_volume) or computed at load time. */
+    vtkSmartPointer<volume::ShadedVolumeFilter> shading;
+    if (shade)
+    {
+        vtkSmartPointer<vtkAlgorithm> gradients;
+        const std::string gradientFile = volume::gradientFilename(filename);
+        if (common::endsWith(filename, ".bvol") && std::ifstream(gradientFile))
+        {
+            vtkSmartPointer<volume::BrickedVolumeSource> source =
+                vtkSmartPointer<volume::BrickedVolumeSource>::New();
+            source->SetVolume(std::shared_ptr<volume::BrickedVolume>(
+                new volume::BrickedVolume(gradientFile)));
+            gradients = source;
+        }
+        else
+        {
+            gradients = vtkSmartPointer<volume::QuantizedGradientFilter>::New();
+            gradients->SetInputConnection(reader->GetOutputPort());
+        }
+        shading = vtkSmartPointer<volume::ShadedVolumeFilter>::New();
+        shading->SetInputConnection(0, reader->GetOutputPort());
+        shading->SetInputConnection(1, gradients->GetOutputPort());
+        shading->SetColorFunction(colorTransferFunction);
+        shading->SetOpacityFunction(opacityTransferFunction);
+        mapper->SetInputConnection(shading->GetOutputPort());
+    }
 
     /* The volume rendering actor is special. It also inherit from vtkProp3D,
        but has nothing to do with vtkActor. */
@@ -72,13 +379,23 @@ int main()
     volumeProperty->SetColor(colorTransferFunction);
     volumeProperty->SetScalarOpacity(opacityTransferFunction);
     volumeProperty->SetInterpolationTypeToLinear();
+    if (shading)
+    {
+        /* The baked RGBA voxels are used as they are */
+        vtkSmartPointer<vtkPiecewiseFunction> identity =
+            vtkSmartPointer<vtkPiecewiseFunction>::New();
+        identity->AddPoint(0, 0);
+        identity->AddPoint(255, 1);
+        volumeProperty->SetScalarOpacity(identity);
+        volumeProperty->IndependentComponentsOff();
+    }
     volume->SetProperty(volumeProperty);
 
     /* Renderer */
     vtkSmartPointer<vtkRenderer> renderer = vtkRenderer::New();
     renderer->SetBackground(1, 1, 1);
     renderer->AddVolume(volume);
-    renderer->AddActor(doOutline(reader));
+    renderer->AddActor(doOutline(reader->GetOutputPort()));
 
     /* Interactor */
     vtkSmartPointer<vtkRenderWindow> window = vtkRenderWindow::New();
@@ -94,13 +411,53 @@ int main()
     interactorStyle->SetCurrentStyleToTrackballCamera();
 
     interactor->Initialize();
+    if (loader)
+    {
+        vtkSmartPointer<vtkTextActor> progress = vtkTextActor::New();
+        progress->SetInput("Loading 0%");
+        progress->GetTextProperty()->SetColor(0, 0, 0);
+        progress->SetDisplayPosition(10, 10);
+        renderer->AddActor2D(progress);
+
+        loader->start(renderer->GetActiveCamera(),
+                      renderer->GetTiledAspectRatio());
+        window->Render();
+
+        vtkSmartPointer<Loading> loading =
+            Loading::New(loader.get(), renderer, progress);
+        interactor->AddObserver(vtkCommand::TimerEvent, loading);
+    }
+    else if (bricked)
+    {
+        window->Render();
+        std::cout << bricked->GetLoadedBrickCount() << " bricks loaded, "
+                  << bricked->GetSkippedBrickCount() << " empty bricks skipped"
+                  << std::endl;
+
+        if (bricked->GetPyramid()->levelCount() > 1 && !shade)
+        {
+            vtkSmartPointer<Refinement> refinement =
+                Refinement::New(bricked, renderer,
+                                std::max(0, bricked->GetOutputLevel() - 1));
+            interactor->AddObserver(vtkCommand::TimerEvent, refinement);
+        }
+    }
+    if (shading)
+    {
+        vtkSmartPointer<Relighting> relighting =
+            Relighting::New(shading, renderer);
+        interactor->AddObserver(vtkCommand::TimerEvent, relighting);
+    }
+    /* A single timer drives loading, refinement and relighting */
+    if (interactor->HasObserver(vtkCommand::TimerEvent))
+        interactor->CreateRepeatingTimer(100);
     interactor->Start();
 }
 
-vtkSmartPointer<vtkActor> doOutline(vtkDataSetReader *reader)
+vtkSmartPointer<vtkActor> doOutline(vtkAlgorithmOutput *data)
 {
     vtkSmartPointer<vtkOutlineFilter> outline = vtkOutlineFilter::New();
-    outline->SetInputConnection(reader->GetOutputPort());
+    outline->SetInputConnection(data);
 
     vtkSmartPointer<vtkPolyDataMapper> mapper = vtkPolyDataMapper::New();
     mapper->SetInputConnection(outline->GetOutputPort());
@@ -111,4 +468,3 @@ vtkSmartPointer<vtkActor> doOutline(vtkDataSetReader *reader)
 
     return actor;
 }
-g